@@ -0,0 +1,65 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__BENCHMARK__
+#define __CORELIB__BENCHMARK__
+
+#include <chrono>
+#include <stdio.h>
+
+namespace cl {
+namespace Benchmark {
+
+class Stopwatch {
+  public:
+    Stopwatch() : _start(Clock::now()) {
+    }
+
+    void reset() {
+        _start = Clock::now();
+    }
+
+    double seconds() const {
+        return std::chrono::duration<double>(Clock::now() - _start).count();
+    }
+
+    double nanoseconds() const {
+        return std::chrono::duration<double, std::nano>(Clock::now() - _start)
+            .count();
+    }
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point _start;
+};
+
+}
+}
+
+#define CL_BENCHMARK_REPORT(name, message, ...)                                \
+    printf("[ BENCHMARK ] %-40s " message "\n", name, ##__VA_ARGS__)
+
+#endif /* defined(__CORELIB__BENCHMARK__) */
@@ -0,0 +1,154 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "AutoLock.h"
+#include "Benchmark.h"
+#include "BoundedQueue.h"
+#include "Lock.h"
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <thread>
+#include <vector>
+
+/*
+ *  The queue the bounded queue replaces for handing work between loopers. A
+ *  deque behind a lock, with full and empty queues retried after yielding.
+ */
+class BoundedQueueBenchmark_LockedQueue {
+  public:
+    explicit BoundedQueueBenchmark_LockedQueue(size_t capacity)
+        : _capacity(capacity) {
+    }
+
+    void push(uint64_t item) {
+        while (true) {
+            {
+                cl::AutoLock lock(_lock);
+
+                if (_items.size() < _capacity) {
+                    _items.push_back(item);
+                    return;
+                }
+            }
+
+            std::this_thread::yield();
+        }
+    }
+
+    bool pop(uint64_t &item) {
+        while (true) {
+            {
+                cl::AutoLock lock(_lock);
+
+                if (!_items.empty()) {
+                    item = _items.front();
+                    _items.pop_front();
+                    return true;
+                }
+            }
+
+            std::this_thread::yield();
+        }
+    }
+
+  private:
+    cl::Lock _lock;
+    std::deque<uint64_t> _items;
+    size_t _capacity;
+};
+
+template <typename Queue>
+static void BoundedQueueBenchmark_Run(const char *name, size_t producerCount,
+                                      size_t consumerCount) {
+    const uint64_t ItemCount = 1 << 20;
+
+    Queue queue(1024);
+
+    std::atomic<uint64_t> sum(0);
+    std::vector<std::thread> threads;
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t i = 0; i < producerCount; i++) {
+        const uint64_t count = ItemCount / producerCount +
+                               (i < ItemCount % producerCount ? 1 : 0);
+
+        threads.emplace_back([&queue, count]() {
+            for (uint64_t item = 0; item < count; item++) {
+                queue.push(1);
+            }
+        });
+    }
+
+    for (size_t i = 0; i < consumerCount; i++) {
+        const uint64_t count = ItemCount / consumerCount +
+                               (i < ItemCount % consumerCount ? 1 : 0);
+
+        threads.emplace_back([&queue, &sum, count]() {
+            uint64_t item = 0;
+            uint64_t localSum = 0;
+
+            for (uint64_t j = 0; j < count; j++) {
+                queue.pop(item);
+                localSum += item;
+            }
+
+            sum += localSum;
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    const double seconds = stopwatch.seconds();
+
+    ASSERT_EQ(sum.load(), ItemCount);
+
+    char title[64];
+    snprintf(title, sizeof(title), "%s %zuP/%zuC", name, producerCount,
+             consumerCount);
+
+    CL_BENCHMARK_REPORT(title, "%.0f items/sec", ItemCount / seconds);
+}
+
+TEST(BoundedQueueBenchmark, Contention) {
+    const size_t MaxThreads =
+        std::max<size_t>(2, std::thread::hardware_concurrency());
+
+    for (size_t threads = 1; threads <= MaxThreads; threads <<= 1) {
+        BoundedQueueBenchmark_Run<cl::BoundedQueue<uint64_t>>(
+            "BoundedQueue", threads, threads);
+        BoundedQueueBenchmark_Run<BoundedQueueBenchmark_LockedQueue>(
+            "Locked deque", threads, threads);
+    }
+
+    BoundedQueueBenchmark_Run<cl::BoundedQueue<uint64_t>>("BoundedQueue", 1,
+                                                          MaxThreads);
+    BoundedQueueBenchmark_Run<cl::BoundedQueue<uint64_t>>("BoundedQueue",
+                                                          MaxThreads, 1);
+}
@@ -0,0 +1,139 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Benchmark.h"
+#include "Channel.h"
+#include "Message.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#if __linux__
+
+/*
+ *  Count heap allocations made by the receiving thread by interposing the
+ *  allocator entry points and forwarding to glibc
+ */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+
+static thread_local bool ChannelAllocationBenchmark_Counting = false;
+static std::atomic<size_t> ChannelAllocationBenchmark_Allocations(0);
+
+extern "C" void *malloc(size_t size) {
+    if (ChannelAllocationBenchmark_Counting) {
+        ChannelAllocationBenchmark_Allocations++;
+    }
+
+    return __libc_malloc(size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+    if (ChannelAllocationBenchmark_Counting) {
+        ChannelAllocationBenchmark_Allocations++;
+    }
+
+    return __libc_realloc(pointer, size);
+}
+
+TEST(ChannelAllocationBenchmark, SteadyStateReceive) {
+    const size_t MessageSize = 32;
+    const size_t WarmupCount = 10000;
+    const size_t MessageCount = 1000000;
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    std::atomic<size_t> received(0);
+
+    cl::Looper *looper = nullptr;
+    std::atomic<bool> looperReady(false);
+
+    std::thread receiverThread([&]() {
+        looper = cl::Looper::Current();
+
+        auto &channel = channels.second;
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            size_t count = ++received;
+
+            /*
+             *  Only count once the pools and the looper are warmed up
+             */
+            if (count == WarmupCount) {
+                ChannelAllocationBenchmark_Counting = true;
+            }
+
+            if (count == WarmupCount + MessageCount) {
+                ChannelAllocationBenchmark_Counting = false;
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looperReady = true;
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    while (!looperReady) {
+        std::this_thread::yield();
+    }
+
+    cl::Message message(MessageSize);
+
+    for (size_t i = 0; i < MessageSize; i++) {
+        message.encode(static_cast<uint8_t>(i));
+    }
+
+    for (size_t i = 0; i < WarmupCount; i++) {
+        ASSERT_TRUE(channels.first->sendMessage(message));
+    }
+
+    while (received < WarmupCount) {
+        std::this_thread::yield();
+    }
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t i = 0; i < MessageCount; i++) {
+        ASSERT_TRUE(channels.first->sendMessage(message));
+    }
+
+    receiverThread.join();
+
+    double seconds = stopwatch.seconds();
+
+    const size_t allocations = ChannelAllocationBenchmark_Allocations;
+
+    CL_BENCHMARK_REPORT("Channel receive 32B", "%zu allocations, %.0f "
+                                               "messages/sec",
+                        allocations, MessageCount / seconds);
+
+    ASSERT_EQ(allocations, 0u);
+}
+
+#endif /* __linux__ */
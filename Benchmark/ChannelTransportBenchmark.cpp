@@ -0,0 +1,147 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "Benchmark.h"
+#include "Channel.h"
+#include "Looper.h"
+#include "Message.h"
+#include "Socket.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/*
+ *  Compares sending messages of increasing size through the socket (single
+ *  records, fragments and spills) and through the shared memory transport
+ */
+static void ChannelTransportBenchmark_Throughput(size_t messageSize,
+                                                 bool sharedMemory) {
+    const char *transportName = sharedMemory ? "shm" : "socket";
+
+    char title[64];
+    snprintf(title, sizeof(title), "Channel %s %zuB", transportName,
+             messageSize);
+
+    const size_t TotalBytes = 256 << 20;
+    const size_t MessageCount =
+        std::max<size_t>(16, std::min<size_t>(200000, TotalBytes / messageSize));
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    if (sharedMemory) {
+        ASSERT_TRUE(channels.first->enableSharedMemoryTransport());
+    }
+
+    /*
+     *  Records that do not fit in the transport are queued till the peer
+     *  makes room, which the sender hears about in its looper. Sends hold
+     *  off while the queue is backed up.
+     */
+    std::atomic<bool> backpressure(false);
+
+    channels.first->backpressureCallback(
+        [&](bool backedUp) { backpressure = backedUp; });
+
+    cl::Looper *senderLooper = nullptr;
+    std::atomic<bool> senderLooperReady(false);
+
+    std::thread senderLooperThread([&]() {
+        senderLooper = cl::Looper::Current();
+
+        channels.first->scheduleInLooper(senderLooper);
+        senderLooperReady = true;
+        senderLooper->loop();
+        channels.first->unscheduleFromLooper(senderLooper);
+    });
+
+    size_t received = 0;
+    size_t receivedBytes = 0;
+
+    cl::Looper *looper = nullptr;
+    std::atomic<bool> looperReady(false);
+
+    std::thread receiverThread([&]() {
+        looper = cl::Looper::Current();
+
+        auto &channel = channels.second;
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            receivedBytes += message.size();
+
+            if (++received == MessageCount) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looperReady = true;
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    while (!looperReady || !senderLooperReady) {
+        std::this_thread::yield();
+    }
+
+    cl::Message message(messageSize);
+
+    for (size_t i = 0; i < messageSize; i++) {
+        message.encode(static_cast<uint8_t>(i));
+    }
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t i = 0; i < MessageCount; i++) {
+        while (backpressure) {
+            std::this_thread::yield();
+        }
+
+        ASSERT_TRUE(channels.first->sendMessage(message));
+    }
+
+    receiverThread.join();
+
+    senderLooper->terminate();
+    senderLooperThread.join();
+
+    double seconds = stopwatch.seconds();
+
+    ASSERT_EQ(receivedBytes, messageSize * MessageCount);
+
+    CL_BENCHMARK_REPORT(title, "%.0f messages/sec, %.1f MB/sec",
+                        MessageCount / seconds,
+                        receivedBytes / seconds / (1 << 20));
+}
+
+TEST(ChannelTransportBenchmark, MessageSizes) {
+    const size_t MessageSizes[] = {64, 4 << 10, 64 << 10, 4 << 20};
+
+    for (auto size : MessageSizes) {
+        ChannelTransportBenchmark_Throughput(size, false);
+        ChannelTransportBenchmark_Throughput(size, true);
+    }
+}
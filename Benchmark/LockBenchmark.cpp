@@ -0,0 +1,113 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "AutoLock.h"
+#include "Benchmark.h"
+#include "Lock.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <pthread.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+/*
+ *  The default pthread mutex the lock used to wrap
+ */
+class LockBenchmark_Mutex {
+  public:
+    LockBenchmark_Mutex() {
+        pthread_mutex_init(&_mutex, NULL);
+    }
+
+    ~LockBenchmark_Mutex() {
+        pthread_mutex_destroy(&_mutex);
+    }
+
+    void lock() {
+        pthread_mutex_lock(&_mutex);
+    }
+
+    void unlock() {
+        pthread_mutex_unlock(&_mutex);
+    }
+
+  private:
+    pthread_mutex_t _mutex;
+};
+
+/*
+ *  Threads repeatedly take the lock around a short critical section, like
+ *  the socket does around each read and write
+ */
+template <class LockType>
+static void LockBenchmark_Contention(const char *name, LockType &lock,
+                                     size_t threadCount) {
+    const size_t Iterations = 200000;
+
+    uint64_t counter = 0;
+    std::vector<std::thread> threads;
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back([&]() {
+            for (size_t j = 0; j < Iterations; j++) {
+                lock.lock();
+                counter++;
+                lock.unlock();
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    const double seconds = stopwatch.seconds();
+
+    ASSERT_EQ(counter, threadCount * Iterations);
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s, %zu threads", name, threadCount);
+
+    CL_BENCHMARK_REPORT(label, "%.1f ns per acquisition",
+                        seconds * 1e9 / (threadCount * Iterations));
+}
+
+TEST(LockBenchmark, Contention) {
+    const size_t maxThreads =
+        std::max<size_t>(4, std::thread::hardware_concurrency());
+
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        LockBenchmark_Mutex mutex;
+        LockBenchmark_Contention("pthread_mutex", mutex, threads);
+
+        cl::Lock lock;
+        LockBenchmark_Contention("cl::Lock", lock, threads);
+    }
+}
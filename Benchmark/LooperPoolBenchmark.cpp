@@ -0,0 +1,154 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "Benchmark.h"
+#include "LooperPool.h"
+#include "Server.h"
+#include "Message.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static void LooperPoolBenchmark_Throughput(size_t poolSize) {
+    const size_t ClientCount = 16;
+    const size_t MessagesPerClient = 20000;
+    const size_t MessageCount = ClientCount * MessagesPerClient;
+
+    auto endpoint = "/tmp/corelib_looper_pool_benchmark";
+
+    cl::LooperPool pool(poolSize);
+
+    cl::Server server(endpoint);
+    ASSERT_TRUE(server.isListening());
+
+    server.channelLooperPool(&pool);
+
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    std::vector<std::pair<std::shared_ptr<cl::Channel>, cl::Looper *>>
+        accepted;
+    std::atomic<size_t> received(0);
+
+    server.channelAvailabilityCallback(
+        [&](std::shared_ptr<cl::Channel> channel) {
+            channel->messageReceivedCallback([&](cl::Message &message) {
+                if (++received == MessageCount) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    condition.notify_all();
+                }
+            });
+
+            std::lock_guard<std::mutex> lock(mutex);
+            accepted.push_back(std::make_pair(channel, cl::Looper::Current()));
+        });
+
+    cl::Looper *acceptLooper = nullptr;
+    std::atomic<bool> acceptLooperReady(false);
+
+    std::thread acceptThread([&] {
+        acceptLooper = cl::Looper::Current();
+        acceptLooper->addSource(server.clientConnectionsSource());
+        acceptLooperReady = true;
+        acceptLooper->loop();
+        acceptLooper->removeSource(server.clientConnectionsSource());
+    });
+
+    while (!acceptLooperReady) {
+        std::this_thread::yield();
+    }
+
+    std::vector<std::unique_ptr<cl::Channel>> clients;
+
+    for (size_t i = 0; i < ClientCount; i++) {
+        std::unique_ptr<cl::Channel> client(new cl::Channel(endpoint));
+
+        while (!client->tryConnect()) {
+            std::this_thread::yield();
+        }
+
+        clients.push_back(std::move(client));
+    }
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    std::vector<std::thread> senders;
+
+    for (auto &client : clients) {
+        cl::Channel *channel = client.get();
+
+        senders.emplace_back([channel] {
+            for (size_t i = 0; i < MessagesPerClient; i++) {
+                cl::Message message;
+                message.encode(i);
+                channel->sendMessage(message);
+            }
+        });
+    }
+
+    for (auto &sender : senders) {
+        sender.join();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&]() { return received == MessageCount; });
+    }
+
+    double seconds = stopwatch.seconds();
+
+    acceptLooper->post([&]() { acceptLooper->terminate(); });
+    acceptThread.join();
+
+    /*
+     *  Unschedule the server side channels on their loopers before they are
+     *  collected
+     */
+    for (auto &entry : accepted) {
+        auto channel = entry.first;
+        auto looper = entry.second;
+        looper->post([channel, looper]() {
+            channel->unscheduleFromLooper(looper);
+        });
+    }
+
+    char title[64];
+    snprintf(title, sizeof(title), "LooperPool size=%zu", poolSize);
+
+    CL_BENCHMARK_REPORT(title, "%.0f messages/sec", MessageCount / seconds);
+}
+
+TEST(LooperPoolBenchmark, ChannelThroughput) {
+    size_t maxPoolSize = std::max(2u, std::thread::hardware_concurrency());
+
+    for (size_t poolSize = 1; poolSize <= maxPoolSize; poolSize++) {
+        LooperPoolBenchmark_Throughput(poolSize);
+    }
+}
@@ -0,0 +1,93 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "Benchmark.h"
+#include "Looper.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static void LooperPostBenchmark_Throughput(size_t producerCount) {
+    const size_t TasksPerProducer = 200000;
+    const size_t TaskCount = TasksPerProducer * producerCount;
+
+    size_t executed = 0;
+
+    cl::Looper *looper = nullptr;
+    std::atomic<bool> looperReady(false);
+
+    std::thread looperThread([&] {
+        looper = cl::Looper::Current();
+        looperReady = true;
+        looper->loop();
+    });
+
+    while (!looperReady) {
+        std::this_thread::yield();
+    }
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    std::vector<std::thread> producers;
+
+    for (size_t i = 0; i < producerCount; i++) {
+        producers.emplace_back([&] {
+            for (size_t j = 0; j < TasksPerProducer; j++) {
+                looper->post([&] {
+                    if (++executed == TaskCount) {
+                        looper->terminate();
+                    }
+                });
+            }
+        });
+    }
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    looperThread.join();
+
+    double seconds = stopwatch.seconds();
+
+    ASSERT_EQ(executed, TaskCount);
+
+    char title[64];
+    snprintf(title, sizeof(title), "Looper::post producers=%zu",
+             producerCount);
+
+    CL_BENCHMARK_REPORT(title, "%.0f tasks/sec", TaskCount / seconds);
+}
+
+TEST(LooperPostBenchmark, Throughput) {
+    size_t maxProducers = std::max(2u, std::thread::hardware_concurrency());
+
+    for (size_t producers = 1; producers <= maxProducers; producers *= 2) {
+        LooperPostBenchmark_Throughput(producers);
+    }
+}
@@ -0,0 +1,182 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Benchmark.h"
+#include "Histogram.h"
+#include "RingBuffer.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <thread>
+
+/*
+ *  Moves small records from one thread to another, committing and releasing
+ *  them in batches of the given size
+ */
+static void RingBufferBenchmark_Throughput(size_t batchSize) {
+    const uint64_t Count = 5000000;
+
+    auto ring = cl::RingBuffer::Create(64 << 10);
+    ASSERT_TRUE(ring != nullptr);
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    std::thread producer([&]() {
+        uint64_t next = 0;
+        size_t reserved = 0;
+
+        while (next < Count) {
+            uint8_t *payload = ring->reserveRecord(sizeof(next));
+
+            if (payload == nullptr) {
+                ring->commit();
+                reserved = 0;
+                std::this_thread::yield();
+                continue;
+            }
+
+            memcpy(payload, &next, sizeof(next));
+            next++;
+
+            if (++reserved == batchSize) {
+                ring->commit();
+                reserved = 0;
+            }
+        }
+
+        ring->commit();
+    });
+
+    uint64_t expected = 0;
+    size_t peeked = 0;
+
+    while (expected < Count) {
+        const uint8_t *payload = nullptr;
+        size_t length = 0;
+
+        if (ring->peekRecord(payload, length) != cl::RingBuffer::Success) {
+            ring->release();
+            peeked = 0;
+            std::this_thread::yield();
+            continue;
+        }
+
+        uint64_t value = 0;
+        memcpy(&value, payload, sizeof(value));
+        ASSERT_EQ(value, expected);
+        expected++;
+
+        if (++peeked == batchSize) {
+            ring->release();
+            peeked = 0;
+        }
+    }
+
+    ring->release();
+    producer.join();
+
+    char title[64];
+    snprintf(title, sizeof(title), "RingBuffer batch %zu", batchSize);
+
+    CL_BENCHMARK_REPORT(title, "%.0f records/sec",
+                        Count / stopwatch.seconds());
+}
+
+TEST(RingBufferBenchmark, Throughput) {
+    const size_t BatchSizes[] = {1, 16, 256};
+
+    for (auto batchSize : BatchSizes) {
+        RingBufferBenchmark_Throughput(batchSize);
+    }
+}
+
+/*
+ *  Bounces a record between two threads over a pair of rings. Half the
+ *  round trip is the latency of handing a record to another core. Both
+ *  sides spin, so this is only meaningful with at least two cores
+ *  available.
+ */
+TEST(RingBufferBenchmark, CrossCoreLatency) {
+    const size_t RoundTrips = 200000;
+
+    auto ping = cl::RingBuffer::Create(4096);
+    auto pong = cl::RingBuffer::Create(4096);
+
+    auto bounce = [](cl::RingBuffer &from, cl::RingBuffer &to) {
+        const uint8_t *payload = nullptr;
+        size_t length = 0;
+
+        while (from.peekRecord(payload, length) != cl::RingBuffer::Success) {
+            if (std::thread::hardware_concurrency() < 2) {
+                std::this_thread::yield();
+            }
+        }
+
+        from.release();
+
+        memcpy(to.reserveRecord(length), payload, length);
+        to.commit();
+    };
+
+    std::thread echo([&]() {
+        for (size_t i = 0; i < RoundTrips; i++) {
+            bounce(*ping, *pong);
+        }
+    });
+
+    cl::Histogram latencies;
+
+    for (size_t i = 0; i < RoundTrips; i++) {
+        cl::Benchmark::Stopwatch stopwatch;
+
+        uint64_t value = i;
+        memcpy(ping->reserveRecord(sizeof(value)), &value, sizeof(value));
+        ping->commit();
+
+        const uint8_t *payload = nullptr;
+        size_t length = 0;
+
+        while (pong->peekRecord(payload, length) != cl::RingBuffer::Success) {
+            if (std::thread::hardware_concurrency() < 2) {
+                std::this_thread::yield();
+            }
+        }
+
+        pong->release();
+
+        latencies.record(static_cast<uint64_t>(stopwatch.nanoseconds() / 2));
+    }
+
+    echo.join();
+
+    auto snapshot = latencies.snapshot();
+
+    CL_BENCHMARK_REPORT("RingBuffer one way latency",
+                        "mean %.0f ns, p50 %.0f ns, p99 %.0f ns",
+                        snapshot.mean(),
+                        static_cast<double>(snapshot.percentile(0.5)),
+                        static_cast<double>(snapshot.percentile(0.99)));
+}
@@ -0,0 +1,128 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "AutoLock.h"
+#include "Benchmark.h"
+#include "Lock.h"
+#include "SeqLock.h"
+#include "SharedLock.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+struct SharedLockBenchmark_Route {
+    uint64_t destination;
+    uint64_t generation;
+};
+
+/*
+ *  Readers look up a small piece of routing state on every message while
+ *  one in a thousand accesses replaces it
+ */
+template <class Read, class Write>
+static void SharedLockBenchmark_ReadMostly(const char *name,
+                                           size_t threadCount, Read read,
+                                           Write write) {
+    const size_t Iterations = 200000;
+    const size_t WriteInterval = 1000;
+
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> sink(0);
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back([&, i]() {
+            uint64_t sum = 0;
+
+            for (size_t j = 0; j < Iterations; j++) {
+                if (i == 0 && j % WriteInterval == 0) {
+                    write(SharedLockBenchmark_Route{j, j});
+                    continue;
+                }
+
+                sum += read().destination;
+            }
+
+            sink += sum;
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    const double seconds = stopwatch.seconds();
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s, %zu threads", name, threadCount);
+
+    CL_BENCHMARK_REPORT(label, "%.1f ns per access",
+                        seconds * 1e9 / (threadCount * Iterations));
+}
+
+TEST(SharedLockBenchmark, ReadMostly) {
+    const size_t maxThreads =
+        std::max<size_t>(4, std::thread::hardware_concurrency());
+
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        SharedLockBenchmark_Route route = {0, 0};
+
+        cl::Lock lock;
+        SharedLockBenchmark_ReadMostly(
+            "Lock", threads,
+            [&]() {
+                cl::AutoLock autoLock(lock);
+                return route;
+            },
+            [&](const SharedLockBenchmark_Route &value) {
+                cl::AutoLock autoLock(lock);
+                route = value;
+            });
+
+        cl::SharedLock sharedLock;
+        SharedLockBenchmark_ReadMostly(
+            "SharedLock", threads,
+            [&]() {
+                cl::AutoSharedLock autoLock(sharedLock);
+                return route;
+            },
+            [&](const SharedLockBenchmark_Route &value) {
+                cl::AutoExclusiveLock autoLock(sharedLock);
+                route = value;
+            });
+
+        cl::SeqLock<SharedLockBenchmark_Route> seqLock(route);
+        SharedLockBenchmark_ReadMostly(
+            "SeqLock", threads, [&]() { return seqLock.load(); },
+            [&](const SharedLockBenchmark_Route &value) {
+                seqLock.store(value);
+            });
+    }
+}
@@ -0,0 +1,66 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Benchmark.h"
+#include "SharedMemory.h"
+#include "SharedMemoryArena.h"
+
+#include <gtest/gtest.h>
+
+/*
+ *  Compares getting a buffer to hand to another process from the arena
+ *  against creating a shared memory region (a file descriptor, a resize and
+ *  a mapping) for each one
+ */
+TEST(SharedMemoryArenaBenchmark, BufferCreation) {
+    const size_t Iterations = 10000;
+    const size_t BufferSize = 4096;
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t i = 0; i < Iterations; i++) {
+        cl::SharedMemory memory(BufferSize);
+        ASSERT_TRUE(memory.isReady());
+        static_cast<uint8_t *>(memory.address())[0] = 1;
+    }
+
+    CL_BENCHMARK_REPORT("SharedMemory per buffer", "%.0f ns per buffer",
+                        stopwatch.seconds() * 1e9 / Iterations);
+
+    auto arena = cl::SharedMemoryArena::Create();
+    ASSERT_TRUE(arena != nullptr);
+
+    stopwatch.reset();
+
+    for (size_t i = 0; i < Iterations; i++) {
+        auto block = arena->allocate(BufferSize);
+        ASSERT_NE(block, cl::SharedMemoryArena::InvalidBlock);
+        arena->address(block)[0] = 1;
+        arena->free(block);
+    }
+
+    CL_BENCHMARK_REPORT("SharedMemoryArena", "%.0f ns per buffer",
+                        stopwatch.seconds() * 1e9 / Iterations);
+}
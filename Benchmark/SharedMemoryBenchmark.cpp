@@ -0,0 +1,79 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Benchmark.h"
+#include "SharedMemory.h"
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+/*
+ *  Creates a large region and writes to every page of it. Prefaulting moves
+ *  the page faults from the first pass over the region into its creation.
+ *  Huge pages cut the number of faults (and TLB misses) altogether.
+ */
+static void SharedMemoryBenchmark_FirstTouch(const char *name,
+                                             cl::SharedMemory::Options options) {
+    const size_t Size = 64 << 20;
+    const size_t Rounds = 8;
+    const size_t PageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+
+    double createSeconds = 0.0;
+    double touchSeconds = 0.0;
+
+    for (size_t round = 0; round < Rounds; round++) {
+        cl::Benchmark::Stopwatch stopwatch;
+
+        cl::SharedMemory memory(Size, options);
+        ASSERT_TRUE(memory.isReady());
+
+        createSeconds += stopwatch.seconds();
+        stopwatch.reset();
+
+        auto bytes = static_cast<volatile uint8_t *>(memory.address());
+
+        for (size_t offset = 0; offset < Size; offset += PageSize) {
+            bytes[offset] = 1;
+        }
+
+        touchSeconds += stopwatch.seconds();
+    }
+
+    CL_BENCHMARK_REPORT(name, "create %.2f ms, first touch %.2f ms",
+                        createSeconds * 1e3 / Rounds,
+                        touchSeconds * 1e3 / Rounds);
+}
+
+TEST(SharedMemoryBenchmark, FirstTouch) {
+    SharedMemoryBenchmark_FirstTouch("SharedMemory 64MB", 0);
+    SharedMemoryBenchmark_FirstTouch("SharedMemory 64MB prefault",
+                                     cl::SharedMemory::OptionPrefault);
+    SharedMemoryBenchmark_FirstTouch("SharedMemory 64MB huge pages",
+                                     cl::SharedMemory::OptionHugePages);
+    SharedMemoryBenchmark_FirstTouch(
+        "SharedMemory 64MB huge pages prefault",
+        cl::SharedMemory::OptionHugePages | cl::SharedMemory::OptionPrefault);
+}
@@ -0,0 +1,89 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Benchmark.h"
+#include "Looper.h"
+#include "SharedMemoryRing.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <unistd.h>
+
+/*
+ *  Streams small records into a consumer looper. The doorbell is only rung
+ *  when the consumer has drained the ring, so the rate mostly reflects the
+ *  ring itself rather than wakeups.
+ */
+TEST(SharedMemoryRingBenchmark, Throughput) {
+    const size_t Count = 2000000;
+    const size_t RecordSize = 64;
+
+    auto consumer = cl::SharedMemoryRing::Create(1 << 20);
+    ASSERT_TRUE(consumer != nullptr);
+
+    auto producer = cl::SharedMemoryRing::Open(
+        dup(consumer->memoryHandle()), dup(consumer->doorbellHandle()));
+    ASSERT_TRUE(producer != nullptr);
+
+    size_t received = 0;
+
+    cl::Looper *looper = nullptr;
+    std::atomic<bool> looperReady(false);
+
+    std::thread consumerThread([&]() {
+        looper = cl::Looper::Current();
+
+        consumer->recordHandler([&](const uint8_t *, size_t) {
+            if (++received == Count) {
+                looper->terminate();
+            }
+        });
+
+        looper->addSource(consumer->source());
+        looperReady = true;
+        looper->loop();
+        looper->removeSource(consumer->source());
+    });
+
+    while (!looperReady) {
+        std::this_thread::yield();
+    }
+
+    uint8_t record[RecordSize] = {0};
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t i = 0; i < Count; i++) {
+        while (!producer->write(record, sizeof(record))) {
+            std::this_thread::yield();
+        }
+    }
+
+    consumerThread.join();
+
+    CL_BENCHMARK_REPORT("SharedMemoryRing 64B", "%.0f records/sec",
+                        Count / stopwatch.seconds());
+}
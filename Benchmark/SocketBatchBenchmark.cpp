@@ -0,0 +1,137 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Benchmark.h"
+#include "Message.h"
+#include "Socket.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+/*
+ *  Compares writing small records one system call at a time with writing
+ *  them in batches. The reader always drains in batches.
+ */
+static void SocketBatchBenchmark_Throughput(bool batched) {
+    const size_t MessageSize = 32;
+    const size_t MessageCount = 1 << 20;
+
+    auto socketPair = cl::Socket::CreatePair();
+
+    std::thread readerThread([&]() {
+        size_t received = 0;
+
+        while (received < MessageCount) {
+            auto result = socketPair.second->ReadMessages();
+
+            ASSERT_EQ(result.first, cl::Socket::Status::Success);
+
+            received += result.second.size();
+
+            if (result.second.size() == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    cl::Message message(MessageSize);
+
+    for (size_t i = 0; i < MessageSize; i++) {
+        message.encode(static_cast<uint8_t>(i));
+    }
+
+    std::vector<cl::Message *> batch(cl::Socket::MaxBatchCount, &message);
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    if (batched) {
+        for (size_t i = 0; i < MessageCount; i += batch.size()) {
+            ASSERT_EQ(socketPair.first->WriteMessages(batch),
+                      cl::Socket::Status::Success);
+        }
+    } else {
+        for (size_t i = 0; i < MessageCount; i++) {
+            ASSERT_EQ(socketPair.first->WriteMessage(message),
+                      cl::Socket::Status::Success);
+        }
+    }
+
+    readerThread.join();
+
+    double seconds = stopwatch.seconds();
+
+    CL_BENCHMARK_REPORT(batched ? "Socket batched 32B" : "Socket single 32B",
+                        "%.0f messages/sec", MessageCount / seconds);
+}
+
+TEST(SocketBatchBenchmark, SmallMessages) {
+    SocketBatchBenchmark_Throughput(false);
+    SocketBatchBenchmark_Throughput(true);
+}
+
+/*
+ *  A single thread writing and reading back one record at a time, like a
+ *  looper relaying messages. Bound sockets skip their lock on both calls.
+ */
+static void SocketBatchBenchmark_RoundTrip(bool bound) {
+    const size_t MessageCount = 1 << 18;
+
+    auto socketPair = cl::Socket::CreatePair();
+
+    if (bound) {
+        socketPair.first->bindToCurrentThread();
+        socketPair.second->bindToCurrentThread();
+    }
+
+    cl::Message message(32);
+
+    for (size_t i = 0; i < 32; i++) {
+        message.encode(static_cast<uint8_t>(i));
+    }
+
+    cl::Socket::Messages messages;
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t i = 0; i < MessageCount; i++) {
+        ASSERT_EQ(socketPair.first->WriteMessage(message),
+                  cl::Socket::Status::Success);
+        ASSERT_EQ(socketPair.second->ReadMessages(messages, 1),
+                  cl::Socket::Status::Success);
+
+        socketPair.second->RecycleMessages(messages);
+    }
+
+    double seconds = stopwatch.seconds();
+
+    CL_BENCHMARK_REPORT(bound ? "Socket round trip bound" : "Socket round trip",
+                        "%.0f ns per message", seconds * 1e9 / MessageCount);
+}
+
+TEST(SocketBatchBenchmark, RoundTrip) {
+    SocketBatchBenchmark_RoundTrip(false);
+    SocketBatchBenchmark_RoundTrip(true);
+}
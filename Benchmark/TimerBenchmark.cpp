@@ -0,0 +1,169 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "Benchmark.h"
+#include "Looper.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+static const size_t TimerBenchmark_TimerCount = 100000;
+
+static std::chrono::milliseconds TimerBenchmark_Delay(size_t index) {
+    return std::chrono::milliseconds(1 + (index * 7919) % 50);
+}
+
+TEST(TimerBenchmark, WheelTimers) {
+    std::thread thread([] {
+        auto looper = cl::Looper::Current();
+
+        const size_t Count = TimerBenchmark_TimerCount;
+
+        size_t fired = 0;
+
+        std::vector<std::unique_ptr<cl::Looper::Timer>> timers;
+
+        for (size_t i = 0; i < Count; i++) {
+            timers.emplace_back(
+                cl::Utils::make_unique<cl::Looper::Timer>([&fired, looper]() {
+                    if (++fired == TimerBenchmark_TimerCount) {
+                        looper->terminate();
+                    }
+                }));
+        }
+
+        cl::Benchmark::Stopwatch stopwatch;
+
+        for (size_t i = 0; i < Count; i++) {
+            looper->scheduleTimer(*timers[i], TimerBenchmark_Delay(i));
+        }
+
+        double scheduleNanos = stopwatch.nanoseconds() / Count;
+
+        /*
+         *  Re-arm every timer the way a per-connection timeout is pushed
+         *  back on every message
+         */
+        stopwatch.reset();
+
+        for (size_t i = 0; i < Count; i++) {
+            looper->scheduleTimer(*timers[i], TimerBenchmark_Delay(i));
+        }
+
+        double rescheduleNanos = stopwatch.nanoseconds() / Count;
+
+        stopwatch.reset();
+
+        looper->loop();
+
+        double seconds = stopwatch.seconds();
+
+        ASSERT_EQ(fired, Count);
+
+        CL_BENCHMARK_REPORT("Looper timers (wheel)",
+                            "%zu timers, 0 fds, schedule %.0fns, "
+                            "reschedule %.0fns, all fired in %.3fs",
+                            Count, scheduleNanos, rescheduleNanos, seconds);
+    });
+
+    thread.join();
+}
+
+TEST(TimerBenchmark, TimerSources) {
+    std::thread thread([] {
+        auto looper = cl::Looper::Current();
+
+        /*
+         *  Each timer source needs its own descriptor. Stay within the
+         *  descriptor limit of the process.
+         */
+        struct rlimit limit = {0};
+        getrlimit(RLIMIT_NOFILE, &limit);
+
+        const size_t Count =
+            std::min<size_t>(TimerBenchmark_TimerCount, limit.rlim_cur - 512);
+
+        size_t fired = 0;
+
+        /*
+         *  Timer sources repeat, so only count the first fire of each
+         */
+        std::vector<bool> firedOnce(Count, false);
+
+        std::vector<std::shared_ptr<cl::LooperSource>> sources;
+
+        cl::Benchmark::Stopwatch stopwatch;
+
+        for (size_t i = 0; i < Count; i++) {
+            auto source = cl::LooperSource::AsTimer(TimerBenchmark_Delay(i));
+
+            source->setWakeFunction([&fired, &firedOnce, looper, i, Count]() {
+                if (firedOnce[i]) {
+                    return;
+                }
+
+                firedOnce[i] = true;
+
+                if (++fired == Count) {
+                    looper->terminate();
+                }
+            });
+
+            looper->addSource(source);
+            sources.push_back(source);
+        }
+
+        double scheduleNanos = stopwatch.nanoseconds() / Count;
+
+        stopwatch.reset();
+
+        looper->loop();
+
+        double seconds = stopwatch.seconds();
+
+        ASSERT_EQ(fired, Count);
+
+        stopwatch.reset();
+
+        for (auto &source : sources) {
+            looper->removeSource(source);
+        }
+
+        sources.clear();
+
+        double teardownNanos = stopwatch.nanoseconds() / Count;
+
+        CL_BENCHMARK_REPORT("LooperSource::AsTimer",
+                            "%zu timers, %zu fds, schedule %.0fns, "
+                            "teardown %.0fns, all fired in %.3fs",
+                            Count, Count, scheduleNanos, teardownNanos,
+                            seconds);
+    });
+
+    thread.join();
+}
@@ -0,0 +1,136 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "Benchmark.h"
+#include "WaitSet.h"
+#include "LooperSource.h"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+static void WaitSetBenchmark_DrainBusySources(size_t maxReadySources) {
+    const size_t SourceCount = 256;
+    const size_t Rounds = 200;
+
+    cl::WaitSet waitSet(maxReadySources);
+
+    std::vector<std::shared_ptr<cl::LooperSource>> sources;
+
+    for (size_t i = 0; i < SourceCount; i++) {
+        auto source = cl::LooperSource::AsTrivial();
+        ASSERT_TRUE(waitSet.addSource(source));
+        sources.push_back(source);
+    }
+
+    size_t waits = 0;
+    size_t dispatched = 0;
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t round = 0; round < Rounds; round++) {
+        /*
+         *  Signal every source and dispatch till all of them are drained
+         */
+        for (auto &source : sources) {
+            source->writer()(source->writeHandle());
+        }
+
+        size_t pending = SourceCount;
+
+        while (pending > 0) {
+            const auto &ready = waitSet.wait();
+            waits++;
+
+            for (const auto &entry : ready) {
+                auto source = waitSet.source(entry.token);
+                source->reader()(source->readHandle());
+                dispatched++;
+                pending--;
+            }
+        }
+    }
+
+    double seconds = stopwatch.seconds();
+
+    ASSERT_EQ(dispatched, SourceCount * Rounds);
+
+    char name[64];
+    snprintf(name, sizeof(name), "WaitSet batch=%zu", maxReadySources);
+
+    CL_BENCHMARK_REPORT(name, "%.3f waits/event, %.0f events/sec",
+                        (double)waits / dispatched, dispatched / seconds);
+}
+
+TEST(WaitSetBenchmark, SingleSourcePerWait) {
+    WaitSetBenchmark_DrainBusySources(1);
+}
+
+TEST(WaitSetBenchmark, BatchedSourcesPerWait) {
+    WaitSetBenchmark_DrainBusySources(cl::WaitSet::DefaultMaxReadySources);
+}
+
+TEST(WaitSetBenchmark, SourceChurn) {
+    /*
+     *  Keep a resident population of sources while a window of them is
+     *  continuously removed and re-added, as happens with connection churn
+     */
+    const size_t ResidentCount = 4096;
+    const size_t ChurnCount = 256;
+    const size_t Rounds = 400;
+
+    cl::WaitSet waitSet;
+
+    std::vector<std::shared_ptr<cl::LooperSource>> sources;
+
+    for (size_t i = 0; i < ResidentCount; i++) {
+        auto source = cl::LooperSource::AsTrivial();
+        ASSERT_TRUE(waitSet.addSource(source));
+        sources.push_back(source);
+    }
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    for (size_t round = 0; round < Rounds; round++) {
+        const size_t first = (round * ChurnCount) % ResidentCount;
+
+        for (size_t i = first; i < first + ChurnCount; i++) {
+            ASSERT_TRUE(waitSet.removeSource(sources[i]));
+        }
+
+        for (size_t i = first; i < first + ChurnCount; i++) {
+            ASSERT_TRUE(waitSet.addSource(sources[i]));
+        }
+    }
+
+    double seconds = stopwatch.seconds();
+
+    const size_t operations = Rounds * ChurnCount * 2;
+
+    CL_BENCHMARK_REPORT("WaitSet add/remove", "%.0f ns/operation",
+                        seconds * 1e9 / operations);
+
+    for (auto &source : sources) {
+        ASSERT_TRUE(waitSet.removeSource(source));
+    }
+}
@@ -0,0 +1,181 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "Benchmark.h"
+#include "Looper.h"
+#include "Utilities.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+/*
+ *  The pipe based wake source the trivial source used to be. Every wake is a
+ *  separate two byte write that needs its own read.
+ */
+static std::shared_ptr<cl::LooperSource> WakeSourceBenchmark_PipeSource() {
+    using LS = cl::LooperSource;
+
+    LS::IOHandlesAllocator allocator = [] {
+        int descriptors[2] = {0};
+        CL_CHECK(::pipe(descriptors));
+        return LS::Handles(descriptors[0], descriptors[1]);
+    };
+
+    LS::IOHandlesDeallocator deallocator = [](LS::Handles h) {
+        CL_CHECK(::close(h.first));
+        CL_CHECK(::close(h.second));
+    };
+
+    LS::IOHandler reader = [](LS::Handle r) {
+        char buffer[2];
+        CL_TEMP_FAILURE_RETRY(::read(r, &buffer, sizeof(buffer)));
+    };
+
+    LS::IOHandler writer = [](LS::Handle w) {
+        CL_TEMP_FAILURE_RETRY(::write(w, "w", 2));
+    };
+
+    return std::make_shared<LS>(allocator, deallocator, reader, writer);
+}
+
+static int64_t WakeSourceBenchmark_Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void
+WakeSourceBenchmark_Burst(const char *name,
+                          std::shared_ptr<cl::LooperSource> source,
+                          size_t producerCount) {
+    const size_t WakesPerProducer = 20000;
+
+    std::atomic<int64_t> pendingSince(0);
+    std::atomic<size_t> dispatches(0);
+    std::atomic<bool> producersDone(false);
+
+    std::vector<int64_t> latencies;
+    latencies.reserve(WakesPerProducer * producerCount);
+
+    cl::Looper *looper = nullptr;
+
+    std::thread looperThread([&] {
+        looper = cl::Looper::Current();
+
+        source->setWakeFunction([&] {
+            /*
+             *  Latency is measured from the earliest wake that was not yet
+             *  dispatched.
+             */
+            int64_t since = pendingSince.exchange(0);
+
+            if (since != 0) {
+                latencies.push_back(WakeSourceBenchmark_Now() - since);
+            }
+
+            dispatches++;
+
+            if (producersDone && pendingSince == 0) {
+                looper->terminate();
+            }
+        });
+
+        looper->addSource(source);
+        looper->loop();
+        looper->removeSource(source);
+    });
+
+    /*
+     *  Wait for the looper to come up
+     */
+    while (looper == nullptr) {
+        std::this_thread::yield();
+    }
+
+    source->writer()(source->writeHandle());
+
+    while (dispatches == 0) {
+        std::this_thread::yield();
+    }
+
+    cl::Benchmark::Stopwatch stopwatch;
+
+    std::vector<std::thread> producers;
+
+    for (size_t i = 0; i < producerCount; i++) {
+        producers.emplace_back([&] {
+            for (size_t j = 0; j < WakesPerProducer; j++) {
+                int64_t expected = 0;
+                pendingSince.compare_exchange_strong(
+                    expected, WakeSourceBenchmark_Now());
+
+                source->writer()(source->writeHandle());
+            }
+        });
+    }
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    producersDone = true;
+    source->writer()(source->writeHandle());
+
+    looperThread.join();
+
+    double seconds = stopwatch.seconds();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    int64_t median = latencies.empty() ? 0 : latencies[latencies.size() / 2];
+    int64_t worst = latencies.empty() ? 0 : latencies.back();
+
+    char title[64];
+    snprintf(title, sizeof(title), "%s producers=%zu", name, producerCount);
+
+    CL_BENCHMARK_REPORT(title,
+                        "%.3f dispatches/wake, p50 %.1fus, max %.1fus, "
+                        "%.0f wakes/sec",
+                        (double)dispatches / (WakesPerProducer * producerCount),
+                        median / 1e3, worst / 1e3,
+                        (WakesPerProducer * producerCount) / seconds);
+}
+
+TEST(WakeSourceBenchmark, PipeBurst) {
+    for (size_t producers = 1; producers <= 8; producers *= 2) {
+        WakeSourceBenchmark_Burst("Pipe wake", WakeSourceBenchmark_PipeSource(),
+                                  producers);
+    }
+}
+
+TEST(WakeSourceBenchmark, TrivialSourceBurst) {
+    for (size_t producers = 1; producers <= 8; producers *= 2) {
+        WakeSourceBenchmark_Burst("Trivial wake", cl::LooperSource::AsTrivial(),
+                                  producers);
+    }
+}
@@ -46,6 +46,31 @@ class AutoLock {
     DISALLOW_COPY_AND_ASSIGN(AutoLock);
 };
 
+/*
+ *  Holds the lock only if there is one. Used by objects that take no locks
+ *  while they are bound to a single thread.
+ */
+class OptionalAutoLock {
+
+  public:
+    OptionalAutoLock(const Lock *lock) : _lock(lock) {
+        if (_lock != nullptr) {
+            _lock->lock();
+        }
+    }
+
+    ~OptionalAutoLock() {
+        if (_lock != nullptr) {
+            _lock->unlock();
+        }
+    }
+
+  private:
+    const Lock *_lock;
+
+    DISALLOW_COPY_AND_ASSIGN(OptionalAutoLock);
+};
+
 } /* namespace cl */
 
 #endif /* defined(__CORELIB__AUTOLOCK__) */
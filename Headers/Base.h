@@ -29,6 +29,17 @@
     TypeName(TypeName &) = delete;                                             \
     void operator=(TypeName) = delete;
 
+/*
+ *  Hints the processor that the thread is spinning on a contended word
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define CL_CPU_PAUSE() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define CL_CPU_PAUSE() asm volatile("yield")
+#else
+#define CL_CPU_PAUSE()
+#endif
+
 #include <memory>
 
 namespace cl {
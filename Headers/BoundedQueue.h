@@ -0,0 +1,390 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__BOUNDEDQUEUE__
+#define __CORELIB__BOUNDEDQUEUE__
+
+#include "Base.h"
+#include "Futex.h"
+#include "LooperSource.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <stdint.h>
+
+namespace cl {
+
+/**
+ *  A bounded, lock free, multiple producer, multiple consumer queue. Each
+ *  slot carries a sequence number that tells producers and consumers
+ *  whether it is free or filled for their lap around the queue, so
+ *  claiming a slot is a single compare and swap on the shared position of
+ *  that side (Dmitry Vyukov's design).
+ *
+ *  Threads may block on a full or empty queue, in which case they park on
+ *  a futex. Producers only make a system call when a thread is actually
+ *  parked. Loopers may consume from the queue through sources created by
+ *  it instead of blocking.
+ */
+template <typename T>
+class BoundedQueue {
+  public:
+    typedef std::function<void(T &item)> ItemHandler;
+
+    static const size_t DefaultSourceBudget = 64;
+
+    /**
+     *  Create a queue
+     *
+     *  @param capacity the number of items the queue can hold. Rounded up
+     *                  to a power of two.
+     */
+    explicit BoundedQueue(size_t capacity)
+        : _enqueuePosition(0), _dequeuePosition(0), _notFull(0),
+          _fullWaiters(0), _notEmpty(0), _emptyWaiters(0),
+          _hasSources(false) {
+        size_t roundedCapacity = 2;
+
+        while (roundedCapacity < capacity) {
+            roundedCapacity <<= 1;
+        }
+
+        _mask = roundedCapacity - 1;
+        _slots.reset(new Slot[roundedCapacity]);
+
+        for (size_t i = 0; i < roundedCapacity; i++) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        _signal = LooperSource::AsTrivial();
+        _signal->handles();
+    }
+
+    /*
+     *  Items still in the queue are destroyed. No thread may be using the
+     *  queue, and sources created by it must no longer be in any looper.
+     */
+    ~BoundedQueue() {
+        T item;
+
+        while (tryPop(item)) {
+        }
+    }
+
+    size_t capacity() const {
+        return _mask + 1;
+    }
+
+    /**
+     *  Push an item if there is space
+     *
+     *  @param item the item. Only moved from if it was pushed.
+     *
+     *  @return if the item was pushed
+     */
+    bool tryPush(T &&item) {
+        return emplace(std::move(item));
+    }
+
+    bool tryPush(const T &item) {
+        return emplace(item);
+    }
+
+    /**
+     *  Pop the oldest item if there is one
+     *
+     *  @param item on success, assigned the item
+     *
+     *  @return if an item was popped
+     */
+    bool tryPop(T &item) {
+        size_t position = _dequeuePosition.load(std::memory_order_relaxed);
+        Slot *slot = nullptr;
+
+        while (true) {
+            slot = &_slots[position & _mask];
+
+            const size_t sequence =
+                slot->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) -
+                                        static_cast<intptr_t>(position + 1);
+
+            if (difference == 0) {
+                if (_dequeuePosition.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = _dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        T *value = reinterpret_cast<T *>(&slot->storage);
+
+        item = std::move(*value);
+        value->~T();
+
+        slot->sequence.store(position + _mask + 1, std::memory_order_release);
+
+        wakeWaiters(_notFull, _fullWaiters);
+
+        return true;
+    }
+
+    /**
+     *  Push an item, blocking while the queue is full
+     *
+     *  @param item the item
+     */
+    void push(T item) {
+        while (!tryPush(std::move(item))) {
+            const uint32_t key = _notFull.load(std::memory_order_seq_cst);
+
+            /*
+             *  Registering as a waiter and then checking the queue again
+             *  pairs with consumers freeing a slot and then checking for
+             *  waiters. At least one side sees the other.
+             */
+            _fullWaiters.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (tryPush(std::move(item))) {
+                return;
+            }
+
+            Futex::Wait(_notFull, key);
+        }
+    }
+
+    /**
+     *  Pop the oldest item, blocking while the queue is empty
+     *
+     *  @param item    on success, assigned the item
+     *  @param timeout the longest time to wait for an item
+     *
+     *  @return false if the timeout expired before an item arrived
+     */
+    bool pop(T &item, std::chrono::nanoseconds timeout =
+                          std::chrono::nanoseconds::max()) {
+        const bool timed = timeout != std::chrono::nanoseconds::max();
+        const auto deadline = timed ? std::chrono::steady_clock::now() + timeout
+                                    : std::chrono::steady_clock::time_point();
+
+        while (!tryPop(item)) {
+            const uint32_t key = _notEmpty.load(std::memory_order_seq_cst);
+
+            _emptyWaiters.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (tryPop(item)) {
+                return true;
+            }
+
+            auto remaining = std::chrono::nanoseconds::max();
+
+            if (timed) {
+                remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    deadline - std::chrono::steady_clock::now());
+            }
+
+            if (remaining.count() <= 0 ||
+                !Futex::Wait(_notEmpty, key, remaining)) {
+                return tryPop(item);
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     *  Create a source that pops items on the looper it is added to. Any
+     *  number of loopers may each add their own source to share the work.
+     *  The sources share a single signal that is raised when the queue
+     *  stops being empty, so it wakes at least one of their loopers but not
+     *  necessarily all of them. A looper that used up its budget raises the
+     *  signal again so that the remaining items are picked up by it or by
+     *  another looper.
+     *
+     *  @param handler the handler invoked on the looper for each item
+     *  @param budget  the most items handled per wakeup of the looper
+     *                 before other sources get a chance to run
+     *
+     *  @return the source. Its wake function refers to the queue by a raw
+     *          pointer, so it must be removed from its looper before the
+     *          queue is destroyed.
+     */
+    std::shared_ptr<LooperSource>
+    createSource(ItemHandler handler, size_t budget = DefaultSourceBudget) {
+        auto signal = _signal;
+
+        /*
+         *  The signal handles are shared by every source and are owned by
+         *  the queue, so sources do not deallocate them.
+         */
+        LooperSource::IOHandlesAllocator allocator = [signal]() {
+            return signal->handles();
+        };
+
+        auto source = std::make_shared<LooperSource>(
+            allocator, nullptr, signal->reader(), signal->writer());
+
+        source->setWakeFunction([this, handler, budget]() {
+            T item;
+
+            for (size_t i = 0; i < budget; i++) {
+                if (!tryPop(item)) {
+                    /*
+                     *  Pairs with the fence of a producer that found the
+                     *  queue not to be empty and so did not signal
+                     */
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                    if (!tryPop(item)) {
+                        return;
+                    }
+                }
+
+                handler(item);
+            }
+
+            /*
+             *  Items were left behind. Signal again so that this or another
+             *  looper picks them up after other sources had their turn.
+             */
+            signalSources();
+        });
+
+        _hasSources.store(true, std::memory_order_seq_cst);
+
+        return source;
+    }
+
+  private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+
+    alignas(64) std::atomic<size_t> _enqueuePosition;
+    alignas(64) std::atomic<size_t> _dequeuePosition;
+
+    alignas(64) std::atomic<uint32_t> _notFull;
+    std::atomic<uint32_t> _fullWaiters;
+
+    alignas(64) std::atomic<uint32_t> _notEmpty;
+    std::atomic<uint32_t> _emptyWaiters;
+
+    std::atomic<bool> _hasSources;
+    std::shared_ptr<LooperSource> _signal;
+
+    template <typename U>
+    bool emplace(U &&item) {
+        size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+        Slot *slot = nullptr;
+
+        while (true) {
+            slot = &_slots[position & _mask];
+
+            const size_t sequence =
+                slot->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) -
+                                        static_cast<intptr_t>(position);
+
+            if (difference == 0) {
+                if (_enqueuePosition.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = _enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (&slot->storage) T(std::forward<U>(item));
+
+        slot->sequence.store(position + 1, std::memory_order_release);
+
+        wakeWaiters(_notEmpty, _emptyWaiters);
+
+        /*
+         *  Sources are only signalled when the queue stops being empty. If
+         *  items ahead of this one are still there, whoever pushed the
+         *  first of them did so already.
+         */
+        if (_hasSources.load(std::memory_order_relaxed) &&
+            _dequeuePosition.load(std::memory_order_relaxed) == position) {
+            signalSources();
+        }
+
+        return true;
+    }
+
+    /*
+     *  Waiters register themselves each time before parking and the waker
+     *  claims all of them at once. This way a waiter that has not been
+     *  scheduled yet does not cost a system call on every operation till
+     *  it runs. A waiter that gave up on its own leaves a stale count
+     *  behind, which only causes one needless wake.
+     */
+    void wakeWaiters(std::atomic<uint32_t> &word,
+                     std::atomic<uint32_t> &waiters) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (waiters.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+
+        const uint32_t count = waiters.exchange(0, std::memory_order_seq_cst);
+
+        if (count == 0) {
+            return;
+        }
+
+        word.fetch_add(1, std::memory_order_seq_cst);
+        Futex::Wake(word, count);
+    }
+
+    void signalSources() {
+        _signal->writer()(_signal->writeHandle());
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(BoundedQueue);
+};
+
+}
+
+#endif /* defined(__CORELIB__BOUNDEDQUEUE__) */
@@ -29,9 +29,13 @@
 #include "Base.h"
 #include "Looper.h"
 #include "Socket.h"
+#include "Attachment.h"
+#include "SharedMemoryTransport.h"
 
 #include <string>
 #include <memory>
+#include <atomic>
+#include <deque>
 
 namespace cl {
 
@@ -43,9 +47,16 @@ class Channel {
 
     typedef std::function<void(Message &)> MessageReceivedCallback;
     typedef std::function<void(void)> TerminationCallback;
+    typedef std::function<void(bool)> BackpressureCallback;
     typedef std::pair<std::shared_ptr<Channel>, std::shared_ptr<Channel>>
         ConnectedChannels;
 
+    static const size_t DefaultSpillThreshold;
+    static const size_t DefaultSendQueueLowWatermark;
+    static const size_t DefaultSendQueueHighWatermark;
+    static const size_t DefaultReadBudget;
+    static const size_t DefaultMaxFragmentedMessageSize;
+
     /**
      *  Create a channel to a named endpoint. Connection
      *  must be explicitly setup by the caller
@@ -102,8 +113,180 @@ class Channel {
      *  Sending and receiving messages
      */
 
+    /**
+     *  Send a message of any size. Messages too large for a single socket
+     *  record are split into fragments that are reassembled on receipt.
+     *  Messages larger than the spill threshold are instead copied into a
+     *  shared memory region that is sent as an attachment and mapped by the
+     *  receiver.
+     *
+     *  @param message the message to send
+     *
+     *  @return if the message was sent
+     */
     bool sendMessage(Message &message);
 
+    /**
+     *  Send a number of messages in order. Consecutive messages that fit in
+     *  a single socket record are written with as few system calls as
+     *  possible. All others are sent as if by `sendMessage`.
+     *
+     *  @param messages the messages to send
+     *
+     *  @return if all messages were sent
+     */
+    bool sendMessages(const std::vector<Message *> &messages);
+
+    void spillThreshold(size_t threshold) {
+        _spillThreshold = threshold;
+    }
+
+    size_t spillThreshold() const {
+        return _spillThreshold;
+    }
+
+    /**
+     *  The largest message the peer may send in fragments. The size of a
+     *  fragmented message is announced by the peer and reserved before the
+     *  rest of it arrives, so larger ones terminate the channel instead.
+     *
+     *  @param size the size in bytes
+     */
+    void maxFragmentedMessageSize(size_t size) {
+        _maxFragmentedMessageSize = size;
+    }
+
+    size_t maxFragmentedMessageSize() const {
+        return _maxFragmentedMessageSize;
+    }
+
+    /**
+     *  Never block the sending thread on a peer that is slow to read.
+     *  Records that do not fit in the socket buffer are copied into a send
+     *  queue that is drained by the looper the channel is scheduled in when
+     *  the socket becomes writable again. Messages are still delivered in
+     *  the order they were sent. Must be set before the channel is scheduled
+     *  in a looper. Sends on the shared memory transport always block.
+     *
+     *  @param nonBlocking if sends should queue instead of block
+     */
+    void nonBlockingSends(bool nonBlocking) {
+        _nonBlockingSends = nonBlocking;
+    }
+
+    bool nonBlockingSends() const {
+        return _nonBlockingSends;
+    }
+
+    /**
+     *  The backpressure callback is invoked with true once the number of
+     *  bytes in the send queue reaches the high watermark, and with false
+     *  once it drains back down to the low watermark. The callback is
+     *  invoked on the thread that crossed the watermark and must not send
+     *  messages on this channel.
+     *
+     *  @param low  the low watermark in bytes
+     *  @param high the high watermark in bytes
+     */
+    void sendQueueWatermarks(size_t low, size_t high);
+
+    size_t sendQueueLowWatermark() const {
+        return _sendQueueLowWatermark;
+    }
+
+    size_t sendQueueHighWatermark() const {
+        return _sendQueueHighWatermark;
+    }
+
+    size_t sendQueueSize() const;
+
+    void backpressureCallback(BackpressureCallback callback) {
+        _backpressureCallback = callback;
+    }
+
+    BackpressureCallback backpressureCallback() const {
+        return _backpressureCallback;
+    }
+
+    /**
+     *  Move the payloads of all messages subsequently sent on this channel
+     *  through a ring in a shared memory region instead of the socket. The
+     *  region is handed to the peer over the channel itself. After that, the
+     *  socket only carries notifications for when the peer may be idle.
+     *  Payloads are limited by the capacity of the ring instead of the
+     *  socket buffer and are received without being copied. Sends through
+     *  the ring never block. Records that do not fit are queued, count
+     *  towards the send queue watermarks and are written once the peer has
+     *  made room, which the channel hears about in its looper. Must not be
+     *  called concurrently with `sendMessage`.
+     *
+     *  @param capacity the capacity of the ring. Messages larger than this
+     *                  are spilled into a region of their own, which is
+     *                  handed over on the socket.
+     *
+     *  @return if the shared memory transport was setup
+     */
+    bool enableSharedMemoryTransport(
+        size_t capacity = SharedMemoryTransport::DefaultCapacity);
+
+    bool isSharedMemoryTransportEnabled() const {
+        return _outboundTransport.get() != nullptr;
+    }
+
+    /**
+     *  The maximum number of records read and dispatched each time the
+     *  looper services this channel, counting those on the socket and those
+     *  on the shared memory transport. Records beyond the budget are read
+     *  after the other sources ready in the same looper have been serviced.
+     *
+     *  @param budget the number of records. Zero is treated as one.
+     */
+    void readBudget(size_t budget) {
+        _readBudget = budget == 0 ? 1 : budget;
+    }
+
+    size_t readBudget() const {
+        return _readBudget;
+    }
+
+    /**
+     *  The priority with which the looper services this channel relative to
+     *  other sources signalled in the same wakeup. Must be set before the
+     *  channel is scheduled in a looper.
+     *
+     *  @param priority the priority of the channel
+     */
+    void priority(LooperSource::Priority priority) {
+        _priority = priority;
+    }
+
+    LooperSource::Priority priority() const {
+        return _priority;
+    }
+
+    /**
+     *  Bind the channel to the thread of the looper it is scheduled in. The
+     *  channel then takes no locks when it sends and receives on that
+     *  thread. Messages sent from other threads are copied and handed to
+     *  the looper, which sends them in order. A successful send from another
+     *  thread only means the message was handed off. If the looper cannot
+     *  send it, the channel is terminated, which the termination callback
+     *  reports unless the channel was already terminated, and the messages
+     *  after it are dropped. Messages still waiting when the channel is
+     *  unscheduled are dropped too. Must be set before the channel is
+     *  scheduled in a looper, and the channel must be scheduled from the
+     *  thread of that looper.
+     *
+     *  @param affinity if the channel should be bound to its looper thread
+     */
+    void threadAffinity(bool affinity) {
+        _threadAffinity = affinity;
+    }
+
+    bool threadAffinity() const {
+        return _threadAffinity;
+    }
+
     void messageReceivedCallback(MessageReceivedCallback callback) {
         _messageReceivedCallback = callback;
     }
@@ -128,6 +311,26 @@ class Channel {
 
     void terminate();
 
+    struct Stats {
+        uint64_t messagesSent;
+        uint64_t bytesSent;
+        uint64_t messagesReceived;
+        uint64_t bytesReceived;
+
+        Stats()
+            : messagesSent(0), bytesSent(0), messagesReceived(0),
+              bytesReceived(0) {
+        }
+    };
+
+    /**
+     *  A snapshot of the traffic on this channel. Empty unless the library
+     *  is built with instrumentation. May be called from any thread.
+     *
+     *  @return the snapshot
+     */
+    Stats stats() const;
+
     void terminationCallback(TerminationCallback callback) {
         _terminationCallback = callback;
     }
@@ -150,7 +353,108 @@ class Channel {
 
     std::string _name;
 
+    /*
+     *  Transporting messages through shared memory
+     */
+    std::unique_ptr<SharedMemoryTransport> _outboundTransport;
+    std::unique_ptr<SharedMemoryTransport> _inboundTransport;
+    std::deque<Attachment> _inboundAttachments;
+
+    /*
+     *  Sending and receiving messages too large for a single record
+     */
+    size_t _spillThreshold;
+    size_t _maxFragmentedMessageSize;
+    std::unique_ptr<Message> _reassembly;
+    size_t _reassemblyLength;
+
+    /*
+     *  Held by sends that write more than one record so that records of
+     *  different messages are not interleaved
+     */
+    Lock _sendLock;
+
+    /*
+     *  Records waiting for the socket to become writable when sends do not
+     *  block. Queued records include their frame prefix and own duplicates
+     *  of their attachments.
+     */
+    bool _nonBlockingSends;
+    Lock _sendQueueLock;
+    std::deque<std::unique_ptr<Message>> _sendQueue;
+    size_t _sendQueueBytes;
+    size_t _sendQueueLowWatermark;
+    size_t _sendQueueHighWatermark;
+    bool _backpressure;
+    BackpressureCallback _backpressureCallback;
+
+    /*
+     *  Records waiting for the peer to make room in the outbound transport.
+     *  Their attachments have already been sent. The peer is asked to say
+     *  when it has read from the transport, and notes when it was asked.
+     */
+    struct TransportRecord {
+        std::unique_ptr<Message> payload;
+        uint32_t tag;
+    };
+
+    std::deque<TransportRecord> _transportQueue;
+    bool _transportSpaceWanted;
+
+    Socket::Status writeRecord(Message &record, const uint8_t *prefix,
+                               size_t prefixLength);
+    Socket::Status writeOrQueueRecords(Message *const *records, size_t count,
+                                       const uint8_t *prefix,
+                                       size_t prefixLength);
+    void drainSendQueue();
+    void clearSendQueue();
+
+    size_t _readBudget;
+    LooperSource::Priority _priority;
+
+    /*
+     *  The looper a channel with thread affinity is bound to. Messages
+     *  handed to the looper are dropped if the channel was unbound by the
+     *  time they are sent, so it is shared with them. Binding waits for
+     *  the senders that are still using the socket without having seen the
+     *  looper.
+     */
+    bool _threadAffinity;
+    std::shared_ptr<std::atomic<Looper *>> _boundLooper;
+    std::atomic<size_t> _activeSenders;
+
+    Looper *handOffLooper() const;
+    bool handOffMessages(Looper *looper, Message *const *messages,
+                         size_t count);
+    const Lock *lockUnlessBound(const Lock &lock) const;
+
+#if CL_ENABLE_INSTRUMENTATION
+    std::atomic<uint64_t> _messagesSent;
+    std::atomic<uint64_t> _bytesSent;
+    std::atomic<uint64_t> _messagesReceived;
+    std::atomic<uint64_t> _bytesReceived;
+
+    void countSent(size_t size);
+    void countReceived(size_t size);
+#endif
+
+    bool writeMessage(Message &message);
+    void deliverMessage(Message &message);
     void readMessageOnHandle(Handle handle);
+    void readRecord(Message &record);
+    Socket::Status writeFrame(uint8_t frame, Message &message);
+    bool sendFragmentedMessage(Message &message);
+    bool sendSpilledMessage(Message &message);
+    void readFragment(Message &message, bool first);
+    void dropReassembly();
+    void readSpilledMessage(Message &message);
+    void dispatchMessage(Message &message);
+    bool sendMessageOnTransport(Message &message);
+    Socket::Status writeTransportRecord(const uint8_t *payload, size_t length,
+                                        uint32_t tag);
+    void drainTransportQueue();
+    void setupInboundTransport(Message &message);
+    size_t readMessagesOnTransport(size_t budget, bool &drained);
 
     DISALLOW_COPY_AND_ASSIGN(Channel);
 };
@@ -36,4 +36,25 @@
 
 #endif
 
+/*
+ *  Instrumentation of loopers, their sources and channels. Set by the build.
+ *  When disabled, none of it is compiled in.
+ */
+#ifndef CL_ENABLE_INSTRUMENTATION
+
+#define CL_ENABLE_INSTRUMENTATION 0
+
+#endif
+
+/*
+ *  Profiling of lock contention. Set by the build. Every acquisition reads
+ *  the clock, so it is separate from the rest of the instrumentation. When
+ *  disabled, none of it is compiled in.
+ */
+#ifndef CL_ENABLE_LOCK_PROFILING
+
+#define CL_ENABLE_LOCK_PROFILING 0
+
+#endif
+
 #endif /* defined(__CL_CONFIG_H__) */
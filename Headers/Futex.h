@@ -0,0 +1,88 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__FUTEX__
+#define __CORELIB__FUTEX__
+
+#include "Base.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+namespace cl {
+
+/*
+ *  Parks and wakes threads on a 32 bit word. This is the slow path of
+ *  primitives that otherwise only spin on atomics. Waiting only blocks if
+ *  the word still holds the expected value, so a waker that changes the
+ *  word before waking can never be missed.
+ */
+class Futex {
+  public:
+    /*
+     *  Words only waited on by threads of one process are cheaper to wait
+     *  on. Words in shared memory that other processes wait on must be
+     *  shared.
+     */
+    enum Scope {
+        ScopePrivate,
+        ScopeShared,
+    };
+
+    /**
+     *  Block the calling thread while the word holds the expected value.
+     *  The thread may wake spuriously, so callers must check their
+     *  condition again.
+     *
+     *  @param word     the word to wait on
+     *  @param expected the value the word is expected to hold
+     *  @param timeout  the longest time to wait for
+     *  @param scope    the scope of the word. Wakers must use the same.
+     *
+     *  @return false if the timeout expired
+     */
+    static bool Wait(std::atomic<uint32_t> &word, uint32_t expected,
+                     std::chrono::nanoseconds timeout =
+                         std::chrono::nanoseconds::max(),
+                     Scope scope = ScopePrivate);
+
+    /**
+     *  Wake threads waiting on the word
+     *
+     *  @param word  the word threads are waiting on
+     *  @param count the most threads to wake
+     *  @param scope the scope of the word
+     */
+    static void Wake(std::atomic<uint32_t> &word, uint32_t count,
+                     Scope scope = ScopePrivate);
+
+  private:
+    DISALLOW_COPY_AND_ASSIGN(Futex);
+};
+
+}
+
+#endif /* defined(__CORELIB__FUTEX__) */
@@ -0,0 +1,103 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__HISTOGRAM__
+#define __CORELIB__HISTOGRAM__
+
+#include "Base.h"
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+namespace cl {
+
+/**
+ *  A log-linear histogram of unsigned values in the spirit of HDR
+ *  histograms. Each power of two is split into a fixed number of linear sub
+ *  buckets, which bounds the relative error of recorded values without
+ *  needing to know their range up front. Recording is wait free but assumes
+ *  a single writer, such as the thread servicing a looper. Snapshots may be
+ *  taken from any thread.
+ */
+class Histogram {
+  public:
+    static const unsigned SubBucketBits = 2;
+    static const unsigned MaxMagnitude = 40;
+    static const size_t BucketCount =
+        (MaxMagnitude - SubBucketBits + 2) << SubBucketBits;
+
+    struct Snapshot {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        std::vector<uint64_t> buckets;
+
+        Snapshot() : count(0), sum(0), max(0) {
+        }
+
+        /**
+         *  An upper bound for the value below which the given fraction of
+         *  recorded values fall
+         *
+         *  @param fraction the fraction between 0 and 1
+         *
+         *  @return the value. Zero if nothing was recorded.
+         */
+        uint64_t percentile(double fraction) const;
+
+        double mean() const {
+            return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+        }
+    };
+
+    Histogram();
+
+    /**
+     *  Record a value. Values larger than 2^MaxMagnitude are counted in the
+     *  last bucket but are still reflected in the maximum.
+     *
+     *  @param value the value to record
+     */
+    void record(uint64_t value);
+
+    Snapshot snapshot() const;
+
+    void reset();
+
+    static size_t BucketIndex(uint64_t value);
+    static uint64_t BucketUpperBound(size_t index);
+
+  private:
+    std::atomic<uint64_t> _buckets[BucketCount];
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _max;
+
+    DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
+
+}
+
+#endif /* defined(__CORELIB__HISTOGRAM__) */
@@ -26,31 +26,120 @@
 #ifndef __CORELIB__LOCK__
 #define __CORELIB__LOCK__
 
-#include <pthread.h>
 #include "Base.h"
+#include "Config.h"
+#include "Futex.h"
+
+#include <atomic>
+#include <stdint.h>
 
 namespace cl {
 
+/*
+ *  A mutual exclusion lock on a futex word. Contended acquisitions spin
+ *  briefly before parking, since critical sections are usually short.
+ *
+ *  Locks with a shared scope may be placed in shared memory (with placement
+ *  new) and used by all processes that map it.
+ *
+ *  When built with lock profiling, acquisitions of locks with a private
+ *  scope are recorded in the LockProfile under the name of the lock.
+ */
 class Lock {
   public:
-    Lock() {
-        pthread_mutex_init(&_mutex, NULL);
+    explicit Lock(Futex::Scope scope = Futex::ScopePrivate)
+        : Lock(nullptr, scope) {
     }
 
-    ~Lock() {
-        pthread_mutex_destroy(&_mutex);
+    /**
+     *  Create a lock
+     *
+     *  @param name  the name the lock is profiled under. Must outlive the
+     *               lock. Unnamed locks are profiled under their address.
+     *  @param scope the scope of the lock
+     */
+    explicit Lock(const char *name, Futex::Scope scope = Futex::ScopePrivate)
+        : _state(Unlocked), _scope(scope)
+#if CL_ENABLE_LOCK_PROFILING
+          ,
+          _name(name), _acquiredAt(0)
+#endif
+    {
+        (void)name;
     }
 
     void lock() const {
-        pthread_mutex_lock(&_mutex);
+        uint32_t expected = Unlocked;
+
+        if (!_state.compare_exchange_strong(expected, Locked,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+            lockContended();
+            return;
+        }
+
+#if CL_ENABLE_LOCK_PROFILING
+        profileAcquired(false, 0);
+#endif
+    }
+
+    /**
+     *  Acquire the lock only if it is free
+     *
+     *  @return if the lock was acquired
+     */
+    bool tryLock() const {
+        uint32_t expected = Unlocked;
+
+        if (!_state.compare_exchange_strong(expected, Locked,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+            return false;
+        }
+
+#if CL_ENABLE_LOCK_PROFILING
+        profileAcquired(false, 0);
+#endif
+
+        return true;
     }
 
     void unlock() const {
-        pthread_mutex_unlock(&_mutex);
+#if CL_ENABLE_LOCK_PROFILING
+        profileReleased();
+#endif
+
+        if (_state.exchange(Unlocked, std::memory_order_release) ==
+            Contended) {
+            Futex::Wake(_state, 1, _scope);
+        }
     }
 
   private:
-    mutable pthread_mutex_t _mutex;
+    /*
+     *  A contended lock may have parked waiters that must be woken on
+     *  unlock
+     */
+    enum State : uint32_t {
+        Unlocked,
+        Locked,
+        Contended,
+    };
+
+    mutable std::atomic<uint32_t> _state;
+    const Futex::Scope _scope;
+
+#if CL_ENABLE_LOCK_PROFILING
+    const char *_name;
+    mutable uint64_t _acquiredAt;
+
+    void profileAcquired(bool contended, uint64_t wait) const;
+    void profileReleased() const;
+#endif
+
+    void lockContended() const;
+
+    DISALLOW_COPY_AND_ASSIGN(Lock);
 };
 
 }
@@ -0,0 +1,102 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__LOCKPROFILE__
+#define __CORELIB__LOCKPROFILE__
+
+#include "Base.h"
+#include "Config.h"
+
+#include <vector>
+#include <stdint.h>
+
+namespace cl {
+
+/*
+ *  Contention statistics of locks, collected when the library is built with
+ *  lock profiling. Each thread records into its own buffer without taking
+ *  any lock. Buffers of threads that exited are kept, so their counts are
+ *  still reported.
+ */
+class LockProfile {
+  public:
+    struct Entry {
+        /*
+         *  The name of the lock, `nullptr` for unnamed locks
+         */
+        const char *name;
+
+        /*
+         *  The address of the lock, `nullptr` for named locks since all
+         *  locks of the same name are reported together
+         */
+        const void *lock;
+
+        uint64_t acquisitions;
+        uint64_t contendedAcquisitions;
+
+        /*
+         *  Times in nanoseconds spent waiting for contended acquisitions and
+         *  holding the lock
+         */
+        uint64_t totalWait;
+        uint64_t maxWait;
+        uint64_t totalHold;
+        uint64_t maxHold;
+    };
+
+    /**
+     *  Collect the statistics of all threads. Counts of threads still
+     *  running are read as they are updated and may lag slightly.
+     *
+     *  @return the locks acquired so far, with the longest total wait
+     *          first. Empty unless the library is built with lock
+     *          profiling.
+     */
+    static std::vector<Entry> Snapshot();
+
+    /*
+     *  Print the snapshot as a table
+     */
+    static void Dump();
+
+#if CL_ENABLE_LOCK_PROFILING
+
+    static uint64_t Now();
+
+    static void RecordAcquisition(const void *lock, const char *name,
+                                  bool contended, uint64_t wait);
+
+    static void RecordHold(const void *lock, const char *name, uint64_t hold);
+
+#endif
+
+  private:
+    DISALLOW_COPY_AND_ASSIGN(LockProfile);
+};
+
+}
+
+#endif /* defined(__CORELIB__LOCKPROFILE__) */
@@ -27,12 +27,21 @@
 
 #include "Base.h"
 #include "LooperSource.h"
+#include "TaskQueue.h"
+#include "TimerWheel.h"
 #include "WaitSet.h"
 
+#include <atomic>
+#include <queue>
+#include <vector>
+
 namespace cl {
 
 class Looper {
   public:
+    typedef TaskQueue::Task Task;
+    typedef TimerWheel::Timer Timer;
+
     void loop();
 
     void terminate();
@@ -42,16 +51,180 @@ class Looper {
     bool addSource(std::shared_ptr<LooperSource> source);
     bool removeSource(std::shared_ptr<LooperSource> source);
 
+    /**
+     *  Apply changes to the registration flags of a source already added to
+     *  this looper. One-shot sources must be updated after each wakeup to be
+     *  re-armed.
+     *
+     *  @param source the source to update
+     *
+     *  @return if the source was present in this looper
+     */
+    bool updateSource(std::shared_ptr<LooperSource> source);
+
+    /**
+     *  The number of sources added to this looper. May be read from any
+     *  thread but is only a snapshot.
+     *
+     *  @return the number of sources
+     */
+    size_t sourceCount() const {
+        return _sourceCount.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *  Run the task on the thread servicing this looper. Tasks are run in
+     *  the order in which they were posted. May be called from any thread.
+     *
+     *  @param task the task to run
+     */
+    void post(Task task);
+
+    /**
+     *  Run the task on the thread servicing this looper once the delay has
+     *  elapsed. May be called from any thread.
+     *
+     *  @param task  the task to run
+     *  @param delay the minimum delay before the task is run
+     */
+    void postDelayed(Task task, std::chrono::nanoseconds delay);
+
+    /**
+     *  Schedule (or reschedule) a timer on this looper. All timers on a
+     *  looper share one timing wheel, so scheduling, rescheduling and
+     *  cancelling are constant time and need no descriptors. This makes it
+     *  cheap to re-arm timeouts on every message. Must only be called on the
+     *  thread servicing this looper.
+     *
+     *  @param timer          the timer to schedule. The caller owns the timer
+     *                        and the timer is cancelled when collected.
+     *  @param delay          the minimum delay before the timer fires
+     *  @param repeatInterval the repeat interval. Zero for one-shot timers.
+     */
+    void scheduleTimer(Timer &timer, std::chrono::nanoseconds delay,
+                       std::chrono::nanoseconds repeatInterval =
+                           std::chrono::nanoseconds(0));
+
+    void cancelTimer(Timer &timer);
+
+    /**
+     *  Bound the time spent dispatching sources in each wakeup. Once the
+     *  budget is spent, the remaining signalled sources are deferred to the
+     *  next wakeup, which does not block and services newly signalled
+     *  sources of higher priority first. At least one source is dispatched
+     *  per wakeup. Unlimited by default. Must only be called on the thread
+     *  servicing this looper.
+     *
+     *  @param budget the dispatch budget per wakeup
+     */
+    void dispatchBudget(std::chrono::nanoseconds budget) {
+        _dispatchBudget = budget;
+    }
+
+    std::chrono::nanoseconds dispatchBudget() const {
+        return _dispatchBudget;
+    }
+
+    /**
+     *  The longest any source of the given priority waited to be dispatched
+     *  after being signalled. Always zero unless the library is built with
+     *  instrumentation. May be read from any thread.
+     *
+     *  @param priority the priority class
+     *
+     *  @return the worst wait since the looper was created or last reset
+     */
+    std::chrono::nanoseconds
+    worstDispatchWait(LooperSource::Priority priority) const;
+
+    void resetWorstDispatchWaits();
+
+    typedef WaitSet::Stats Stats;
+
+    /**
+     *  A snapshot of the wakeups of this looper. Empty unless the library
+     *  is built with instrumentation. May be called from any thread.
+     *
+     *  @return the snapshot
+     */
+    Stats stats() const {
+        return _waitSet.stats();
+    }
+
+    struct SourceStats {
+        std::shared_ptr<LooperSource> source;
+        Histogram::Snapshot handlerTimes;
+    };
+
+    /**
+     *  Snapshots of how long the handlers of each source in this looper
+     *  ran, with the sources that stalled the looper the longest first.
+     *  Empty unless the library is built with instrumentation. Must only be
+     *  called on the thread servicing this looper.
+     *
+     *  @return the snapshots
+     */
+    std::vector<SourceStats> sourceStats() const;
+
   private:
     Looper();
     ~Looper();
 
+    struct DelayedTask {
+        TaskQueue::Clock::time_point fireTime;
+        uint64_t sequence;
+        Task task;
+
+        bool operator>(const DelayedTask &other) const {
+            return fireTime != other.fireTime ? fireTime > other.fireTime
+                                              : sequence > other.sequence;
+        }
+    };
+
     WaitSet _waitSet;
 
+    /*
+     *  Sources signalled but not yet dispatched in the current (or a
+     *  previous) wakeup
+     */
+    struct PendingSource {
+        WaitSet::Token token;
+        uint32_t events;
+        LooperSource::Priority priority;
+#if CL_ENABLE_INSTRUMENTATION
+        std::chrono::steady_clock::time_point signalTime;
+#endif
+    };
+
+    std::vector<PendingSource> _pendingSources;
+    std::vector<PendingSource> _deferredSources;
+
+    std::chrono::nanoseconds _dispatchBudget;
+
+    std::atomic<int64_t> _worstDispatchWaits[LooperSource::PriorityCount];
+
+    void dispatchSource(WaitSet::Token token, uint32_t events);
+    void dispatchPendingSources();
+
     std::shared_ptr<LooperSource> _trivialSource;
 
+    TaskQueue _tasks;
+
+    TimerWheel _timerWheel;
+
+    std::priority_queue<DelayedTask, std::vector<DelayedTask>,
+                        std::greater<DelayedTask>> _delayedTasks;
+    uint64_t _delayedTasksSequence;
+
+    std::atomic<size_t> _sourceCount;
+
     bool _shouldTerminate;
 
+    void postAt(Task task, TaskQueue::Clock::time_point fireTime);
+    void drainTasks();
+    void runDueDelayedTasks();
+    std::chrono::nanoseconds nextTimeout() const;
+
     DISALLOW_COPY_AND_ASSIGN(Looper);
 };
 
@@ -0,0 +1,125 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef __CORELIB__LOOPERPOOL__
+#define __CORELIB__LOOPERPOOL__
+
+#include "Base.h"
+#include "Looper.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace cl {
+
+/*
+ *  A fixed set of threads, each servicing its own looper. Work (usually
+ *  channels) is spread across the loopers by a selection policy so that
+ *  I/O scales across cores.
+ */
+class LooperPool {
+  public:
+    typedef std::function<void(Looper *looper)> DispatchTask;
+
+    /*
+     *  Picks the index of the looper the next unit of work is dispatched
+     *  to. Invoked on the thread calling `dispatch`, so it must be thread
+     *  safe if work is dispatched from more than one thread.
+     */
+    typedef std::function<size_t(const LooperPool &pool)> SelectionPolicy;
+
+    /**
+     *  Create a pool and start its threads. Returns once every thread is
+     *  servicing its looper.
+     *
+     *  @param size the number of threads (and loopers). Zero picks the
+     *              number of hardware threads.
+     *
+     *  @return the looper pool
+     */
+    explicit LooperPool(size_t size = 0);
+
+    /*
+     *  Terminates all loopers and joins their threads
+     */
+    ~LooperPool();
+
+    size_t size() const {
+        return _loopers.size();
+    }
+
+    Looper *looper(size_t index) const;
+
+    /**
+     *  The load on a looper. This is the number of sources in the looper
+     *  plus the number of dispatched tasks that are yet to run on it. May be
+     *  called from any thread but is only a snapshot.
+     *
+     *  @param index the index of the looper
+     *
+     *  @return the load on the looper
+     */
+    size_t load(size_t index) const;
+
+    /**
+     *  Select a looper using the selection policy and run the task on its
+     *  thread. May be called from any thread.
+     *
+     *  @param task the task to run. The selected looper is passed to it.
+     *
+     *  @return the selected looper
+     */
+    Looper *dispatch(DispatchTask task);
+
+    void selectionPolicy(SelectionPolicy policy) {
+        _selectionPolicy = policy;
+    }
+
+    SelectionPolicy selectionPolicy() const {
+        return _selectionPolicy;
+    }
+
+    /*
+     *  Commonly used selection policies. Round robin is the default.
+     */
+
+    static SelectionPolicy RoundRobinPolicy();
+    static SelectionPolicy LeastLoadedPolicy();
+
+  private:
+    std::vector<std::thread> _threads;
+    std::vector<Looper *> _loopers;
+    std::unique_ptr<std::atomic<size_t>[]> _pendingDispatches;
+
+    SelectionPolicy _selectionPolicy;
+
+    DISALLOW_COPY_AND_ASSIGN(LooperPool);
+};
+
+}
+
+#endif /* defined(__CORELIB__LOOPERPOOL__) */
@@ -31,6 +31,7 @@
 #include <functional>
 #include <utility>
 #include <chrono>
+#include <stdint.h>
 
 #include "WaitSet.h"
 
@@ -49,9 +50,40 @@ class LooperSource {
     typedef std::function<Handles(void)> IOHandlesAllocator;
     typedef std::function<void(Handles)> IOHandlesDeallocator;
 
+    /*
+     *  How the source is registered in a wait set. Sources are level
+     *  triggered and only wait for readability by default.
+     */
+    typedef enum {
+        RegisterReadable = 1 << 0,
+        RegisterWritable = 1 << 1,
+        RegisterEdgeTriggered = 1 << 2,
+        RegisterOneShot = 1 << 3,
+    } RegistrationFlag;
+
+    typedef uint32_t RegistrationFlags;
+
+    /*
+     *  Sources signalled in the same wakeup of a looper are dispatched in
+     *  order of priority
+     */
+    typedef enum {
+        PriorityControl = 0,
+        PriorityData,
+        PriorityBackground,
+        PriorityCount,
+    } Priority;
+
+    typedef enum {
+        WaitSetAdd = 0,
+        WaitSetUpdate,
+        WaitSetRemove,
+    } WaitSetOperation;
+
     typedef std::function<void(LooperSource *source,
                                WaitSet::Handle waitsetHandle, Handle readHandle,
-                               bool adding)> WaitSetUpdateHandler;
+                               WaitSetOperation operation)>
+        WaitSetUpdateHandler;
 
     LooperSource(IOHandlesAllocator handleAllocator,
                  IOHandlesDeallocator handleDeallocator, IOHandler readHandler,
@@ -64,10 +96,16 @@ class LooperSource {
 
         _readHandler = readHandler;
         _writeHandler = writeHandler;
+        _writableHandler = nullptr;
+
+        _registrationFlags = RegisterReadable;
+        _priority = PriorityData;
 
         _wakeFunction = nullptr;
         _handles = Handles(-1, -1);
         _handlesAllocated = false;
+
+        _waitSetToken = WaitSet::InvalidToken;
     }
 
     ~LooperSource() {
@@ -139,10 +177,51 @@ class LooperSource {
         return _writeHandler;
     }
 
+    /*
+     *  Handling write readiness. Only invoked if the source is registered
+     *  with `RegisterWritable`.
+     */
+
+    void setWritableHandler(IOHandler handler) {
+        _writableHandler = handler;
+    }
+
+    IOHandler writableHandler() const {
+        return _writableHandler;
+    }
+
+    /*
+     *  Registration flags. Changes take effect when the source is next added
+     *  to or updated in a wait set. One-shot sources are disabled after each
+     *  wakeup till they are updated (re-armed) in the wait set again.
+     */
+
+    void setRegistrationFlags(RegistrationFlags flags) {
+        _registrationFlags = flags;
+    }
+
+    RegistrationFlags registrationFlags() const {
+        return _registrationFlags;
+    }
+
+    /*
+     *  The priority of the source. Changes take effect on the next wakeup
+     *  of the looper the source is in.
+     */
+
+    void setPriority(Priority priority) {
+        _priority = priority;
+    }
+
+    Priority priority() const {
+        return _priority;
+    }
+
     /*
      *  Interacting with a WaitSet
      */
-    void updateInWaitSetHandle(WaitSet::Handle handle, bool shouldAdd);
+    void updateInWaitSetHandle(WaitSet::Handle handle,
+                               WaitSetOperation operation);
 
     void setCustomWaitSetUpdateHandler(WaitSetUpdateHandler handler) {
         _customWaitSetUpdateHandler = handler;
@@ -152,6 +231,27 @@ class LooperSource {
         return _customWaitSetUpdateHandler;
     }
 
+    /*
+     *  The token identifying this source to the kernel in the wait set it is
+     *  currently present in. `WaitSet::InvalidToken` if it is not in one.
+     */
+    WaitSet::Token waitSetToken() const {
+        return _waitSetToken;
+    }
+
+    /*
+     *  How long the handlers of this source ran for each time it was
+     *  dispatched, in nanoseconds. Recorded by the looper the source is in.
+     *  Empty unless the library is built with instrumentation.
+     */
+    Histogram::Snapshot handlerTimes() const {
+#if CL_ENABLE_INSTRUMENTATION
+        return _handlerTimes.snapshot();
+#else
+        return Histogram::Snapshot();
+#endif
+    }
+
     /*
      *  Utility methods for creating commonly used sources
      */
@@ -169,6 +269,11 @@ class LooperSource {
 
     IOHandler _readHandler;
     IOHandler _writeHandler;
+    IOHandler _writableHandler;
+
+    RegistrationFlags _registrationFlags;
+
+    Priority _priority;
 
     WaitSetUpdateHandler _customWaitSetUpdateHandler;
 
@@ -176,6 +281,19 @@ class LooperSource {
 
     bool _handlesAllocated;
 
+    WaitSet::Token _waitSetToken;
+
+#if CL_ENABLE_INSTRUMENTATION
+    Histogram _handlerTimes;
+#endif
+
+    friend class WaitSet;
+    friend class Looper;
+
+    void setWaitSetToken(WaitSet::Token token) {
+        _waitSetToken = token;
+    }
+
     DISALLOW_COPY_AND_ASSIGN(LooperSource);
 };
 
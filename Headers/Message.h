@@ -42,6 +42,18 @@ class Message {
     explicit Message(size_t reservedLength = 0);
     explicit Message(const uint8_t *buffer, size_t bufferLength);
 
+    /**
+     *  Create a message that references the given buffer instead of copying
+     *  it. The message is read only and the buffer must outlive it.
+     *
+     *  @param buffer       the buffer to reference
+     *  @param bufferLength the length of the buffer
+     *  @param copy         if the buffer is copied. Always copied if true.
+     *
+     *  @return the message
+     */
+    explicit Message(const uint8_t *buffer, size_t bufferLength, bool copy);
+
     ~Message();
 
     bool reserve(size_t length);
@@ -62,9 +74,21 @@ class Message {
         return success;
     }
 
+    bool encodeBytes(const uint8_t *bytes, size_t length) {
+
+        bool success = reserve(_dataLength + length);
+
+        if (success && length > 0) {
+            memcpy(_buffer + _dataLength, bytes, length);
+            _dataLength += length;
+        }
+
+        return success;
+    }
+
     template <typename Type> bool decode(Type &value) {
 
-        if ((sizeof(Type) + _sizeRead) > _bufferLength) {
+        if ((sizeof(Type) + _sizeRead) > _dataLength) {
             return false;
         }
 
@@ -100,10 +124,22 @@ class Message {
         return _sizeRead;
     }
 
+    /**
+     *  Empty the message so that it can be reused. Its buffer and
+     *  attachment storage are retained. Attachments are not closed.
+     */
+    void reset();
+
   private:
+    /*
+     *  Sockets read records directly into the buffers of pooled messages
+     */
+    friend class Socket;
+
     bool resizeBuffer(size_t size);
 
     uint8_t *_buffer;
+    bool _ownsBuffer;
 
     size_t _bufferLength;
     size_t _dataLength;
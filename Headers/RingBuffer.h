@@ -22,14 +22,245 @@
   SOFTWARE.
 */
 
+
 #ifndef __CORELIB__RINGBUFFER__
 #define __CORELIB__RINGBUFFER__
 
-#include <stdio.h>
+#include "Base.h"
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
 
 namespace cl {
 
-class RingBuffer {};
+/**
+ *  A lock free, single producer, single consumer ring over a power of two
+ *  sized region. The ring may be used either as a stream of bytes or as a
+ *  sequence of variable length records, but not both at once.
+ *
+ *  Writers reserve space, fill it in place and then commit everything
+ *  reserved so far with a single release store. Readers peek at data in
+ *  place and then release everything peeked so far the same way. Batching
+ *  reservations and peeks amortizes the cache line transfers of the shared
+ *  indices over many items.
+ *
+ *  The region may be on the heap or in a shared memory mapping. The
+ *  producer and consumer may share one ring object or each attach their
+ *  own to the same region, possibly from different processes.
+ */
+class RingBuffer {
+  public:
+    typedef enum {
+        Success = 0,
+        Empty,
+        Corrupt,
+    } Status;
+
+    /**
+     *  The size of a region able to hold a ring of the given capacity
+     *
+     *  @param capacity the capacity. Rounded up to a power of two.
+     *
+     *  @return the size of the region in bytes
+     */
+    static size_t RegionSize(size_t capacity);
+
+    /**
+     *  Create a ring backed by memory owned by the ring
+     *
+     *  @param capacity the capacity. Rounded up to a power of two.
+     *
+     *  @return the ring or `nullptr` if memory could not be allocated
+     */
+    static std::unique_ptr<RingBuffer> Create(size_t capacity);
+
+    /**
+     *  Create a new empty ring in memory owned by the caller, such as a
+     *  shared memory mapping. The capacity is the largest power of two that
+     *  fits in the region. The region must be cache line aligned and must
+     *  outlive the ring.
+     *
+     *  @param region the region
+     *  @param size   the size of the region
+     *
+     *  @return the ring or `nullptr` if the region is not suitable
+     */
+    static std::unique_ptr<RingBuffer> Create(void *region, size_t size);
+
+    /**
+     *  Attach to a ring previously created in the given region, usually by
+     *  a peer. The contents of the region are validated since the peer may
+     *  not be trusted. The region must outlive the ring.
+     *
+     *  @param region the region
+     *  @param size   the size of the region
+     *
+     *  @return the ring or `nullptr` if the region does not contain a ring
+     */
+    static std::unique_ptr<RingBuffer> Attach(void *region, size_t size);
+
+    ~RingBuffer();
+
+    /*
+     *  The cursors are cache line aligned, which a plain new does not
+     *  guarantee before C++17
+     */
+    static void *operator new(size_t size) noexcept;
+    static void operator delete(void *pointer) noexcept;
+
+    size_t capacity() const {
+        return _capacity;
+    }
+
+    /*
+     *  The largest record payload that can ever be reserved
+     */
+    size_t maxRecordLength() const;
+
+    /*
+     *  Producer side
+     */
+
+    /**
+     *  Reserve contiguous space for bytes after those already reserved
+     *
+     *  @param length the number of bytes wanted. On return, the number of
+     *                bytes reserved. This may be less than what was wanted
+     *                if the ring is nearly full or wraps around.
+     *
+     *  @return the start of the reserved space or `nullptr` if the ring is
+     *          full
+     */
+    uint8_t *reserve(size_t &length);
+
+    /**
+     *  Reserve space for a record after those already reserved
+     *
+     *  @param length the length of the record payload
+     *  @param tag    a value carried alongside the payload, such as its type
+     *
+     *  @return the start of the payload or `nullptr` if there is not enough
+     *          space. A failed reservation may still skip the end of the
+     *          ring, so reservations should be committed before waiting on
+     *          the consumer for space.
+     */
+    uint8_t *reserveRecord(size_t length, uint32_t tag = 0);
+
+    /*
+     *  Make everything reserved so far visible to the consumer
+     */
+    void commit();
+
+    /**
+     *  Make everything reserved so far visible to the consumer and check if
+     *  the consumer had already read everything before it. Pairs with
+     *  `drained` on the consumer side.
+     *
+     *  @return true if the consumer may have found the ring empty and gone
+     *          idle, in which case it must be notified out of band
+     */
+    bool commitAndCheckIdle();
+
+    /**
+     *  Copy bytes into the ring and commit them
+     *
+     *  @param bytes  the bytes to write
+     *  @param length the number of bytes to write
+     *
+     *  @return the number of bytes written. Less than the length if the ring
+     *          filled up.
+     */
+    size_t write(const void *bytes, size_t length);
+
+    /*
+     *  Consumer side
+     */
+
+    /**
+     *  Peek at contiguous bytes after those already peeked
+     *
+     *  @param length the number of bytes wanted. On return, the number of
+     *                bytes peeked.
+     *
+     *  @return the start of the bytes or `nullptr` if the ring is empty
+     */
+    const uint8_t *peek(size_t &length);
+
+    /**
+     *  Peek at the next record after those already peeked. The payload
+     *  stays valid till the record is released.
+     *
+     *  @param payload on success, the start of the record payload
+     *  @param length  on success, the length of the record payload
+     *  @param tag     on success, the value reserved with the record
+     *
+     *  @return the status of the peek. The ring must not be used after it is
+     *          found to be corrupt.
+     */
+    Status peekRecord(const uint8_t *&payload, size_t &length);
+    Status peekRecord(const uint8_t *&payload, size_t &length,
+                      uint32_t &tag);
+
+    /*
+     *  Give everything peeked so far back to the producer
+     */
+    void release();
+
+    /*
+     *  Forget everything peeked since the last release so that it is peeked
+     *  again
+     */
+    void unpeek();
+
+    /**
+     *  Release everything peeked so far and check if the ring is still
+     *  empty. A consumer must check this before going idle since the
+     *  producer only asks for it to be notified if it had read everything.
+     *  Padding skipped at the end of the ring counts as read.
+     *
+     *  @return true if there is nothing left to peek
+     */
+    bool drained();
+
+    /**
+     *  Copy bytes out of the ring and release them
+     *
+     *  @param bytes  the buffer to read into
+     *  @param length the size of the buffer
+     *
+     *  @return the number of bytes read
+     */
+    size_t read(void *bytes, size_t length);
+
+  private:
+    struct Header;
+
+    /*
+     *  The position of one side along with its last seen position of the
+     *  other side. Each is only touched by its own side, so they are kept
+     *  on separate cache lines.
+     */
+    struct alignas(64) Cursor {
+        uint64_t position;
+        uint64_t peerPosition;
+    };
+
+    Header *_header;
+    uint8_t *_data;
+    size_t _capacity;
+    void *_ownedRegion;
+
+    Cursor _producer;
+    Cursor _consumer;
+
+    RingBuffer(void *region, size_t capacity, void *ownedRegion);
+
+    size_t freeSpace(size_t wanted);
+    size_t usedSpace(size_t wanted);
+
+    DISALLOW_COPY_AND_ASSIGN(RingBuffer);
+};
 
 }
 
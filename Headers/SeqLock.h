@@ -0,0 +1,157 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__SEQLOCK__
+#define __CORELIB__SEQLOCK__
+
+#include "Base.h"
+
+#include <atomic>
+#include <string.h>
+#include <stdint.h>
+#include <type_traits>
+
+namespace cl {
+
+/*
+ *  Guards a small value that is read far more often than it is written.
+ *  Readers never write to shared memory, so they do not contend with each
+ *  other at all. They copy the value and retry if a writer changed it
+ *  meanwhile. Writers are serialized among themselves.
+ *
+ *  Only plain data can be guarded, since readers may copy a torn value
+ *  before retrying. The seqlock holds no pointers or handles, so it may be
+ *  placed in shared memory (with placement new) and used by all processes
+ *  that map it.
+ */
+template <class T>
+class SeqLock {
+  public:
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only plain data can be guarded by a seqlock");
+
+    explicit SeqLock(const T &value = T()) : _sequence(0) {
+        storeWords(value);
+    }
+
+    /**
+     *  Read a consistent copy of the value
+     *
+     *  @return the value
+     */
+    T load() const {
+        T value;
+
+        while (!tryLoad(value)) {
+            CL_CPU_PAUSE();
+        }
+
+        return value;
+    }
+
+    /**
+     *  Read the value without waiting for a writer to finish
+     *
+     *  @param value the value read. Left as is on failure.
+     *
+     *  @return if a consistent value was read
+     */
+    bool tryLoad(T &value) const {
+        const uint32_t sequence = _sequence.load(std::memory_order_acquire);
+
+        if ((sequence & 1) != 0) {
+            return false;
+        }
+
+        uint64_t words[WordCount];
+
+        for (size_t i = 0; i < WordCount; i++) {
+            words[i] = _words[i].load(std::memory_order_relaxed);
+        }
+
+        /*
+         *  Keeps the copy above from being reordered after the check below
+         */
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (_sequence.load(std::memory_order_relaxed) != sequence) {
+            return false;
+        }
+
+        memcpy(&value, words, sizeof(T));
+        return true;
+    }
+
+    /**
+     *  Replace the value. Readers retry till the write is complete.
+     *
+     *  @param value the new value
+     */
+    void store(const T &value) {
+        uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+
+        /*
+         *  An odd sequence marks a write in progress
+         */
+        while ((sequence & 1) != 0 ||
+               !_sequence.compare_exchange_weak(sequence, sequence + 1,
+                                                std::memory_order_relaxed)) {
+            CL_CPU_PAUSE();
+            sequence = _sequence.load(std::memory_order_relaxed);
+        }
+
+        /*
+         *  Keeps the stores below from being reordered before the odd
+         *  sequence is visible
+         */
+        std::atomic_thread_fence(std::memory_order_release);
+
+        storeWords(value);
+
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+  private:
+    static const size_t WordCount = (sizeof(T) + 7) / 8;
+
+    std::atomic<uint32_t> _sequence;
+    std::atomic<uint64_t> _words[WordCount];
+
+    void storeWords(const T &value) {
+        uint64_t words[WordCount] = {0};
+
+        memcpy(words, &value, sizeof(T));
+
+        for (size_t i = 0; i < WordCount; i++) {
+            _words[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(SeqLock);
+};
+
+}
+
+#endif /* defined(__CORELIB__SEQLOCK__) */
@@ -31,6 +31,7 @@
 #include <functional>
 
 #include "LooperSource.h"
+#include "LooperPool.h"
 #include "Channel.h"
 
 namespace cl {
@@ -42,7 +43,21 @@ class Server {
     typedef std::function<void(std::shared_ptr<Channel>)>
         ChannelAvailabilityCallback;
 
-    explicit Server(std::string name);
+    /*
+     *  The listen backlog used by default. The system may clamp it further.
+     */
+    static const int DefaultBacklog;
+
+    /**
+     *  Create a server listening on the named endpoint
+     *
+     *  @param name    the name of the endpoint
+     *  @param backlog the maximum number of pending connections before
+     *                 clients are refused
+     *
+     *  @return the server
+     */
+    explicit Server(std::string name, int backlog = DefaultBacklog);
     ~Server();
 
     std::shared_ptr<LooperSource> clientConnectionsSource();
@@ -63,17 +78,42 @@ class Server {
         return _channelAvailablilityCallback;
     }
 
+    /*
+     *  Sharding accepted channels across a looper pool. When a pool is set,
+     *  each accepted channel is handed to a looper in the pool chosen by
+     *  the selection policy of the pool. The availability callback is
+     *  invoked on the thread of that looper, after which the channel is
+     *  scheduled in it. The callback is responsible for unscheduling the
+     *  channel from that looper before collecting it. The pool must outlive
+     *  the server.
+     */
+
+    void channelLooperPool(LooperPool *pool) {
+        _channelLooperPool = pool;
+    }
+
+    LooperPool *channelLooperPool() const {
+        return _channelLooperPool;
+    }
+
   private:
     std::string _name;
 
     Handle _socketHandle;
+    Handle _reserveHandle;
+    bool _descriptorsExhausted;
     bool _listening;
 
     std::shared_ptr<LooperSource> _clientConnectionsSource;
 
     ChannelAvailabilityCallback _channelAvailablilityCallback;
 
+    LooperPool *_channelLooperPool;
+
     void onConnectionAvailableForAccept(Handle handle);
+    void onConnectionAccepted(Handle connectionHandle);
+    bool shedConnectionOnDescriptorExhaustion();
+    void pauseAccepting();
 
     DISALLOW_COPY_AND_ASSIGN(Server);
 };
@@ -0,0 +1,138 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__SHAREDLOCK__
+#define __CORELIB__SHAREDLOCK__
+
+#include "Base.h"
+#include "Futex.h"
+
+#include <atomic>
+#include <stdint.h>
+
+namespace cl {
+
+/*
+ *  A reader-writer lock for state that is read often and written rarely.
+ *  Readers only contend on the lock word while a writer holds or waits for
+ *  the lock. Waiting writers keep new readers out, so a steady stream of
+ *  readers cannot starve them.
+ *
+ *  Locks with a shared scope may be placed in shared memory (with placement
+ *  new) and used by all processes that map it.
+ */
+class SharedLock {
+  public:
+    explicit SharedLock(Futex::Scope scope = Futex::ScopePrivate)
+        : _state(0), _waitingWriters(0), _scope(scope) {
+    }
+
+    /*
+     *  Acquire the lock for writing
+     */
+    void lock() const;
+
+    void unlock() const;
+
+    /*
+     *  Acquire the lock for reading, alongside other readers
+     */
+    void lockShared() const {
+        uint32_t state = _state.load(std::memory_order_relaxed);
+
+        if ((state & (Writer | WriterWaiting)) != 0 ||
+            !_state.compare_exchange_weak(state, state + 1,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed)) {
+            lockSharedContended();
+        }
+    }
+
+    void unlockShared() const {
+        const uint32_t previous =
+            _state.fetch_sub(1, std::memory_order_release);
+
+        if ((previous & ReaderMask) == 1 && (previous & Parked) != 0) {
+            wakeParked();
+        }
+    }
+
+  private:
+    /*
+     *  The lock word holds the number of readers in the low bits. Parked
+     *  is set by anyone about to wait on the word, so that only unlocks
+     *  with waiters make a system call.
+     */
+    static const uint32_t ReaderMask = (1u << 29) - 1;
+    static const uint32_t Parked = 1u << 29;
+    static const uint32_t WriterWaiting = 1u << 30;
+    static const uint32_t Writer = 1u << 31;
+
+    mutable std::atomic<uint32_t> _state;
+    mutable std::atomic<uint32_t> _waitingWriters;
+    const Futex::Scope _scope;
+
+    void lockSharedContended() const;
+    bool park(uint32_t &state) const;
+    void wakeParked() const;
+
+    DISALLOW_COPY_AND_ASSIGN(SharedLock);
+};
+
+class AutoSharedLock {
+  public:
+    AutoSharedLock(const SharedLock &lock) : _lock(lock) {
+        _lock.lockShared();
+    }
+
+    ~AutoSharedLock() {
+        _lock.unlockShared();
+    }
+
+  private:
+    const SharedLock &_lock;
+
+    DISALLOW_COPY_AND_ASSIGN(AutoSharedLock);
+};
+
+class AutoExclusiveLock {
+  public:
+    AutoExclusiveLock(const SharedLock &lock) : _lock(lock) {
+        _lock.lock();
+    }
+
+    ~AutoExclusiveLock() {
+        _lock.unlock();
+    }
+
+  private:
+    const SharedLock &_lock;
+
+    DISALLOW_COPY_AND_ASSIGN(AutoExclusiveLock);
+};
+
+}
+
+#endif /* defined(__CORELIB__SHAREDLOCK__) */
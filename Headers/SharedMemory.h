@@ -28,6 +28,8 @@
 
 #include "Base.h"
 #include <string>
+#include <memory>
+#include <stdint.h>
 
 namespace cl {
 
@@ -36,15 +38,85 @@ typedef int Handle;
 class SharedMemory {
 
   public:
-    explicit SharedMemory(size_t size);
+    /*
+     *  Options for creating a region
+     */
+    typedef enum {
+        /*
+         *  Back the region with huge pages if any are reserved, rounding
+         *  its size up to a multiple of the huge page size. Otherwise ask
+         *  for transparent huge pages.
+         */
+        OptionHugePages = 1 << 0,
+        /*
+         *  Fault in all pages of the mapping up front instead of on first
+         *  touch
+         */
+        OptionPrefault = 1 << 1,
+    } Option;
+
+    typedef uint32_t Options;
+
+    /*
+     *  Seals restrict what anyone holding a handle to the region may do to
+     *  it, so that a receiver can rely on a region provided by a peer. Seals
+     *  can only ever be added. Where sealing is not supported, sealing
+     *  always succeeds and required seals are not checked.
+     */
+    typedef enum {
+        SealShrink = 1 << 0,
+        SealGrow = 1 << 1,
+        SealWrite = 1 << 2,
+    } Seal;
+
+    typedef uint32_t Seals;
+
+    explicit SharedMemory(size_t size, Options options = 0);
+
+    /**
+     *  Map an existing shared memory region, usually one received from a
+     *  peer as an attachment. The size of the mapping is the size of the
+     *  region. Regions sealed against writes are mapped read only.
+     *  Ownership of the handle is assumed by the shared memory object.
+     *
+     *  @param handle        the handle to the shared memory region
+     *  @param requiredSeals the seals the region must have
+     *  @param options       the options for the mapping. Only
+     *                       `OptionPrefault` applies.
+     *
+     *  @return the shared memory. Not ready if the region could not be
+     *          mapped or is missing a required seal.
+     */
+    static std::unique_ptr<SharedMemory> Map(Handle handle,
+                                             Seals requiredSeals = 0,
+                                             Options options = 0);
+
+    static bool SupportsSealing();
+
     ~SharedMemory();
 
     void cleanup();
 
+    /**
+     *  Add seals to the region. Sealing against writes remaps the region
+     *  read only, and fails if anyone else still has it mapped writable.
+     *
+     *  @param seals the seals to add
+     *
+     *  @return if the seals were added
+     */
+    bool seal(Seals seals);
+
+    Seals seals() const;
+
     bool isReady() const {
         return _ready;
     }
 
+    bool isWritable() const {
+        return _writable;
+    }
+
     void *address() const {
         return _address;
     }
@@ -58,11 +130,23 @@ class SharedMemory {
     }
 
   private:
+    SharedMemory();
+
     Handle _handle;
     size_t _size;
     void *_address;
 
     bool _ready;
+    bool _writable;
+
+    /*
+     *  Create the handle and map the region. Sets up the handle, size and
+     *  address, leaving whatever was setup in place on failure.
+     */
+    bool platformCreate(size_t size, Options options);
+    bool platformMap(bool writable, Options options);
+    bool platformAddSeals(Seals seals);
+    Seals platformSeals() const;
 
     DISALLOW_COPY_AND_ASSIGN(SharedMemory);
 };
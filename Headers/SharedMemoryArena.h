@@ -0,0 +1,198 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__SHAREDMEMORYARENA__
+#define __CORELIB__SHAREDMEMORYARENA__
+
+#include "Base.h"
+#include "Lock.h"
+#include "SharedMemory.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+namespace cl {
+
+/**
+ *  Hands out blocks carved from a few large shared memory regions, so that
+ *  a buffer for another process costs a pointer bump instead of a new
+ *  region. Blocks come in power of two size classes and are referred to by
+ *  handles that are valid in every process that maps the regions.
+ *
+ *  Only the owner that created the arena allocates. Blocks may be freed by
+ *  any process that maps their region. They go back on a lock free free
+ *  list for their size class kept inside the region, where the owner picks
+ *  them up again.
+ *
+ *  The handles of regions must be sent to peers (usually as attachments)
+ *  before handles of blocks in them.
+ */
+class SharedMemoryArena {
+  public:
+    typedef uint64_t Block;
+
+    static const Block InvalidBlock = 0;
+
+    static const size_t DefaultRegionSize;
+    static const size_t DefaultMaxRegionCount = 8;
+    static const size_t MaxRegionCount = 256;
+
+    static const size_t MinBlockSize = 64;
+    static const size_t SizeClassCount = 15;
+
+    /**
+     *  Create an arena owned by the calling process. The first region is
+     *  created right away.
+     *
+     *  @param regionSize     the size of each region. Rounded up to a
+     *                        multiple of the largest block size.
+     *  @param maxRegionCount the most regions the arena may grow to
+     *
+     *  @return the arena or `nullptr` if the first region could not be
+     *          created
+     */
+    static std::unique_ptr<SharedMemoryArena>
+    Create(size_t regionSize = DefaultRegionSize,
+           size_t maxRegionCount = DefaultMaxRegionCount);
+
+    /**
+     *  Create an empty arena for a peer of the owner. Regions are added to
+     *  it as their handles arrive.
+     *
+     *  @return the arena
+     */
+    static std::unique_ptr<SharedMemoryArena> Attach();
+
+    ~SharedMemoryArena();
+
+    /*
+     *  The size of the largest block that can be allocated
+     */
+    static size_t MaxBlockSize();
+
+    /*
+     *  The number of region slots in use, including those not mapped yet by
+     *  a peer
+     */
+    size_t regionCount() const {
+        return _regionCount.load(std::memory_order_acquire);
+    }
+
+    /**
+     *  The handle of a region for sending to peers
+     *
+     *  @param index the index of the region
+     *
+     *  @return the handle or -1 if the region is not mapped
+     */
+    Handle regionHandle(size_t index) const;
+
+    /**
+     *  Map a region received from the owner. The region is validated since
+     *  the owner may not be trusted.
+     *
+     *  @param handle the handle of the region. Ownership is assumed by the
+     *                arena.
+     *
+     *  @return if the region was mapped
+     */
+    bool mapRegion(Handle handle);
+
+    /**
+     *  Allocate a block. Only the owner may allocate.
+     *
+     *  @param size the size needed. The block may be larger.
+     *
+     *  @return the block or `InvalidBlock` if the size is too large or the
+     *          arena is full
+     */
+    Block allocate(size_t size);
+
+    /**
+     *  Return a block to its region. May be called from any thread of any
+     *  process that maps the region.
+     *
+     *  @param block the block. Invalid blocks are ignored.
+     */
+    void free(Block block);
+
+    /**
+     *  The address of a block in the calling process
+     *
+     *  @param block the block
+     *
+     *  @return the address or `nullptr` if the block is not valid or its
+     *          region is not mapped
+     */
+    uint8_t *address(Block block) const;
+
+    /*
+     *  The usable size of a block. Zero for blocks that are not valid.
+     */
+    size_t size(Block block) const;
+
+  private:
+    struct RegionHeader;
+
+    /*
+     *  Blocks start right after the header of their region
+     */
+    static const uint64_t DataOffset;
+
+    static bool IsValidOffset(uint64_t offset, size_t sizeClass,
+                              size_t regionSize);
+
+    struct Region {
+        std::unique_ptr<SharedMemory> memory;
+        RegionHeader *header;
+    };
+
+    const bool _owner;
+    const size_t _regionSize;
+    const size_t _maxRegionCount;
+
+    std::atomic<Region *> _regions[MaxRegionCount];
+    std::atomic<size_t> _regionCount;
+
+    Lock _regionsLock;
+    std::vector<std::unique_ptr<Region>> _ownedRegions;
+
+    SharedMemoryArena(bool owner, size_t regionSize, size_t maxRegionCount);
+
+    Region *region(Block block, size_t &sizeClass, uint64_t &offset) const;
+    bool addRegion(std::unique_ptr<Region> region, size_t index);
+    bool createRegion(size_t index);
+
+    Block pop(Region &region, size_t index, size_t sizeClass);
+    Block bump(Region &region, size_t index, size_t sizeClass);
+
+    DISALLOW_COPY_AND_ASSIGN(SharedMemoryArena);
+};
+
+}
+
+#endif /* defined(__CORELIB__SHAREDMEMORYARENA__) */
@@ -0,0 +1,191 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__SHAREDMEMORYRING__
+#define __CORELIB__SHAREDMEMORYRING__
+
+#include "Base.h"
+#include "LooperSource.h"
+#include "RingBuffer.h"
+#include "SharedMemory.h"
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+namespace cl {
+
+/*
+ *  A single producer, single consumer ring of records between processes.
+ *  The records live in a shared memory region and the consumer services
+ *  them from a looper source. The producer only rings the doorbell of the
+ *  consumer when it has parked after finding the ring empty, so a busy
+ *  consumer is fed without any system calls.
+ *
+ *  The consumer creates the ring and sends its memory and doorbell handles
+ *  to the producer (usually as attachments), which opens its side with
+ *  them.
+ */
+class SharedMemoryRing {
+  public:
+    static const size_t DefaultCapacity;
+    static const size_t DefaultReadBudget = 64;
+
+    /*
+     *  Invoked on the consumer for each record. The payload is only valid
+     *  for the duration of the call.
+     */
+    typedef std::function<void(const uint8_t *payload, size_t length)>
+        RecordHandler;
+
+    /**
+     *  Create the consumer side of a ring in a new shared memory region
+     *
+     *  @param capacity the space available for records. Rounded up to a
+     *                  power of two.
+     *
+     *  @return the ring or `nullptr` if the region could not be setup
+     */
+    static std::unique_ptr<SharedMemoryRing> Create(size_t capacity);
+
+    /**
+     *  Open the producer side of a ring created by a consumer. The region is
+     *  validated since the consumer may not be trusted.
+     *
+     *  @param memoryHandle   the handle to the region
+     *  @param doorbellHandle the handle to the doorbell of the consumer
+     *
+     *  Ownership of both handles is assumed by the ring.
+     *
+     *  @return the ring or `nullptr` if the region is not valid
+     */
+    static std::unique_ptr<SharedMemoryRing> Open(Handle memoryHandle,
+                                                  Handle doorbellHandle);
+
+    ~SharedMemoryRing();
+
+    Handle memoryHandle() const {
+        return _memory->handle();
+    }
+
+    Handle doorbellHandle() const;
+
+    size_t capacity() const {
+        return _ring->capacity();
+    }
+
+    size_t maxRecordLength() const {
+        return _ring->maxRecordLength();
+    }
+
+    /*
+     *  Producer side
+     */
+
+    /**
+     *  Reserve space for a record after those already reserved
+     *
+     *  @param length the length of the record payload
+     *
+     *  @return the start of the payload or `nullptr` if there is not enough
+     *          space
+     */
+    uint8_t *reserve(size_t length);
+
+    /*
+     *  Make the reserved records visible to the consumer and ring its
+     *  doorbell if it is parked
+     */
+    void commit();
+
+    /**
+     *  Copy a record into the ring and commit it
+     *
+     *  @param payload the record payload
+     *  @param length  the length of the payload
+     *
+     *  @return if the record was written. Fails if there is not enough
+     *          space.
+     */
+    bool write(const uint8_t *payload, size_t length);
+
+    /*
+     *  Consumer side
+     */
+
+    /*
+     *  The source that reads records on the looper it is added to. It must
+     *  be removed from the looper before the ring is destroyed.
+     */
+    std::shared_ptr<LooperSource> source() const {
+        return _source;
+    }
+
+    void recordHandler(RecordHandler handler) {
+        _recordHandler = handler;
+    }
+
+    /*
+     *  The most records read per wakeup of the looper before other sources
+     *  get a chance to run. Zero is treated as one.
+     */
+    void readBudget(size_t budget) {
+        _readBudget = budget == 0 ? 1 : budget;
+    }
+
+    /*
+     *  Set once the producer is found to have corrupted the ring, after
+     *  which nothing more is read
+     */
+    bool isCorrupt() const {
+        return _corrupt;
+    }
+
+  private:
+    struct Header;
+
+    std::unique_ptr<SharedMemory> _memory;
+    Header *_header;
+    std::unique_ptr<RingBuffer> _ring;
+
+    std::shared_ptr<LooperSource> _source;
+    RecordHandler _recordHandler;
+    size_t _readBudget;
+    bool _corrupt;
+
+    Handle _doorbell;
+    LooperSource::IOHandler _ringDoorbell;
+
+    SharedMemoryRing(std::unique_ptr<SharedMemory> memory,
+                     std::unique_ptr<RingBuffer> ring);
+
+    void readRecords();
+
+    DISALLOW_COPY_AND_ASSIGN(SharedMemoryRing);
+};
+
+}
+
+#endif /* defined(__CORELIB__SHAREDMEMORYRING__) */
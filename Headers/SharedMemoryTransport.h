@@ -0,0 +1,140 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef __CORELIB__SHAREDMEMORYTRANSPORT__
+#define __CORELIB__SHAREDMEMORYTRANSPORT__
+
+#include "Base.h"
+#include "RingBuffer.h"
+#include "SharedMemory.h"
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+namespace cl {
+
+/*
+ *  A single producer, single consumer ring of variable length records that
+ *  lives entirely in a shared memory region. The records are kept in a
+ *  `RingBuffer` and tagged with their attachment count. The producer creates the
+ *  region and hands its handle to the consumer (usually in another process)
+ *  as an attachment. Neither side makes any system calls to move records.
+ *  Instead, the producer is told when the consumer may have gone idle so
+ *  that it can be notified out of band.
+ */
+class SharedMemoryTransport {
+  public:
+    static const size_t DefaultCapacity;
+
+    typedef enum {
+        Success = 0,
+        InsufficientSpace,
+        RecordTooLarge,
+    } Status;
+
+    /*
+     *  Invoked for each record read from the transport. The payload is only
+     *  valid for the duration of the call. Returning false stops the read
+     *  and leaves the record in the ring to be read again later.
+     */
+    typedef std::function<bool(const uint8_t *payload, size_t length,
+                               uint32_t attachmentCount)> RecordHandler;
+
+    /**
+     *  Create the producer side of a transport in a new shared memory region
+     *
+     *  @param capacity the space available for records. Rounded up to a
+     *                  power of two.
+     *
+     *  @return the transport or `nullptr` if the region could not be setup
+     */
+    static std::unique_ptr<SharedMemoryTransport> Create(size_t capacity);
+
+    /**
+     *  Create the consumer side of a transport from a region setup by a
+     *  producer. The contents of the region are validated since the peer is
+     *  not trusted.
+     *
+     *  @param handle the handle to the region. Ownership is assumed by the
+     *                transport.
+     *
+     *  @return the transport or `nullptr` if the region is not valid
+     */
+    static std::unique_ptr<SharedMemoryTransport> Open(Handle handle);
+
+    Handle handle() const {
+        return _memory->handle();
+    }
+
+    size_t capacity() const {
+        return _ring->capacity();
+    }
+
+    /*
+     *  The largest record payload that can ever be written
+     */
+    size_t maxRecordLength() const;
+
+    /**
+     *  Write a record. Only the producer may write.
+     *
+     *  @param payload         the record payload
+     *  @param length          the length of the payload
+     *  @param attachmentCount the number of attachments the consumer should
+     *                         associate with this record
+     *  @param notify          set if the consumer may be idle and must be
+     *                         notified of new records. This may be set even
+     *                         if the write fails for lack of space.
+     *
+     *  @return the status of the write
+     */
+    Status write(const uint8_t *payload, size_t length,
+                 uint32_t attachmentCount, bool &notify);
+
+    /**
+     *  Read all available records. Only the consumer may read.
+     *
+     *  @param handler the handler invoked for each record
+     *
+     *  @return false if the region was found to be corrupt. The transport
+     *          must not be used after that.
+     */
+    bool read(RecordHandler handler);
+
+    ~SharedMemoryTransport();
+
+  private:
+    std::unique_ptr<SharedMemory> _memory;
+    std::unique_ptr<RingBuffer> _ring;
+
+    SharedMemoryTransport(std::unique_ptr<SharedMemory> memory,
+                          std::unique_ptr<RingBuffer> ring);
+
+    DISALLOW_COPY_AND_ASSIGN(SharedMemoryTransport);
+};
+
+}
+
+#endif /* defined(__CORELIB__SHAREDMEMORYTRANSPORT__) */
@@ -29,9 +29,13 @@
 #include "Base.h"
 #include "AutoLock.h"
 
+#include <atomic>
 #include <utility>
 #include <string>
 #include <vector>
+#include <memory>
+#include <functional>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <stdint.h>
 
@@ -43,6 +47,7 @@ class Socket {
 
   public:
     static const size_t MaxBufferSize;
+    static const size_t MaxBatchCount;
     static const size_t MaxControlBufferItemCount;
     static const size_t ControlBufferItemSize;
     static const size_t MaxControlBufferSize;
@@ -53,9 +58,12 @@ class Socket {
         Success = 0,
         TemporaryFailure,
         PermanentFailure,
+        WouldBlock,
     } Status;
 
-    typedef std::pair<Status, std::vector<std::unique_ptr<Message>>> ReadResult;
+    typedef std::vector<std::unique_ptr<Message>> Messages;
+    typedef std::pair<Status, Messages> ReadResult;
+    typedef std::function<void(Message &)> MessageHandler;
     typedef std::pair<std::unique_ptr<Socket>, std::unique_ptr<Socket>> Pair;
 
     /*
@@ -82,17 +90,164 @@ class Socket {
      *  Reading and writing messages on sockets
      */
 
-    Status WriteMessage(Message &message);
+    /**
+     *  Write the message as a single record
+     *
+     *  @param message      the message to write
+     *  @param prefix       bytes written to the record before the contents
+     *                      of the message. May be null.
+     *  @param prefixLength the number of prefix bytes
+     *
+     *  @return the status of the write
+     */
+    Status WriteMessage(Message &message, const uint8_t *prefix = nullptr,
+                        size_t prefixLength = 0);
+
+    /**
+     *  Write each message as its own record using as few system calls as
+     *  possible. Records are written in batches of up to `MaxBatchCount`.
+     *
+     *  @param messages     the messages to write in order
+     *  @param prefix       bytes written to each record before the contents
+     *                      of its message. May be null.
+     *  @param prefixLength the number of prefix bytes
+     *
+     *  @return the status of the write. Messages before the one that failed
+     *          have been written.
+     */
+    Status WriteMessages(const std::vector<Message *> &messages,
+                         const uint8_t *prefix = nullptr,
+                         size_t prefixLength = 0);
+
+    /**
+     *  Write as many of the messages as fit in the socket buffer without
+     *  waiting for the peer to make space
+     *
+     *  @param messages     the messages to write in order
+     *  @param count        the number of messages
+     *  @param written      set to the number of messages written, even on
+     *                      failure
+     *  @param prefix       bytes written to each record before the contents
+     *                      of its message. May be null.
+     *  @param prefixLength the number of prefix bytes
+     *
+     *  @return `WouldBlock` if the socket buffer filled up before all
+     *          messages were written
+     */
+    Status TryWriteMessages(Message *const *messages, size_t count,
+                            size_t &written, const uint8_t *prefix = nullptr,
+                            size_t prefixLength = 0);
+
+    /**
+     *  Read all pending records, up to `MaxBatchCount` per system call
+     *
+     *  @return the status of the read and the messages read
+     */
     ReadResult ReadMessages();
 
+    /**
+     *  Read pending records directly into messages taken from the pool of
+     *  this socket. Reading stops once the socket is drained or `maxCount`
+     *  records have been read. Messages should be handed back via
+     *  `RecycleMessages` once the caller is done with them.
+     *
+     *  @param messages the messages read are appended to this collection
+     *  @param maxCount the maximum number of records to read
+     *
+     *  @return the status of the read
+     */
+    Status ReadMessages(Messages &messages, size_t maxCount);
+
+    /**
+     *  Read pending records and hand each one to the handler as soon as its
+     *  batch has been read. Nothing is retained between reads. The handler
+     *  must not hold on to the message or its buffer.
+     *
+     *  @param handler   invoked for each record read
+     *  @param maxCount  the maximum number of records to read
+     *  @param readCount set to the number of records read. If this is less
+     *                   than `maxCount`, the socket has been drained.
+     *
+     *  @return the status of the read
+     */
+    Status ReadMessages(const MessageHandler &handler, size_t maxCount,
+                        size_t &readCount);
+
+    /**
+     *  Return messages read from this socket to its pool so that their
+     *  buffers can be reused by subsequent reads
+     *
+     *  @param messages the messages to recycle. Cleared on return.
+     */
+    void RecycleMessages(Messages &messages);
+
     Handle handle() const {
         return _handle;
     }
 
+    /*
+     *  Thread affinity
+     */
+
+    /**
+     *  Bind the socket to the calling thread. A bound socket takes no locks
+     *  when reading and writing, so only that thread may use it till it is
+     *  unbound. Debug builds assert this. Must not be called while other
+     *  threads use the socket.
+     */
+    void bindToCurrentThread();
+
+    void unbindFromThread();
+
+    bool isBoundToThread() const {
+        return _boundToThread.load(std::memory_order_acquire);
+    }
+
+    bool isBoundToCurrentThread() const {
+        return isBoundToThread() && pthread_equal(_boundThread, pthread_self());
+    }
+
   protected:
     Lock _lock;
 
-    uint8_t *_buffer;
+    std::atomic<bool> _boundToThread;
+    pthread_t _boundThread;
+
+    /*
+     *  The lock to hold while using the socket, `nullptr` if it is bound to
+     *  the calling thread
+     */
+    const Lock *accessLock() const;
+
+    Status writeRecords(Message *const *messages, size_t count,
+                        const uint8_t *prefix, size_t prefixLength, bool wait,
+                        size_t &written);
+
+    /*
+     *  Send and receive records in batches. Both return the number of
+     *  records transferred, or -1 with errno set if not even the first one
+     *  could be. Receiving stops early at an orderly shutdown.
+     */
+    static int platformSendRecords(Handle handle, struct msghdr *headers,
+                                   size_t count);
+    static int platformReceiveRecords(Handle handle, struct msghdr *headers,
+                                      size_t *lengths, size_t count);
+
+    /*
+     *  Pool access and reading a single batch. Must be called with the
+     *  access lock held.
+     */
+    std::unique_ptr<Message> acquireMessage();
+    void relinquishMessages(std::unique_ptr<Message> *messages, size_t count);
+    Status readRecords(std::unique_ptr<Message> *batch, size_t batchCount,
+                       size_t &received);
+
+    /*
+     *  Messages with buffers large enough for any record, ready to be read
+     *  into. Guarded by the access lock.
+     */
+    Messages _messagePool;
+
     uint8_t *_controlBuffer;
 
     Handle _handle;
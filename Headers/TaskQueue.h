@@ -0,0 +1,88 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__TASKQUEUE__
+#define __CORELIB__TASKQUEUE__
+
+#include "Base.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+namespace cl {
+
+/**
+ *  A lock-free multiple producer, single consumer queue of tasks. Producers
+ *  may push from any thread. Only one thread may drain the queue, and it
+ *  takes all pending tasks at once.
+ */
+class TaskQueue {
+  public:
+    typedef std::function<void(void)> Task;
+    typedef std::chrono::steady_clock Clock;
+
+    typedef std::function<void(Task &task, Clock::time_point fireTime)>
+        DrainHandler;
+
+    TaskQueue();
+    ~TaskQueue();
+
+    /**
+     *  Push a task onto the queue
+     *
+     *  @param task     the task to push
+     *  @param fireTime the earliest time at which the task may be run
+     *
+     *  @return if the queue was empty before the push. Producers use this to
+     *          only signal the consumer once per batch.
+     */
+    bool push(Task task, Clock::time_point fireTime);
+
+    /**
+     *  Take all pending tasks and hand them to the handler in the order in
+     *  which they were pushed. Must only be called on the consumer thread.
+     *
+     *  @param handler the handler invoked for each task
+     *
+     *  @return the number of tasks drained
+     */
+    size_t drain(DrainHandler handler);
+
+  private:
+    struct Entry {
+        Task task;
+        Clock::time_point fireTime;
+        Entry *next;
+    };
+
+    std::atomic<Entry *> _head;
+
+    DISALLOW_COPY_AND_ASSIGN(TaskQueue);
+};
+
+}
+
+#endif /* defined(__CORELIB__TASKQUEUE__) */
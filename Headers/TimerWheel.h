@@ -0,0 +1,173 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef __CORELIB__TIMERWHEEL__
+#define __CORELIB__TIMERWHEEL__
+
+#include "Base.h"
+
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+
+namespace cl {
+
+/**
+ *  A hierarchical timing wheel. Scheduling, cancelling and rescheduling a
+ *  timer are all constant time operations, and no descriptors are used per
+ *  timer. The wheel is not thread safe and must only be accessed on the
+ *  thread that advances it.
+ */
+class TimerWheel {
+  private:
+    struct Link {
+        Link *prev;
+        Link *next;
+    };
+
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    class Timer : private Link {
+      public:
+        typedef std::function<void(void)> Callback;
+
+        explicit Timer(Callback callback = nullptr);
+
+        /**
+         *  Timers are cancelled when collected
+         */
+        ~Timer();
+
+        void setCallback(Callback callback) {
+            _callback = callback;
+        }
+
+        Callback callback() const {
+            return _callback;
+        }
+
+        bool isScheduled() const {
+            return _wheel != nullptr;
+        }
+
+      private:
+        friend class TimerWheel;
+
+        TimerWheel *_wheel;
+        Link *_slot;
+
+        uint64_t _expiryTick;
+        uint64_t _repeatTicks;
+
+        Callback _callback;
+
+        DISALLOW_COPY_AND_ASSIGN(Timer);
+    };
+
+    explicit TimerWheel(
+        std::chrono::nanoseconds resolution = std::chrono::milliseconds(1));
+    ~TimerWheel();
+
+    /**
+     *  Schedule (or reschedule) the timer. A timer that is already scheduled
+     *  is moved to its new deadline.
+     *
+     *  @param timer          the timer to schedule
+     *  @param delay          the minimum delay before the timer fires
+     *  @param repeatInterval the interval at which the timer repeats after
+     *                        firing the first time. Zero for one-shot timers.
+     */
+    void schedule(Timer &timer, std::chrono::nanoseconds delay,
+                  std::chrono::nanoseconds repeatInterval =
+                      std::chrono::nanoseconds(0));
+
+    void cancel(Timer &timer);
+
+    /**
+     *  Fire all timers whose deadline is at or before the given time
+     *
+     *  @param now the current time
+     *
+     *  @return the number of timers fired
+     */
+    size_t advance(Clock::time_point now);
+
+    /**
+     *  The time till the wheel next needs to be advanced. This may be
+     *  earlier than the deadline of the next timer since timers in the outer
+     *  levels of the wheel have to be moved to the inner levels.
+     *
+     *  @param now the current time
+     *
+     *  @return the timeout, or `nanoseconds::max()` if no timers are scheduled
+     */
+    std::chrono::nanoseconds timeout(Clock::time_point now) const;
+
+    size_t size() const {
+        return _count;
+    }
+
+  private:
+    static const size_t InnerSlotsBits = 8;
+    static const size_t InnerSlots = 1 << InnerSlotsBits;
+    static const size_t OuterSlotsBits = 6;
+    static const size_t OuterSlots = 1 << OuterSlotsBits;
+    static const size_t OuterLevels = 3;
+    static const size_t BitmapWords = InnerSlots / 64;
+
+    Clock::time_point _start;
+    std::chrono::nanoseconds _resolution;
+
+    uint64_t _currentTick;
+    size_t _count;
+
+    /*
+     *  Slots are sentinels of circular doubly linked lists of timers. The
+     *  occupancy of the inner slots is tracked so that empty ticks can be
+     *  skipped.
+     */
+    Link _inner[InnerSlots];
+    Link _outer[OuterLevels][OuterSlots];
+
+    uint64_t _innerOccupied[BitmapWords];
+    size_t _outerCount;
+
+    uint64_t ticksForDuration(std::chrono::nanoseconds duration) const;
+    uint64_t tickForTime(Clock::time_point time) const;
+
+    void link(Timer &timer);
+    void unlink(Timer &timer);
+    void cascade(size_t level);
+    void moveTo(uint64_t tick);
+    size_t fireCurrentTick();
+    uint64_t nextEventTick() const;
+
+    DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}
+
+#endif /* defined(__CORELIB__TIMERWHEEL__) */
@@ -56,6 +56,18 @@
 
 #endif
 
+#pragma mark - Instrumentation
+
+#if CL_ENABLE_INSTRUMENTATION
+
+#define CL_INSTRUMENT(statement) statement
+
+#else
+
+#define CL_INSTRUMENT(statement)
+
+#endif
+
 #pragma mark - Error Checking
 
 #define CL_CHECK_EXPECT(call, expected)                                        \
@@ -25,9 +25,16 @@
 #ifndef __CORELIB__WAITSET__
 #define __CORELIB__WAITSET__
 
-#include <set>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <stdint.h>
 
 #include "Base.h"
+#include "Config.h"
+#include "Histogram.h"
+
+#include <atomic>
 
 namespace cl {
 
@@ -38,22 +45,161 @@ class WaitSet {
   public:
     typedef int Handle;
 
-    WaitSet();
+    typedef enum {
+        Readable = 1 << 0,
+        Writable = 1 << 1,
+    } Event;
+
+    /*
+     *  Sources in a wait set are identified to the kernel by a token that
+     *  packs their slot index with the generation of that slot. The
+     *  generation is bumped each time the slot is vacated so that events
+     *  for removed sources can be told apart from events for whatever
+     *  source reuses the slot later.
+     */
+    typedef uint64_t Token;
+
+    static const Token InvalidToken = 0;
+
+    struct ReadySource {
+        Token token;
+        uint32_t events;
+    };
+
+    typedef std::vector<ReadySource> ReadySources;
+
+    static const size_t DefaultMaxReadySources;
+
+    /**
+     *  Create a wait set that reports at most `maxReadySources` signalled
+     *  sources per call to `wait`
+     *
+     *  @param maxReadySources the maximum number of sources per wakeup
+     *
+     *  @return the wait set
+     */
+    explicit WaitSet(size_t maxReadySources = DefaultMaxReadySources);
     ~WaitSet();
 
+    /**
+     *  Add a source to the wait set. A source may only be present in one
+     *  wait set at a time.
+     *
+     *  @param source the source to add
+     *
+     *  @return if the source was added. Fails if the source is already in
+     *          a wait set.
+     */
     bool addSource(std::shared_ptr<LooperSource> source);
     bool removeSource(std::shared_ptr<LooperSource> source);
 
-    LooperSource *wait();
+    /**
+     *  Update the registration of a source already in the wait set after its
+     *  registration flags have changed. This also re-arms one-shot sources.
+     *
+     *  @param source the source to update
+     *
+     *  @return if the source was present in the wait set
+     */
+    bool updateSource(std::shared_ptr<LooperSource> source);
+
+    /**
+     *  Block till at least one source is signalled or the timeout expires
+     *  and return the batch of sources that are ready. The batch is owned by
+     *  the wait set and remains valid till the next call to `wait`. Entries
+     *  must be resolved to sources using `source` right before dispatch
+     *  since earlier handlers in the same batch may have removed them.
+     *
+     *  @param timeout the maximum time to block for. The default blocks
+     *                 indefinitely.
+     *
+     *  @return the sources ready for dispatch. Empty if the wait timed out.
+     */
+    const ReadySources &
+    wait(std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+
+    /**
+     *  Resolve the token of a ready source
+     *
+     *  @param token the token reported by `wait`
+     *
+     *  @return the source or `nullptr` if it has since been removed
+     */
+    LooperSource *source(Token token) const;
+
+    /**
+     *  Mark the source of a ready token as waiting for dispatch. A looper
+     *  that defers dispatch to a later wakeup uses this to avoid queueing a
+     *  source twice when it is reported again in the meantime. The mark is
+     *  dropped when the source is removed.
+     *
+     *  @param token the token reported by `wait`
+     *
+     *  @return false if the source was already marked or has been removed
+     */
+    bool markPending(Token token);
+
+    /**
+     *  Clear the mark set by `markPending` once the source is dispatched or
+     *  dropped
+     *
+     *  @param token the token reported by `wait`
+     */
+    void clearPending(Token token);
+
+    /**
+     *  All sources currently in the wait set. Must only be called on the
+     *  thread waiting on the wait set.
+     *
+     *  @return the sources
+     */
+    std::vector<std::shared_ptr<LooperSource>> sources() const;
+
+    struct Stats {
+        uint64_t wakeups;
+        uint64_t events;
+        std::chrono::nanoseconds blockedTime;
+        Histogram::Snapshot eventsPerWakeup;
+
+        Stats() : wakeups(0), events(0), blockedTime(0) {
+        }
+    };
+
+    /**
+     *  A snapshot of the wakeups of this wait set. Empty unless the library
+     *  is built with instrumentation. May be called from any thread.
+     *
+     *  @return the snapshot
+     */
+    Stats stats() const;
 
   private:
     Handle _handle;
 
     static Handle platformHandleCreate();
-    static LooperSource *platformHandleWait(Handle handle);
+    static size_t platformHandleWait(Handle handle, ReadySource *sources,
+                                     size_t maxSources,
+                                     std::chrono::nanoseconds timeout);
     static void platformHandleDestory(Handle handle);
 
-    std::set<std::shared_ptr<LooperSource>> _sources;
+    struct Slot {
+        std::shared_ptr<LooperSource> source;
+        uint32_t generation;
+        bool pending;
+    };
+
+    std::vector<Slot> _slots;
+    std::vector<uint32_t> _freeSlots;
+
+    bool isRegistered(const LooperSource *source) const;
+
+    size_t _maxReadySources;
+    ReadySources _readySources;
+
+#if CL_ENABLE_INSTRUMENTATION
+    std::atomic<uint64_t> _blockedNanoseconds;
+    Histogram _eventsPerWakeup;
+#endif
 
     DISALLOW_COPY_AND_ASSIGN(WaitSet);
 };
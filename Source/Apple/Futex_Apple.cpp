@@ -0,0 +1,119 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Futex.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace cl;
+
+/*
+ *  There is no public futex here. Waiters park on a condition variable
+ *  picked by hashing the address of the word instead. Unrelated words may
+ *  share a bucket, so wakes are broadcast to all waiters in the bucket and
+ *  those not waiting on the word go back to sleep.
+ */
+struct Futex_Bucket {
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+static const size_t Futex_BucketCount = 64;
+
+static Futex_Bucket &Futex_BucketForWord(const std::atomic<uint32_t> &word) {
+    static Futex_Bucket buckets[Futex_BucketCount];
+
+    const uintptr_t address = reinterpret_cast<uintptr_t>(&word);
+
+    return buckets[(address >> 2) % Futex_BucketCount];
+}
+
+/*
+ *  Condition variables cannot be shared with other processes, and there is
+ *  no public way to wait on a shared address. Waiters on shared words poll
+ *  with a growing sleep instead, so a wake is only noticed on the next
+ *  poll.
+ */
+static bool Futex_PollShared(std::atomic<uint32_t> &word, uint32_t expected,
+                             std::chrono::nanoseconds timeout) {
+    const auto start = std::chrono::steady_clock::now();
+    std::chrono::microseconds sleep(1);
+
+    while (word.load(std::memory_order_acquire) == expected) {
+        if (timeout != std::chrono::nanoseconds::max() &&
+            std::chrono::steady_clock::now() - start >= timeout) {
+            return false;
+        }
+
+        std::this_thread::sleep_for(sleep);
+        sleep = std::min(sleep * 2, std::chrono::microseconds(1000));
+    }
+
+    return true;
+}
+
+bool Futex::Wait(std::atomic<uint32_t> &word, uint32_t expected,
+                 std::chrono::nanoseconds timeout, Scope scope) {
+    if (scope == ScopeShared) {
+        return Futex_PollShared(word, expected, timeout);
+    }
+
+    Futex_Bucket &bucket = Futex_BucketForWord(word);
+
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+
+    if (word.load(std::memory_order_acquire) != expected) {
+        return true;
+    }
+
+    if (timeout == std::chrono::nanoseconds::max()) {
+        bucket.condition.wait(lock);
+        return true;
+    }
+
+    return bucket.condition.wait_for(lock, timeout) ==
+           std::cv_status::no_timeout;
+}
+
+void Futex::Wake(std::atomic<uint32_t> &word, uint32_t count, Scope scope) {
+    if (scope == ScopeShared) {
+        return;
+    }
+
+    Futex_Bucket &bucket = Futex_BucketForWord(word);
+
+    /*
+     *  Acquiring the bucket lock orders the wake after any waiter that
+     *  checked the word before it changed
+     */
+    {
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+    }
+
+    bucket.condition.notify_all();
+}
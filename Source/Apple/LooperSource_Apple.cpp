@@ -27,6 +27,8 @@
 #include "Base.h"
 
 #include <sys/event.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace cl;
 
@@ -34,7 +36,8 @@ static inline void LooperSource_UpdateKeventSource(int queue, uintptr_t ident,
                                                    int16_t filter,
                                                    uint16_t flags,
                                                    uint32_t fflags,
-                                                   intptr_t data, void *udata) {
+                                                   intptr_t data,
+                                                   WaitSet::Token token) {
     struct kevent event = {0};
 
     EV_SET(&event,
@@ -43,28 +46,55 @@ static inline void LooperSource_UpdateKeventSource(int queue, uintptr_t ident,
            flags,
            fflags,
            data,
-           udata);
+           reinterpret_cast<void *>(token));
 
     CL_TEMP_FAILURE_RETRY(::kevent(queue, &event, 1, nullptr, 0, NULL));
 }
 
 void LooperSource::updateInWaitSetHandle(WaitSet::Handle waitsetHandle,
-                                         bool shouldAdd) {
+                                         WaitSetOperation operation) {
     if (_customWaitSetUpdateHandler) {
         _customWaitSetUpdateHandler(this,
                                     waitsetHandle,
                                     readHandle(),
-                                    shouldAdd);
+                                    operation);
         return;
     }
 
-    LooperSource_UpdateKeventSource(waitsetHandle,
-                                    readHandle(),
-                                    EVFILT_READ,
-                                    shouldAdd ? EV_ADD : EV_DELETE,
-                                    0,
-                                    0,
-                                    this);
+    uint16_t addFlags = EV_ADD | EV_ENABLE;
+
+    if (_registrationFlags & RegisterEdgeTriggered) {
+        addFlags |= EV_CLEAR;
+    }
+
+    if (_registrationFlags & RegisterOneShot) {
+        addFlags |= EV_DISPATCH;
+    }
+
+    const struct {
+        int16_t filter;
+        bool wanted;
+    } filters[] = {
+        {EVFILT_READ, (_registrationFlags & RegisterReadable) != 0},
+        {EVFILT_WRITE, (_registrationFlags & RegisterWritable) != 0},
+    };
+
+    for (const auto &filter : filters) {
+        /*
+         *  Filters that are not wanted are deleted on update in case they
+         *  were previously registered. Deleting an unregistered filter is
+         *  harmless.
+         */
+        if (filter.wanted && operation != WaitSetRemove) {
+            LooperSource_UpdateKeventSource(waitsetHandle, readHandle(),
+                                            filter.filter, addFlags, 0, 0,
+                                            _waitSetToken);
+        } else if (operation != WaitSetAdd) {
+            LooperSource_UpdateKeventSource(waitsetHandle, readHandle(),
+                                            filter.filter, EV_DELETE, 0, 0,
+                                            _waitSetToken);
+        }
+    }
 }
 
 std::shared_ptr<LooperSource>
@@ -72,15 +102,17 @@ LooperSource::AsTimer(std::chrono::nanoseconds repeatInterval) {
 
     WaitSetUpdateHandler updateHandler =
         [repeatInterval](LooperSource *source, WaitSet::Handle waitsetHandle,
-                         Handle readHandle, bool adding) {
+                         Handle readHandle, WaitSetOperation operation) {
 
             LooperSource_UpdateKeventSource(waitsetHandle,
                                             readHandle,
                                             EVFILT_TIMER,
-                                            adding ? EV_ADD : EV_DELETE,
+                                            operation == WaitSetRemove
+                                                ? EV_DELETE
+                                                : EV_ADD,
                                             NOTE_NSECONDS,
                                             repeatInterval.count(),
-                                            source);
+                                            source->waitSetToken());
 
         };
 
@@ -93,3 +125,49 @@ LooperSource::AsTimer(std::chrono::nanoseconds repeatInterval) {
 
     return timer;
 }
+
+std::shared_ptr<LooperSource> LooperSource::AsTrivial() {
+    /*
+     *  There is no eventfd here, so use a non-blocking pipe. Writes to a full
+     *  pipe are dropped since the source is already signalled, and the reader
+     *  drains everything written so far. This coalesces multiple writes into
+     *  a single wakeup.
+     */
+
+    IOHandlesAllocator allocator = [] {
+        int descriptors[2] = {0};
+
+        CL_CHECK(::pipe(descriptors));
+
+        CL_CHECK(::fcntl(descriptors[0], F_SETFL, O_NONBLOCK));
+        CL_CHECK(::fcntl(descriptors[1], F_SETFL, O_NONBLOCK));
+
+        return Handles(descriptors[0], descriptors[1]);
+    };
+
+    IOHandlesDeallocator deallocator = [](Handles h) {
+        CL_CHECK(::close(h.first));
+        CL_CHECK(::close(h.second));
+    };
+
+    IOHandler reader = [](Handle r) {
+        char buffer[64];
+
+        while (CL_TEMP_FAILURE_RETRY(::read(r, &buffer, sizeof(buffer))) > 0) {
+        }
+    };
+
+    IOHandler writer = [](Handle w) {
+        static const char LooperWakeMessage = 'w';
+
+        ssize_t size = CL_TEMP_FAILURE_RETRY(
+            ::write(w, &LooperWakeMessage, sizeof(LooperWakeMessage)));
+
+        CL_ASSERT(size == sizeof(LooperWakeMessage) || errno == EAGAIN);
+    };
+
+    return std::make_shared<LooperSource>(allocator,
+                                          deallocator,
+                                          reader,
+                                          writer);
+}
@@ -0,0 +1,140 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "SharedMemory.h"
+#include "Utilities.h"
+
+#include <atomic>
+#include <fcntl.h>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cl;
+
+static const int SharedMemoryTempHandleMaxRetries = 25;
+
+/*
+ *  There are no anonymous shared memory files here. Names only need to be
+ *  unique for the moment between creating and unlinking them, so they are
+ *  made of the process identifier, a counter and a random component.
+ */
+static std::string SharedMemory_UniqueFileName() {
+    static std::atomic<uint32_t> counter(0);
+
+    std::stringstream stream;
+
+    stream << "/CoreLib_SharedMemory_" << getpid() << "_" << counter++ << "_"
+           << arc4random();
+
+    return stream.str();
+}
+
+static Handle SharedMemory_CreateHandle() {
+    Handle newHandle = -1;
+
+    int tries = 0;
+
+    while (tries++ < SharedMemoryTempHandleMaxRetries) {
+        auto tempFile = SharedMemory_UniqueFileName();
+
+        newHandle = ::shm_open(tempFile.c_str(),
+                               O_RDWR  | O_CREAT | O_EXCL,
+                               S_IRUSR | S_IWUSR);
+
+        if (newHandle == -1 && errno == EEXIST) {
+            /*
+             *  The current handle already exists (the O_CREAT | O_EXCL
+             *  check is atomic). Try a new file name.
+             */
+            continue;
+        }
+
+        /*
+         *  We already have a file reference, unlink the reference by name.
+         */
+        if (newHandle != -1) {
+            CL_CHECK(::shm_unlink(tempFile.c_str()));
+        }
+
+        break;
+    }
+
+    return newHandle;
+}
+
+bool SharedMemory::SupportsSealing() {
+    return false;
+}
+
+bool SharedMemory::platformCreate(size_t size, Options options) {
+    _handle = SharedMemory_CreateHandle();
+
+    if (_handle == -1) {
+        return false;
+    }
+
+    if (CL_TEMP_FAILURE_RETRY(::ftruncate(_handle, size)) == -1) {
+        return false;
+    }
+
+    _size = size;
+
+    return platformMap(true, options);
+}
+
+bool SharedMemory::platformMap(bool writable, Options options) {
+    const int protection = PROT_READ | (writable ? PROT_WRITE : 0);
+
+    void *address = ::mmap(nullptr, _size, protection, MAP_SHARED, _handle, 0);
+
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    /*
+     *  There is no way to populate a mapping up front. Ask for the pages to
+     *  be read ahead instead. Huge pages are not available for shared
+     *  mappings.
+     */
+    if (options & OptionPrefault) {
+        ::madvise(address, _size, MADV_WILLNEED);
+    }
+
+    _address = address;
+    _writable = writable;
+
+    return true;
+}
+
+bool SharedMemory::platformAddSeals(Seals seals) {
+    return false;
+}
+
+SharedMemory::Seals SharedMemory::platformSeals() const {
+    return 0;
+}
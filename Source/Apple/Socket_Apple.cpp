@@ -0,0 +1,79 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Socket.h"
+#include "Utilities.h"
+
+#include <sys/socket.h>
+
+#include <errno.h>
+
+using namespace cl;
+
+/*
+ *  Darwin has no batched variants of sendmsg and recvmsg. The records are
+ *  transferred one at a time, but callers still only take their locks and
+ *  prepare their buffers once per batch.
+ */
+
+int Socket::platformSendRecords(Handle handle, struct msghdr *headers,
+                                size_t count) {
+    size_t sent = 0;
+
+    for (; sent < count; sent++) {
+        if (CL_TEMP_FAILURE_RETRY(::sendmsg(handle, &headers[sent], 0)) ==
+            -1) {
+            break;
+        }
+    }
+
+    return sent == 0 ? -1 : static_cast<int>(sent);
+}
+
+int Socket::platformReceiveRecords(Handle handle, struct msghdr *headers,
+                                   size_t *lengths, size_t count) {
+    size_t received = 0;
+
+    for (; received < count; received++) {
+        ssize_t length =
+            CL_TEMP_FAILURE_RETRY(::recvmsg(handle, &headers[received], 0));
+
+        if (length == -1) {
+            break;
+        }
+
+        lengths[received] = length;
+
+        /*
+         *  Orderly shutdown. There is nothing after it to read.
+         */
+        if (length == 0 && headers[received].msg_controllen == 0) {
+            received++;
+            break;
+        }
+    }
+
+    return received == 0 ? -1 : static_cast<int>(received);
+}
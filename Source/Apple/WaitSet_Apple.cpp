@@ -29,6 +29,8 @@
 #include <sys/event.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 using namespace cl;
 
 WaitSet::Handle WaitSet::platformHandleCreate() {
@@ -40,15 +42,43 @@ WaitSet::Handle WaitSet::platformHandleCreate() {
     return handle;
 }
 
-LooperSource *WaitSet::platformHandleWait(WaitSet::Handle handle) {
-    struct kevent event = {0};
+size_t WaitSet::platformHandleWait(WaitSet::Handle handle,
+                                  ReadySource *sources, size_t maxSources,
+                                  std::chrono::nanoseconds timeout) {
+    struct kevent events[maxSources];
+
+    struct timespec timeoutSpec = {0};
+    struct timespec *timeoutSpecPtr = nullptr; /* infinite timeout */
+
+    if (timeout != std::chrono::nanoseconds::max()) {
+        auto nanos = std::max<int64_t>(timeout.count(), 0);
+
+        timeoutSpec.tv_sec = (time_t)(nanos / 1000000000);
+        timeoutSpec.tv_nsec = (long)(nanos % 1000000000);
+
+        timeoutSpecPtr = &timeoutSpec;
+    }
+
+    int val = CL_TEMP_FAILURE_RETRY(::kevent(
+        handle, nullptr, 0, events, (int)maxSources, timeoutSpecPtr));
+
+    CL_ASSERT(val >= 0);
 
-    int val = CL_TEMP_FAILURE_RETRY(
-        ::kevent(handle, nullptr, 0, &event, 1, nullptr));
+    if (val <= 0) {
+        return 0;
+    }
 
-    CL_ASSERT(val == 1);
+    for (int i = 0; i < val; i++) {
+        /*
+         *  Readiness for reading and writing is reported as separate events
+         *  for the same source. Timers and other filters count as reads.
+         */
+        sources[i].token = reinterpret_cast<Token>(events[i].udata);
+        sources[i].events =
+            events[i].filter == EVFILT_WRITE ? Writable : Readable;
+    }
 
-    return static_cast<LooperSource *>(event.udata);
+    return val;
 }
 
 void WaitSet::platformHandleDestory(WaitSet::Handle handle) {
@@ -25,21 +25,106 @@
 
 #include "Channel.h"
 #include "Message.h"
+#include "SharedMemory.h"
 #include "Utilities.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
 using namespace cl;
 
-Channel::Channel(std::string name) : _name(name), _connected(false) {
+/*
+ *  Each record on the socket is prefixed with the kind of frame it carries
+ */
+enum {
+    ChannelFrameMessage = 0,
+    ChannelFrameTransportSetup,
+    ChannelFrameTransportAttachments,
+    ChannelFrameTransportDoorbell,
+    ChannelFrameFragmentStart,
+    ChannelFrameFragment,
+    ChannelFrameSpill,
+    ChannelFrameTransportFull,
+    ChannelFrameTransportSpace,
+};
+
+/*
+ *  The first fragment and spills are prefixed with the frame kind and the
+ *  length of the entire message
+ */
+static const size_t Channel_LengthPrefixSize = sizeof(uint8_t) +
+                                               sizeof(uint64_t);
+
+static const SharedMemory::Seals Channel_SpillSeals =
+    SharedMemory::SealShrink | SharedMemory::SealGrow |
+    SharedMemory::SealWrite;
+
+/*
+ *  Set in the attachment count of a transport record whose message was
+ *  spilled into the region that is its first attachment
+ */
+static const uint32_t Channel_TransportSpillFlag = 1u << 31;
+
+const size_t Channel::DefaultSpillThreshold = 64 << 10;
+const size_t Channel::DefaultSendQueueLowWatermark = 256 << 10;
+const size_t Channel::DefaultSendQueueHighWatermark = 1 << 20;
+const size_t Channel::DefaultReadBudget = 64;
+const size_t Channel::DefaultMaxFragmentedMessageSize = 64 << 20;
+
+Channel::Channel(std::string name)
+    : _name(name), _connected(false), _spillThreshold(DefaultSpillThreshold),
+      _maxFragmentedMessageSize(DefaultMaxFragmentedMessageSize),
+      _reassemblyLength(0), _nonBlockingSends(false), _sendQueueBytes(0),
+      _sendQueueLowWatermark(DefaultSendQueueLowWatermark),
+      _sendQueueHighWatermark(DefaultSendQueueHighWatermark),
+      _backpressure(false), _transportSpaceWanted(false),
+      _readBudget(DefaultReadBudget),
+      _priority(LooperSource::PriorityData), _sendLock("Channel.send"),
+      _sendQueueLock("Channel.sendQueue"), _threadAffinity(false),
+      _boundLooper(std::make_shared<std::atomic<Looper *>>(nullptr)),
+      _activeSenders(0) {
+    CL_INSTRUMENT(_messagesSent = _bytesSent = 0);
+    CL_INSTRUMENT(_messagesReceived = _bytesReceived = 0);
     _socket = Socket::Create();
     _ready = true;
 }
 
-Channel::Channel(Handle handle) : _ready(true), _connected(true) {
+Channel::Channel(Handle handle)
+    : _ready(true), _connected(true), _spillThreshold(DefaultSpillThreshold),
+      _maxFragmentedMessageSize(DefaultMaxFragmentedMessageSize),
+      _reassemblyLength(0), _nonBlockingSends(false), _sendQueueBytes(0),
+      _sendQueueLowWatermark(DefaultSendQueueLowWatermark),
+      _sendQueueHighWatermark(DefaultSendQueueHighWatermark),
+      _backpressure(false), _transportSpaceWanted(false),
+      _readBudget(DefaultReadBudget),
+      _priority(LooperSource::PriorityData), _sendLock("Channel.send"),
+      _sendQueueLock("Channel.sendQueue"), _threadAffinity(false),
+      _boundLooper(std::make_shared<std::atomic<Looper *>>(nullptr)),
+      _activeSenders(0) {
+    CL_INSTRUMENT(_messagesSent = _bytesSent = 0);
+    CL_INSTRUMENT(_messagesReceived = _bytesReceived = 0);
     _socket = Socket::Create(handle);
 }
 
 Channel::Channel(std::unique_ptr<Socket> socket)
-    : _ready(true), _connected(true), _socket(std::move(socket)) {
+    : _ready(true), _connected(true), _socket(std::move(socket)),
+      _spillThreshold(DefaultSpillThreshold),
+      _maxFragmentedMessageSize(DefaultMaxFragmentedMessageSize),
+      _reassemblyLength(0), _nonBlockingSends(false), _sendQueueBytes(0),
+      _sendQueueLowWatermark(DefaultSendQueueLowWatermark),
+      _sendQueueHighWatermark(DefaultSendQueueHighWatermark),
+      _backpressure(false), _transportSpaceWanted(false),
+      _readBudget(DefaultReadBudget),
+      _priority(LooperSource::PriorityData), _sendLock("Channel.send"),
+      _sendQueueLock("Channel.sendQueue"), _threadAffinity(false),
+      _boundLooper(std::make_shared<std::atomic<Looper *>>(nullptr)),
+      _activeSenders(0) {
+    CL_INSTRUMENT(_messagesSent = _bytesSent = 0);
+    CL_INSTRUMENT(_messagesReceived = _bytesReceived = 0);
 }
 
 Channel::ConnectedChannels Channel::CreateConnectedChannels() {
@@ -54,6 +139,19 @@ void Channel::terminate() {
 
     bool closed = _socket->close();
 
+    /*
+     *  Attachments for messages on the transport that will never be read
+     */
+    for (const auto &attachment : _inboundAttachments) {
+        CL_CHECK(::close(attachment.handle()));
+    }
+
+    _inboundAttachments.clear();
+
+    dropReassembly();
+
+    clearSendQueue();
+
     _connected = false;
     _ready = false;
 
@@ -105,13 +203,327 @@ std::shared_ptr<LooperSource> Channel::source() {
      */
     _source = std::make_shared<LS>(allocator, nullptr, readHandler, nullptr);
 
+    /*
+     *  Reading messages drains the socket till it would block, so there is
+     *  no need to be woken again till new messages arrive. Likewise, the
+     *  send queue is only ever waiting on the socket after a write would
+     *  have blocked.
+     */
+    LS::RegistrationFlags flags =
+        LS::RegisterReadable | LS::RegisterEdgeTriggered;
+
+    if (_nonBlockingSends) {
+        flags |= LS::RegisterWritable;
+        _source->setWritableHandler(
+            [this](LS::Handle) { this->drainSendQueue(); });
+    }
+
+    _source->setRegistrationFlags(flags);
+    _source->setPriority(_priority);
+
     return _source;
 }
 
+Socket::Status Channel::writeFrame(uint8_t frame, Message &message) {
+    return _socket->WriteMessage(message, &frame, sizeof(frame));
+}
+
+Socket::Status Channel::writeRecord(Message &record, const uint8_t *prefix,
+                                    size_t prefixLength) {
+    if (!_nonBlockingSends) {
+        return _socket->WriteMessage(record, prefix, prefixLength);
+    }
+
+    Message *records[1] = {&record};
+    return writeOrQueueRecords(records, 1, prefix, prefixLength);
+}
+
+static void Channel_CloseAttachments(Message &message) {
+    auto range = message.attachmentRange();
+
+    for (auto i = range.first; i != range.second; i++) {
+        CL_CHECK(::close(i->handle()));
+    }
+}
+
+/*
+ *  Copy a record that could not be written into one that owns its prefix,
+ *  payload and attachments. The caller is free to close its attachments
+ *  once the send returns.
+ */
+static std::unique_ptr<Message> Channel_QueuedRecord(Message &record,
+                                                     const uint8_t *prefix,
+                                                     size_t prefixLength) {
+    auto queued =
+        cl::Utils::make_unique<Message>(prefixLength + record.size());
+
+    if (!queued->encodeBytes(prefix, prefixLength) ||
+        !queued->encodeBytes(record.data(), record.size())) {
+        return nullptr;
+    }
+
+    auto range = record.attachmentRange();
+
+    for (auto i = range.first; i != range.second; i++) {
+        int handle = ::fcntl(i->handle(), F_DUPFD_CLOEXEC, 0);
+
+        if (handle == -1) {
+            CL_LOG_ERRNO();
+            Channel_CloseAttachments(*queued);
+            return nullptr;
+        }
+
+        queued->addAttachment(Attachment(handle));
+    }
+
+    return queued;
+}
+
+Socket::Status Channel::writeOrQueueRecords(Message *const *records,
+                                            size_t count,
+                                            const uint8_t *prefix,
+                                            size_t prefixLength) {
+    Socket::Status status = Socket::Status::Success;
+    bool backpressure = false;
+
+    {
+        OptionalAutoLock lock(lockUnlessBound(_sendQueueLock));
+
+        size_t written = 0;
+
+        /*
+         *  Records may only bypass the queue if there is nothing in it
+         */
+        if (_sendQueue.empty()) {
+            status = _socket->TryWriteMessages(records, count, written, prefix,
+                                               prefixLength);
+        }
+
+        if (status == Socket::Status::Success ||
+            status == Socket::Status::WouldBlock) {
+            status = Socket::Status::Success;
+
+            for (size_t i = written; i < count; i++) {
+                auto queued =
+                    Channel_QueuedRecord(*records[i], prefix, prefixLength);
+
+                if (!queued) {
+                    status = Socket::Status::TemporaryFailure;
+                    break;
+                }
+
+                _sendQueueBytes += queued->size();
+                _sendQueue.push_back(std::move(queued));
+            }
+
+            if (!_backpressure &&
+                _sendQueueBytes >= _sendQueueHighWatermark) {
+                _backpressure = backpressure = true;
+            }
+        }
+    }
+
+    if (backpressure && _backpressureCallback) {
+        _backpressureCallback(true);
+    }
+
+    return status;
+}
+
+void Channel::drainSendQueue() {
+    Socket::Status status = Socket::Status::Success;
+    bool relieved = false;
+
+    {
+        OptionalAutoLock lock(lockUnlessBound(_sendQueueLock));
+
+        while (!_sendQueue.empty()) {
+            Message *records[Socket::MaxBatchCount];
+
+            const size_t count =
+                std::min(_sendQueue.size(), Socket::MaxBatchCount);
+
+            for (size_t i = 0; i < count; i++) {
+                records[i] = _sendQueue[i].get();
+            }
+
+            size_t written = 0;
+            status = _socket->TryWriteMessages(records, count, written);
+
+            for (size_t i = 0; i < written; i++) {
+                Message &record = *_sendQueue.front();
+
+                _sendQueueBytes -= record.size();
+                Channel_CloseAttachments(record);
+
+                _sendQueue.pop_front();
+            }
+
+            if (status != Socket::Status::Success) {
+                break;
+            }
+        }
+
+        if (_backpressure && _sendQueueBytes <= _sendQueueLowWatermark) {
+            _backpressure = false;
+            relieved = true;
+        }
+    }
+
+    if (status == Socket::Status::PermanentFailure) {
+        terminate();
+        return;
+    }
+
+    if (relieved && _backpressureCallback) {
+        _backpressureCallback(false);
+    }
+}
+
+void Channel::clearSendQueue() {
+    OptionalAutoLock lock(lockUnlessBound(_sendQueueLock));
+
+    for (const auto &record : _sendQueue) {
+        Channel_CloseAttachments(*record);
+    }
+
+    _sendQueue.clear();
+    _transportQueue.clear();
+    _sendQueueBytes = 0;
+    _backpressure = false;
+}
+
+void Channel::sendQueueWatermarks(size_t low, size_t high) {
+    CL_ASSERT(low <= high);
+
+    OptionalAutoLock lock(lockUnlessBound(_sendQueueLock));
+
+    _sendQueueLowWatermark = low;
+    _sendQueueHighWatermark = high;
+}
+
+size_t Channel::sendQueueSize() const {
+    OptionalAutoLock lock(lockUnlessBound(_sendQueueLock));
+    return _sendQueueBytes;
+}
+
+/*
+ *  Counts a sender in from before it looks for the bound looper until it is
+ *  done with the socket
+ */
+class Channel_SenderScope {
+public:
+    explicit Channel_SenderScope(std::atomic<size_t> &senders)
+        : _senders(senders) {
+        _senders.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    ~Channel_SenderScope() {
+        _senders.fetch_sub(1, std::memory_order_release);
+    }
+
+private:
+    std::atomic<size_t> &_senders;
+
+    DISALLOW_COPY_AND_ASSIGN(Channel_SenderScope);
+};
+
+Looper *Channel::handOffLooper() const {
+    Looper *looper = _boundLooper->load(std::memory_order_seq_cst);
+
+    if (looper == nullptr || _socket->isBoundToCurrentThread()) {
+        return nullptr;
+    }
+
+    return looper;
+}
+
+const Lock *Channel::lockUnlessBound(const Lock &lock) const {
+    return _socket->isBoundToCurrentThread() ? nullptr : &lock;
+}
+
+bool Channel::handOffMessages(Looper *looper, Message *const *messages,
+                              size_t count) {
+    /*
+     *  Tasks must be copyable
+     */
+    std::vector<std::shared_ptr<Message>> copies;
+    copies.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        std::shared_ptr<Message> copy =
+            Channel_QueuedRecord(*messages[i], nullptr, 0);
+
+        if (!copy) {
+            for (auto &previous : copies) {
+                Channel_CloseAttachments(*previous);
+            }
+
+            return false;
+        }
+
+        copies.push_back(std::move(copy));
+    }
+
+    auto boundLooper = _boundLooper;
+
+    looper->post([this, boundLooper, looper, copies]() {
+        /*
+         *  The channel may be gone if it was unbound
+         */
+        bool sending = boundLooper->load(std::memory_order_acquire) == looper;
+
+        for (const auto &copy : copies) {
+            /*
+             *  The senders were told the messages went out. Since they can
+             *  no longer be told otherwise, a failure terminates the channel
+             *  and the termination callback reports it. The messages after
+             *  it are dropped so the peer never sees a gap in the order.
+             */
+            if (sending && !sendMessage(*copy)) {
+                CL_LOG("Could not send a message handed to the looper");
+                terminate();
+                sending = false;
+            }
+
+            Channel_CloseAttachments(*copy);
+        }
+    });
+
+    return true;
+}
+
 bool Channel::sendMessage(Message &message) {
-    CL_ASSERT(message.size() <= 1024);
+    Channel_SenderScope sender(_activeSenders);
+
+    if (Looper *looper = handOffLooper()) {
+        Message *messages[1] = {&message};
+        return handOffMessages(looper, messages, 1);
+    }
 
-    Socket::Status writeStatus = _socket->WriteMessage(message);
+    bool sent = writeMessage(message);
+
+    CL_INSTRUMENT(if (sent) { countSent(message.size()); });
+
+    return sent;
+}
+
+bool Channel::writeMessage(Message &message) {
+    if (_outboundTransport) {
+        return sendMessageOnTransport(message);
+    }
+
+    if (message.size() > _spillThreshold) {
+        return sendSpilledMessage(message);
+    }
+
+    if (message.size() + sizeof(uint8_t) > Socket::MaxBufferSize) {
+        return sendFragmentedMessage(message);
+    }
+
+    const uint8_t frame = ChannelFrameMessage;
+
+    Socket::Status writeStatus = writeRecord(message, &frame, sizeof(frame));
 
     if (writeStatus == Socket::Status::PermanentFailure) {
         /*
@@ -125,18 +537,700 @@ bool Channel::sendMessage(Message &message) {
     return writeStatus == Socket::Status::Success;
 }
 
-void Channel::readMessageOnHandle(Handle handle) {
-    Socket::Status status;
-    std::vector<std::unique_ptr<Message>> messages;
+bool Channel::sendMessages(const std::vector<Message *> &messages) {
+    Channel_SenderScope sender(_activeSenders);
+
+    if (Looper *looper = handOffLooper()) {
+        return handOffMessages(looper, messages.data(), messages.size());
+    }
+
+    if (_outboundTransport) {
+        for (Message *message : messages) {
+            if (!sendMessage(*message)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const uint8_t frame = ChannelFrameMessage;
+
+    std::vector<Message *> batch;
+    batch.reserve(messages.size());
+
+    auto flush = [&]() {
+        if (batch.size() == 0) {
+            return true;
+        }
+
+        Socket::Status writeStatus =
+            _nonBlockingSends
+                ? writeOrQueueRecords(batch.data(), batch.size(), &frame,
+                                      sizeof(frame))
+                : _socket->WriteMessages(batch, &frame, sizeof(frame));
+
+#if CL_ENABLE_INSTRUMENTATION
+        if (writeStatus == Socket::Status::Success) {
+            for (Message *message : batch) {
+                countSent(message->size());
+            }
+        }
+#endif
+
+        batch.clear();
+
+        if (writeStatus == Socket::Status::PermanentFailure) {
+            terminate();
+            return false;
+        }
+
+        return writeStatus == Socket::Status::Success;
+    };
+
+    for (Message *message : messages) {
+        if (message->size() + sizeof(frame) <= Socket::MaxBufferSize) {
+            batch.push_back(message);
+            continue;
+        }
+
+        /*
+         *  Messages that need more than one record must not overtake the
+         *  ones before them
+         */
+        if (!flush() || !sendMessage(*message)) {
+            return false;
+        }
+    }
+
+    return flush();
+}
+
+static inline void Channel_EncodeLengthPrefix(uint8_t *prefix, uint8_t frame,
+                                              uint64_t length) {
+    prefix[0] = frame;
+    memcpy(prefix + sizeof(uint8_t), &length, sizeof(length));
+}
+
+bool Channel::sendFragmentedMessage(Message &message) {
+    OptionalAutoLock lock(lockUnlessBound(_sendLock));
+
+    const uint8_t *data = message.data();
+    const size_t size = message.size();
+
+    size_t offset = 0;
+
+    while (offset < size) {
+        const bool first = offset == 0;
+
+        uint8_t prefix[Channel_LengthPrefixSize];
+        size_t prefixLength = sizeof(uint8_t);
+
+        if (first) {
+            Channel_EncodeLengthPrefix(prefix, ChannelFrameFragmentStart, size);
+            prefixLength = Channel_LengthPrefixSize;
+        } else {
+            prefix[0] = ChannelFrameFragment;
+        }
+
+        const size_t length =
+            std::min(size - offset, Socket::MaxBufferSize - prefixLength);
+
+        /*
+         *  Fragments reference the payload of the message instead of copying
+         *  it. Attachments are sent with the first fragment.
+         */
+        Message fragment(data + offset, length, false /* copy */);
+
+        if (first) {
+            auto range = message.attachmentRange();
 
-    std::tie(status, messages) = _socket->ReadMessages();
+            for (auto i = range.first; i != range.second; i++) {
+                fragment.addAttachment(*i);
+            }
+        }
+
+        Socket::Status status = writeRecord(fragment, prefix, prefixLength);
+
+        if (status == Socket::Status::PermanentFailure) {
+            terminate();
+            return false;
+        }
+
+        /*
+         *  The peer drops the partially reassembled message when the next
+         *  one starts
+         */
+        if (status != Socket::Status::Success) {
+            return false;
+        }
 
+        offset += length;
+    }
+
+    return true;
+}
+
+/*
+ *  Copy a message into a region of its own. The receiver maps the region and
+ *  reads the message straight out of it.
+ */
+static std::unique_ptr<SharedMemory> Channel_SpillRegion(Message &message) {
     /*
-     *  Dispatch all successfully read messages
+     *  The pages are all written right away, so fault them in up front
      */
+    auto memory = Utils::make_unique<SharedMemory>(
+        message.size(), SharedMemory::OptionPrefault);
+
+    if (!memory->isReady()) {
+        return nullptr;
+    }
+
+    memcpy(memory->address(), message.data(), message.size());
+
+    /*
+     *  Sealed so that the receiver can rely on the message neither changing
+     *  nor being truncated under it while it is read
+     */
+    if (!memory->seal(Channel_SpillSeals)) {
+        return nullptr;
+    }
+
+    return memory;
+}
+
+bool Channel::sendSpilledMessage(Message &message) {
+    const auto range = message.attachmentRange();
+
+    if (static_cast<size_t>(range.second - range.first) + 1 >
+        Socket::MaxControlBufferItemCount) {
+        return false;
+    }
+
+    auto memory = Channel_SpillRegion(message);
+
+    if (!memory) {
+        return false;
+    }
+
+    Message spill;
+    spill.addAttachment(Attachment(memory->handle()));
+
+    for (auto i = range.first; i != range.second; i++) {
+        spill.addAttachment(*i);
+    }
+
+    uint8_t prefix[Channel_LengthPrefixSize];
+    Channel_EncodeLengthPrefix(prefix, ChannelFrameSpill, message.size());
+
+    Socket::Status status = writeRecord(spill, prefix, sizeof(prefix));
+
+    if (status == Socket::Status::PermanentFailure) {
+        terminate();
+        return false;
+    }
+
+    return status == Socket::Status::Success;
+}
+
+bool Channel::enableSharedMemoryTransport(size_t capacity) {
+    if (!_connected || _outboundTransport) {
+        return false;
+    }
+
+    /*
+     *  Messages on the transport must not overtake ones still queued for
+     *  the socket
+     */
+    if (sendQueueSize() != 0) {
+        return false;
+    }
+
+    auto transport = SharedMemoryTransport::Create(capacity);
+
+    if (!transport) {
+        return false;
+    }
+
+    Message setup;
+    setup.addAttachment(Attachment(transport->handle()));
+
+    if (writeFrame(ChannelFrameTransportSetup, setup) !=
+        Socket::Status::Success) {
+        return false;
+    }
+
+    _outboundTransport = std::move(transport);
+
+    return true;
+}
+
+bool Channel::sendMessageOnTransport(Message &message) {
+    OptionalAutoLock lock(lockUnlessBound(_sendLock));
+
+    const auto range = message.attachmentRange();
+    uint32_t attachmentCount =
+        static_cast<uint32_t>(range.second - range.first);
+
+    const uint8_t *payload = message.data();
+    size_t length = message.size();
+
+    /*
+     *  Messages larger than the ring are spilled into a region of their own.
+     *  The region is handed over ahead of the other attachments and the
+     *  record only carries the length, so the message keeps its place among
+     *  the ones before and after it.
+     */
+    std::unique_ptr<SharedMemory> spill;
+    uint64_t spillLength = message.size();
+
+    if (length > _outboundTransport->maxRecordLength()) {
+        if (attachmentCount + 1 > Socket::MaxControlBufferItemCount) {
+            return false;
+        }
+
+        spill = Channel_SpillRegion(message);
+
+        if (!spill) {
+            return false;
+        }
+
+        payload = reinterpret_cast<const uint8_t *>(&spillLength);
+        length = sizeof(spillLength);
+        attachmentCount++;
+    }
+
+    /*
+     *  Descriptors cannot be placed in shared memory. They are sent on the
+     *  socket ahead of the record that refers to them.
+     */
+    if (attachmentCount > 0) {
+        Message attachments;
+
+        if (spill) {
+            attachments.addAttachment(Attachment(spill->handle()));
+        }
+
+        for (auto i = range.first; i != range.second; i++) {
+            attachments.addAttachment(*i);
+        }
+
+        if (writeFrame(ChannelFrameTransportAttachments, attachments) !=
+            Socket::Status::Success) {
+            terminate();
+            return false;
+        }
+    }
+
+    if (spill) {
+        attachmentCount |= Channel_TransportSpillFlag;
+    }
+
+    Socket::Status status = Socket::Status::WouldBlock;
+    bool requestSpace = false;
+    bool backpressure = false;
+
+    {
+        OptionalAutoLock queueLock(lockUnlessBound(_sendQueueLock));
+
+        /*
+         *  Records may only bypass the queue if there is nothing in it
+         */
+        if (_transportQueue.empty()) {
+            status = writeTransportRecord(payload, length, attachmentCount);
+            requestSpace = status == Socket::Status::WouldBlock;
+        }
+
+        if (status == Socket::Status::WouldBlock) {
+            auto queued = Utils::make_unique<Message>(length);
+
+            if (queued->encodeBytes(payload, length)) {
+                status = Socket::Status::Success;
+
+                _sendQueueBytes += length;
+                _transportQueue.push_back(
+                    TransportRecord{std::move(queued), attachmentCount});
+
+                if (!_backpressure &&
+                    _sendQueueBytes >= _sendQueueHighWatermark) {
+                    _backpressure = backpressure = true;
+                }
+            } else {
+                status = Socket::Status::TemporaryFailure;
+            }
+        }
+    }
+
+    /*
+     *  The peer says when it has read from the transport after being asked
+     *  to, which is when the queue is drained
+     */
+    if (status == Socket::Status::Success && requestSpace) {
+        Message full;
+
+        if (writeFrame(ChannelFrameTransportFull, full) !=
+            Socket::Status::Success) {
+            status = Socket::Status::PermanentFailure;
+        }
+    }
+
+    if (status == Socket::Status::PermanentFailure) {
+        terminate();
+        return false;
+    }
+
+    if (backpressure && _backpressureCallback) {
+        _backpressureCallback(true);
+    }
+
+    return status == Socket::Status::Success;
+}
+
+Socket::Status Channel::writeTransportRecord(const uint8_t *payload,
+                                             size_t length, uint32_t tag) {
+    bool notify = false;
+
+    auto status = _outboundTransport->write(payload, length, tag, notify);
+
+    if (notify) {
+        Message doorbell;
+
+        if (writeFrame(ChannelFrameTransportDoorbell, doorbell) ==
+            Socket::Status::PermanentFailure) {
+            return Socket::Status::PermanentFailure;
+        }
+    }
+
+    switch (status) {
+        case SharedMemoryTransport::Success:
+            return Socket::Status::Success;
+        case SharedMemoryTransport::InsufficientSpace:
+            return Socket::Status::WouldBlock;
+        default:
+            return Socket::Status::TemporaryFailure;
+    }
+}
+
+void Channel::drainTransportQueue() {
+    OptionalAutoLock lock(lockUnlessBound(_sendLock));
+
+    Socket::Status status = Socket::Status::Success;
+    bool relieved = false;
+
+    {
+        OptionalAutoLock queueLock(lockUnlessBound(_sendQueueLock));
+
+        while (!_transportQueue.empty()) {
+            const TransportRecord &record = _transportQueue.front();
+            const size_t length = record.payload->size();
+
+            status = writeTransportRecord(record.payload->data(), length,
+                                          record.tag);
+
+            if (status != Socket::Status::Success) {
+                break;
+            }
+
+            _sendQueueBytes -= length;
+            _transportQueue.pop_front();
+        }
+
+        if (_backpressure && _sendQueueBytes <= _sendQueueLowWatermark) {
+            _backpressure = false;
+            relieved = true;
+        }
+    }
+
+    /*
+     *  Still no room for the rest. Ask again.
+     */
+    if (status == Socket::Status::WouldBlock) {
+        Message full;
+        status = writeFrame(ChannelFrameTransportFull, full);
+    }
+
+    if (status == Socket::Status::PermanentFailure) {
+        terminate();
+        return;
+    }
+
+    if (relieved && _backpressureCallback) {
+        _backpressureCallback(false);
+    }
+}
+
+void Channel::setupInboundTransport(Message &message) {
+    auto range = message.attachmentRange();
+
+    if (range.second - range.first != 1) {
+        return;
+    }
+
+    /*
+     *  Records already in a previous transport were sent before this one was
+     *  setup
+     */
+    if (_inboundTransport) {
+        bool drained = false;
+        readMessagesOnTransport(std::numeric_limits<size_t>::max(), drained);
+    }
+
+    _inboundTransport = SharedMemoryTransport::Open(range.first->handle());
+
+    if (!_inboundTransport) {
+        CL_LOG("Peer provided an invalid shared memory transport");
+        terminate();
+    }
+}
+
+size_t Channel::readMessagesOnTransport(size_t budget, bool &drained) {
+    size_t readCount = 0;
+    drained = true;
+
+    bool valid = _inboundTransport->read([&](const uint8_t *payload,
+                                             size_t length,
+                                             uint32_t tag) {
+        /*
+         *  Leave the record in the ring for the next wakeup
+         */
+        if (readCount == budget) {
+            drained = false;
+            return false;
+        }
+
+        const bool spilled = (tag & Channel_TransportSpillFlag) != 0;
+        const uint32_t attachmentCount = tag & ~Channel_TransportSpillFlag;
+
+        /*
+         *  The attachments are sent ahead of the record but may still be in
+         *  flight on the socket. Stop here till they arrive.
+         */
+        if (_inboundAttachments.size() < attachmentCount) {
+            drained = false;
+            return false;
+        }
+
+        Message message(payload, length, false /* copy */);
+
+        for (uint32_t i = 0; i < attachmentCount; i++) {
+            message.addAttachment(_inboundAttachments.front());
+            _inboundAttachments.pop_front();
+        }
+
+        if (spilled) {
+            readSpilledMessage(message);
+        } else {
+            deliverMessage(message);
+        }
+
+        readCount++;
+
+        return true;
+    });
+
+    if (!valid) {
+        CL_LOG("Peer corrupted the shared memory transport");
+        terminate();
+    }
+
+    return readCount;
+}
+
+void Channel::deliverMessage(Message &message) {
+    CL_INSTRUMENT(countReceived(message.size()));
+
     if (_messageReceivedCallback) {
-        for (auto &message : messages) {
-            _messageReceivedCallback(*message.get());
+        _messageReceivedCallback(message);
+    }
+}
+
+void Channel::dispatchMessage(Message &message) {
+    /*
+     *  Hide the frame prefix from the callback without copying the payload
+     */
+    Message payload(message.data() + message.sizeRead(),
+                    message.size() - message.sizeRead(), false /* copy */);
+
+    auto range = message.attachmentRange();
+
+    for (auto i = range.first; i != range.second; i++) {
+        payload.addAttachment(*i);
+    }
+
+    deliverMessage(payload);
+}
+
+void Channel::readFragment(Message &message, bool first) {
+    if (!first) {
+        /*
+         *  Only the first fragment carries attachments
+         */
+        Channel_CloseAttachments(message);
+    }
+
+    if (first) {
+        /*
+         *  A message still being reassembled will never be completed
+         */
+        dropReassembly();
+
+        uint64_t length = 0;
+
+        if (!message.decode(length) || length == 0) {
+            Channel_CloseAttachments(message);
+            return;
+        }
+
+        if (length > _maxFragmentedMessageSize) {
+            CL_LOG("Peer announced a fragmented message of %zu bytes",
+                   static_cast<size_t>(length));
+            Channel_CloseAttachments(message);
+            terminate();
+            return;
+        }
+
+        auto reassembly = Utils::make_unique<Message>();
+
+        if (!reassembly->reserve(length)) {
+            CL_LOG("Could not reserve %zu bytes for a fragmented message",
+                   static_cast<size_t>(length));
+            Channel_CloseAttachments(message);
+            return;
+        }
+
+        auto range = message.attachmentRange();
+
+        for (auto i = range.first; i != range.second; i++) {
+            reassembly->addAttachment(*i);
+        }
+
+        _reassembly = std::move(reassembly);
+        _reassemblyLength = length;
+    }
+
+    /*
+     *  Fragments of messages whose start was dropped are dropped as well
+     */
+    if (!_reassembly) {
+        return;
+    }
+
+    const size_t length = message.size() - message.sizeRead();
+
+    if (_reassembly->size() + length > _reassemblyLength) {
+        CL_LOG("Fragment overflows the message being reassembled");
+        dropReassembly();
+        return;
+    }
+
+    _reassembly->encodeBytes(message.data() + message.sizeRead(), length);
+
+    if (_reassembly->size() == _reassemblyLength) {
+        std::unique_ptr<Message> reassembled = std::move(_reassembly);
+
+        deliverMessage(*reassembled);
+    }
+}
+
+void Channel::dropReassembly() {
+    if (_reassembly) {
+        Channel_CloseAttachments(*_reassembly);
+        _reassembly = nullptr;
+    }
+}
+
+void Channel::readSpilledMessage(Message &message) {
+    auto range = message.attachmentRange();
+
+    if (range.first == range.second) {
+        return;
+    }
+
+    /*
+     *  The region is always the first attachment. The rest belong to the
+     *  message.
+     */
+    auto memory =
+        SharedMemory::Map(range.first->handle(), Channel_SpillSeals);
+
+    uint64_t length = 0;
+
+    if (!message.decode(length) || !memory->isReady() ||
+        memory->size() < length) {
+        CL_LOG("Invalid spilled message");
+
+        for (auto i = range.first + 1; i != range.second; i++) {
+            CL_CHECK(::close(i->handle()));
+        }
+
+        return;
+    }
+
+    Message spilled(static_cast<const uint8_t *>(memory->address()),
+                    static_cast<size_t>(length), false /* copy */);
+
+    for (auto i = range.first + 1; i != range.second; i++) {
+        spilled.addAttachment(*i);
+    }
+
+    deliverMessage(spilled);
+}
+
+void Channel::readMessageOnHandle(Handle handle) {
+    size_t readCount = 0;
+
+    /*
+     *  Records are dispatched as they are read instead of after the socket
+     *  has been drained. At most one budget worth is read per wakeup so that
+     *  a busy channel cannot starve other sources on the same looper.
+     */
+    Socket::Status status = _socket->ReadMessages(
+        [this](Message &record) { this->readRecord(record); }, _readBudget,
+        readCount);
+
+    if (_inboundTransport && _connected) {
+        /*
+         *  Records on the transport count against the same budget
+         */
+        const size_t transportBudget = _readBudget - readCount;
+
+        bool drained = false;
+        const size_t transportReadCount =
+            readMessagesOnTransport(transportBudget, drained);
+
+        /*
+         *  The budget ran out before the transport was drained. Unlike the
+         *  socket, re-arming the source does not help since the socket may
+         *  have nothing left to signal. Come back for the rest in a task,
+         *  which runs once the other sources ready in this wakeup had their
+         *  turn, as long as the channel is still in the looper.
+         */
+        if (!drained && transportReadCount == transportBudget && _source) {
+            std::weak_ptr<LooperSource> weakSource = _source;
+
+            Looper::Current()->post([weakSource]() {
+                auto source = weakSource.lock();
+
+                if (source && source->waitSetToken() != WaitSet::InvalidToken) {
+                    source->reader()(source->readHandle());
+                }
+            });
+        }
+
+        /*
+         *  The peer waits for room in the transport after asking for it.
+         *  Tell it once some was made, or right away if it already was.
+         */
+        if (_transportSpaceWanted && _connected &&
+            (transportReadCount > 0 || drained)) {
+            _transportSpaceWanted = false;
+
+            Message space;
+
+            if (writeFrame(ChannelFrameTransportSpace, space) ==
+                Socket::Status::PermanentFailure) {
+                terminate();
+                return;
+            }
         }
     }
 
@@ -147,6 +1241,60 @@ void Channel::readMessageOnHandle(Handle handle) {
         terminate();
         return;
     }
+
+    /*
+     *  The budget ran out before the socket was drained. Since the source
+     *  is edge triggered, the wait set will not signal it again for records
+     *  that are already pending. Updating the registration re-arms it, so
+     *  the looper comes back for the rest after its other ready sources.
+     */
+    if (status == Socket::Status::Success && readCount == _readBudget &&
+        _source) {
+        Looper::Current()->updateSource(_source);
+    }
+}
+
+void Channel::readRecord(Message &record) {
+    uint8_t frame = 0;
+
+    if (!record.decode(frame)) {
+        return;
+    }
+
+    switch (frame) {
+        case ChannelFrameMessage:
+            dispatchMessage(record);
+            break;
+        case ChannelFrameFragmentStart:
+        case ChannelFrameFragment:
+            readFragment(record, frame == ChannelFrameFragmentStart);
+            break;
+        case ChannelFrameSpill:
+            readSpilledMessage(record);
+            break;
+        case ChannelFrameTransportSetup:
+            setupInboundTransport(record);
+            break;
+        case ChannelFrameTransportAttachments: {
+            auto range = record.attachmentRange();
+            _inboundAttachments.insert(_inboundAttachments.end(), range.first,
+                                       range.second);
+        } break;
+        case ChannelFrameTransportDoorbell:
+            /*
+             *  Records are read below regardless
+             */
+            break;
+        case ChannelFrameTransportFull:
+            _transportSpaceWanted = true;
+            break;
+        case ChannelFrameTransportSpace:
+            drainTransportQueue();
+            break;
+        default:
+            CL_LOG("Unknown frame %d", frame);
+            break;
+    }
 }
 
 void Channel::scheduleInLooper(Looper *looper) {
@@ -154,6 +1302,23 @@ void Channel::scheduleInLooper(Looper *looper) {
         return;
     }
 
+    if (_threadAffinity) {
+        CL_ASSERT(looper == Looper::Current());
+
+        /*
+         *  Publish the looper first so that new senders on other threads
+         *  hand off to it, then wait for the ones that missed it before the
+         *  socket stops locking
+         */
+        _boundLooper->store(looper, std::memory_order_seq_cst);
+
+        while (_activeSenders.load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+
+        _socket->bindToCurrentThread();
+    }
+
     looper->addSource(source());
 }
 
@@ -165,4 +1330,47 @@ void Channel::unscheduleFromLooper(Looper *looper) {
     /* don't invoke the accessor which implicitly constructs a
      source */
     looper->removeSource(_source);
+
+    /*
+     *  The socket locks again before senders stop handing off
+     */
+    if (_boundLooper->load(std::memory_order_relaxed) == looper) {
+        _socket->unbindFromThread();
+        _boundLooper->store(nullptr, std::memory_order_release);
+    }
+}
+
+Channel::Stats Channel::stats() const {
+    Stats stats;
+
+#if CL_ENABLE_INSTRUMENTATION
+    stats.messagesSent = _messagesSent.load(std::memory_order_relaxed);
+    stats.bytesSent = _bytesSent.load(std::memory_order_relaxed);
+    stats.messagesReceived =
+        _messagesReceived.load(std::memory_order_relaxed);
+    stats.bytesReceived = _bytesReceived.load(std::memory_order_relaxed);
+#endif
+
+    return stats;
 }
+
+#if CL_ENABLE_INSTRUMENTATION
+
+void Channel::countSent(size_t size) {
+    _messagesSent.fetch_add(1, std::memory_order_relaxed);
+    _bytesSent.fetch_add(size, std::memory_order_relaxed);
+}
+
+void Channel::countReceived(size_t size) {
+    /*
+     *  Messages are only received on the thread servicing the channel
+     */
+    _messagesReceived.store(
+        _messagesReceived.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+    _bytesReceived.store(_bytesReceived.load(std::memory_order_relaxed) +
+                             size,
+                         std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Histogram.h"
+#include "Utilities.h"
+
+#include <algorithm>
+
+using namespace cl;
+
+const unsigned Histogram::SubBucketBits;
+const unsigned Histogram::MaxMagnitude;
+const size_t Histogram::BucketCount;
+
+static const uint64_t Histogram_SubBucketCount = 1
+                                                 << Histogram::SubBucketBits;
+
+Histogram::Histogram() {
+    reset();
+}
+
+size_t Histogram::BucketIndex(uint64_t value) {
+    /*
+     *  Values small enough to be counted exactly occupy the first group
+     */
+    if (value < Histogram_SubBucketCount) {
+        return static_cast<size_t>(value);
+    }
+
+    const unsigned magnitude = 63 - __builtin_clzll(value);
+
+    if (magnitude > MaxMagnitude) {
+        return BucketCount - 1;
+    }
+
+    const unsigned shift = magnitude - SubBucketBits;
+    const uint64_t subBucket = (value >> shift) & (Histogram_SubBucketCount - 1);
+
+    return ((shift + 1) << SubBucketBits) + subBucket;
+}
+
+uint64_t Histogram::BucketUpperBound(size_t index) {
+    const size_t group = index >> SubBucketBits;
+    const uint64_t subBucket = index & (Histogram_SubBucketCount - 1);
+
+    if (group == 0) {
+        return subBucket;
+    }
+
+    const unsigned shift = static_cast<unsigned>(group - 1);
+
+    return ((Histogram_SubBucketCount + subBucket + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+    /*
+     *  There is only one writer, so plain loads and stores suffice and no
+     *  locked instructions are needed
+     */
+    auto &bucket = _buckets[BucketIndex(value)];
+
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+
+    _sum.store(_sum.load(std::memory_order_relaxed) + value,
+               std::memory_order_relaxed);
+
+    if (value > _max.load(std::memory_order_relaxed)) {
+        _max.store(value, std::memory_order_relaxed);
+    }
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snapshot;
+
+    snapshot.buckets.resize(BucketCount);
+
+    for (size_t i = 0; i < BucketCount; i++) {
+        snapshot.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+
+    /*
+     *  The sum and maximum may be slightly ahead of the buckets if a value
+     *  is being recorded concurrently
+     */
+    snapshot.sum = _sum.load(std::memory_order_relaxed);
+    snapshot.max = _max.load(std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+void Histogram::reset() {
+    for (auto &bucket : _buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::Snapshot::percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    fraction = std::min(std::max(fraction, 0.0), 1.0);
+
+    const uint64_t rank =
+        std::max<uint64_t>(1, static_cast<uint64_t>(fraction * count + 0.5));
+
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+
+        /*
+         *  The last bucket is unbounded
+         */
+        if (seen >= rank && i + 1 < buckets.size()) {
+            return std::min(BucketUpperBound(i), max);
+        }
+    }
+
+    return max;
+}
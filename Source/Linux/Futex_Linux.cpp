@@ -0,0 +1,90 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Futex.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <limits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace cl;
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "Futex words must be plain 32 bit integers");
+
+static inline long Futex_Call(std::atomic<uint32_t> &word, int operation,
+                              uint32_t value, const struct timespec *timeout) {
+    return ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word),
+                     operation, value, timeout, nullptr, 0);
+}
+
+bool Futex::Wait(std::atomic<uint32_t> &word, uint32_t expected,
+                 std::chrono::nanoseconds timeout, Scope scope) {
+    struct timespec relative = {0};
+    const struct timespec *timeoutSpec = nullptr;
+
+    if (timeout != std::chrono::nanoseconds::max()) {
+        const int64_t nanoseconds = std::max<int64_t>(timeout.count(), 0);
+
+        relative.tv_sec = static_cast<time_t>(nanoseconds / 1000000000);
+        relative.tv_nsec = static_cast<long>(nanoseconds % 1000000000);
+
+        timeoutSpec = &relative;
+    }
+
+    const int operation =
+        scope == ScopePrivate ? FUTEX_WAIT_PRIVATE : FUTEX_WAIT;
+
+    if (Futex_Call(word, operation, expected, timeoutSpec) == 0) {
+        return true;
+    }
+
+    /*
+     *  The word already changed (EAGAIN) or a signal interrupted the wait
+     *  (EINTR). Either way the caller checks its condition again.
+     */
+    CL_ASSERT(errno == EAGAIN || errno == EINTR || errno == ETIMEDOUT);
+
+    return errno != ETIMEDOUT;
+}
+
+void Futex::Wake(std::atomic<uint32_t> &word, uint32_t count, Scope scope) {
+    const uint32_t limit = std::numeric_limits<int>::max();
+    const int operation =
+        scope == ScopePrivate ? FUTEX_WAKE_PRIVATE : FUTEX_WAKE;
+
+    /*
+     *  Returns the number of threads woken
+     */
+    const long result =
+        Futex_Call(word, operation, std::min(count, limit), nullptr);
+
+    CL_ASSERT(result >= 0);
+}
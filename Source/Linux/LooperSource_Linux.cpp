@@ -27,6 +27,7 @@
 #include "Base.h"
 
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/timerfd.h>
 #include <unistd.h>
 
@@ -36,30 +37,63 @@
 
 using namespace cl;
 
-static inline void LooperSource_UpdateEpollSource(int eventsMask, void *data,
+static inline void LooperSource_UpdateEpollSource(int eventsMask,
+                                                  WaitSet::Token token,
                                                   int epollDesc, int operation,
                                                   int desc) {
     struct epoll_event event = {0};
 
     event.events = eventsMask;
-    event.data.ptr = data; /* union */
+    event.data.u64 = token; /* union */
 
     CL_TEMP_FAILURE_RETRY(::epoll_ctl(epollDesc, operation, desc, &event));
 }
 
 void LooperSource::updateInWaitSetHandle(WaitSet::Handle waitsetHandle,
-                                         bool shouldAdd) {
+                                         WaitSetOperation operation) {
 
     if (_customWaitSetUpdateHandler) {
         _customWaitSetUpdateHandler(this, waitsetHandle, readHandle(),
-                                    shouldAdd);
+                                    operation);
         return;
     }
 
-    LooperSource_UpdateEpollSource(EPOLLIN,
-                                   this,
+    int eventsMask = 0;
+
+    if (_registrationFlags & RegisterReadable) {
+        eventsMask |= EPOLLIN;
+    }
+
+    if (_registrationFlags & RegisterWritable) {
+        eventsMask |= EPOLLOUT;
+    }
+
+    if (_registrationFlags & RegisterEdgeTriggered) {
+        eventsMask |= EPOLLET;
+    }
+
+    if (_registrationFlags & RegisterOneShot) {
+        eventsMask |= EPOLLONESHOT;
+    }
+
+    int epollOperation = EPOLL_CTL_ADD;
+
+    switch (operation) {
+        case WaitSetAdd:
+            epollOperation = EPOLL_CTL_ADD;
+            break;
+        case WaitSetUpdate:
+            epollOperation = EPOLL_CTL_MOD;
+            break;
+        case WaitSetRemove:
+            epollOperation = EPOLL_CTL_DEL;
+            break;
+    }
+
+    LooperSource_UpdateEpollSource(eventsMask,
+                                   _waitSetToken,
                                    waitsetHandle,
-                                   shouldAdd ? EPOLL_CTL_ADD : EPOLL_CTL_DEL,
+                                   epollOperation,
                                    readHandle());
 }
 
@@ -110,3 +144,53 @@ LooperSource::AsTimer(std::chrono::nanoseconds repeatInterval) {
                                           reader,
                                           nullptr);
 }
+
+std::shared_ptr<LooperSource> LooperSource::AsTrivial() {
+    /*
+     *  An eventfd coalesces any number of writes into a single read. It
+     *  also needs just one descriptor for both ends.
+     */
+
+    IOHandlesAllocator allocator = [] {
+        Handle desc = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+        CL_ASSERT(desc != -1);
+
+        return Handles(desc, desc);
+    };
+
+    IOHandlesDeallocator deallocator = [](Handles h) {
+        CL_ASSERT(h.first == h.second);
+        CL_CHECK(::close(h.first));
+    };
+
+    IOHandler reader = [](Handle r) {
+        /*
+         *  Reading resets the counter. The read may race with another reader
+         *  of the same source, in which case there is nothing left to read.
+         */
+        eventfd_t count = 0;
+
+        ssize_t size = CL_TEMP_FAILURE_RETRY(::read(r, &count, sizeof(count)));
+
+        CL_ASSERT(size == sizeof(count) || errno == EAGAIN);
+    };
+
+    IOHandler writer = [](Handle w) {
+        /*
+         *  The write only fails if the counter is about to overflow, in which
+         *  case the source is already signalled.
+         */
+        const eventfd_t count = 1;
+
+        ssize_t size =
+            CL_TEMP_FAILURE_RETRY(::write(w, &count, sizeof(count)));
+
+        CL_ASSERT(size == sizeof(count) || errno == EAGAIN);
+    };
+
+    return std::make_shared<LooperSource>(allocator,
+                                          deallocator,
+                                          reader,
+                                          writer);
+}
@@ -0,0 +1,162 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "SharedMemory.h"
+#include "Utilities.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace cl;
+
+static const size_t SharedMemory_HugePageSize = 2 << 20;
+
+static Handle SharedMemory_CreateHandle(size_t size, unsigned int flags) {
+    /*
+     *  The name is only used for debugging. There is no path to race on or
+     *  unlink.
+     */
+    Handle handle = ::memfd_create("CoreLib_SharedMemory",
+                                   MFD_CLOEXEC | MFD_ALLOW_SEALING | flags);
+
+    if (handle == -1) {
+        return -1;
+    }
+
+    if (CL_TEMP_FAILURE_RETRY(::ftruncate(handle, size)) == -1) {
+        CL_CHECK(::close(handle));
+        return -1;
+    }
+
+    return handle;
+}
+
+bool SharedMemory::SupportsSealing() {
+    return true;
+}
+
+bool SharedMemory::platformCreate(size_t size, Options options) {
+    if (options & OptionHugePages) {
+        const size_t hugeSize = (size + SharedMemory_HugePageSize - 1) &
+                                ~(SharedMemory_HugePageSize - 1);
+
+        _handle = SharedMemory_CreateHandle(hugeSize, MFD_HUGETLB);
+        _size = hugeSize;
+
+        if (_handle != -1 && platformMap(true, options)) {
+            return true;
+        }
+
+        /*
+         *  Huge pages are only available if the administrator reserved
+         *  them. Fall back to regular pages, which are advised to be
+         *  backed by transparent huge pages when mapped.
+         */
+        if (_handle != -1) {
+            CL_CHECK(::close(_handle));
+        }
+
+        _handle = -1;
+        _size = 0;
+    }
+
+    _handle = SharedMemory_CreateHandle(size, 0);
+
+    if (_handle == -1) {
+        return false;
+    }
+
+    _size = size;
+
+    return platformMap(true, options);
+}
+
+bool SharedMemory::platformMap(bool writable, Options options) {
+    const int protection = PROT_READ | (writable ? PROT_WRITE : 0);
+    const int flags =
+        MAP_SHARED | ((options & OptionPrefault) ? MAP_POPULATE : 0);
+
+    void *address = ::mmap(nullptr, _size, protection, flags, _handle, 0);
+
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    if (options & OptionHugePages) {
+        /*
+         *  Advisory only. Fails harmlessly on mappings that are already
+         *  backed by huge pages.
+         */
+        ::madvise(address, _size, MADV_HUGEPAGE);
+    }
+
+    _address = address;
+    _writable = writable;
+
+    return true;
+}
+
+bool SharedMemory::platformAddSeals(Seals seals) {
+    int fileSeals = 0;
+
+    if (seals & SealShrink) {
+        fileSeals |= F_SEAL_SHRINK;
+    }
+
+    if (seals & SealGrow) {
+        fileSeals |= F_SEAL_GROW;
+    }
+
+    if (seals & SealWrite) {
+        fileSeals |= F_SEAL_WRITE;
+    }
+
+    return ::fcntl(_handle, F_ADD_SEALS, fileSeals) == 0;
+}
+
+SharedMemory::Seals SharedMemory::platformSeals() const {
+    const int fileSeals = ::fcntl(_handle, F_GET_SEALS);
+
+    if (fileSeals == -1) {
+        return 0;
+    }
+
+    Seals seals = 0;
+
+    if (fileSeals & F_SEAL_SHRINK) {
+        seals |= SealShrink;
+    }
+
+    if (fileSeals & F_SEAL_GROW) {
+        seals |= SealGrow;
+    }
+
+    if (fileSeals & F_SEAL_WRITE) {
+        seals |= SealWrite;
+    }
+
+    return seals;
+}
@@ -0,0 +1,67 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Socket.h"
+#include "Utilities.h"
+
+#include <sys/socket.h>
+
+using namespace cl;
+
+int Socket::platformSendRecords(Handle handle, struct msghdr *headers,
+                                size_t count) {
+    struct mmsghdr records[count];
+
+    for (size_t i = 0; i < count; i++) {
+        records[i].msg_hdr = headers[i];
+        records[i].msg_len = 0;
+    }
+
+    return CL_TEMP_FAILURE_RETRY(::sendmmsg(handle, records, count, 0));
+}
+
+int Socket::platformReceiveRecords(Handle handle, struct msghdr *headers,
+                                   size_t *lengths, size_t count) {
+    struct mmsghdr records[count];
+
+    for (size_t i = 0; i < count; i++) {
+        records[i].msg_hdr = headers[i];
+        records[i].msg_len = 0;
+    }
+
+    int received = CL_TEMP_FAILURE_RETRY(
+        ::recvmmsg(handle, records, count, MSG_DONTWAIT, nullptr));
+
+    /*
+     *  The kernel updates the control length and flags in its own copy of
+     *  the headers. The caller needs them to extract attachments.
+     */
+    for (int i = 0; i < received; i++) {
+        headers[i] = records[i].msg_hdr;
+        lengths[i] = records[i].msg_len;
+    }
+
+    return received;
+}
@@ -29,6 +29,9 @@
 #include <sys/epoll.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <limits>
+
 using namespace cl;
 
 WaitSet::Handle WaitSet::platformHandleCreate() {
@@ -40,15 +43,57 @@ WaitSet::Handle WaitSet::platformHandleCreate() {
     return handle;
 }
 
-LooperSource *WaitSet::platformHandleWait(WaitSet::Handle handle) {
-    struct epoll_event event = {0};
+size_t WaitSet::platformHandleWait(WaitSet::Handle handle,
+                                  ReadySource *sources, size_t maxSources,
+                                  std::chrono::nanoseconds timeout) {
+    struct epoll_event events[maxSources];
+
+    /*
+     *  epoll only has millisecond resolution. Round up so that callers are
+     *  never woken before their deadline.
+     */
+    int timeoutMS = -1; /* infinite timeout */
+
+    if (timeout != std::chrono::nanoseconds::max()) {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            timeout + std::chrono::milliseconds(1) -
+            std::chrono::nanoseconds(1));
+
+        timeoutMS = (int)std::min<int64_t>(
+            std::max<int64_t>(ms.count(), 0), std::numeric_limits<int>::max());
+    }
 
     int val = CL_TEMP_FAILURE_RETRY(
-        ::epoll_wait(handle, &event, 1, -1 /* infinite timeout */));
+        ::epoll_wait(handle, events, (int)maxSources, timeoutMS));
+
+    CL_ASSERT(val >= 0);
+
+    if (val <= 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < val; i++) {
+        const uint32_t mask = events[i].events;
+
+        /*
+         *  Errors and hangups are reported to both readers and writers so
+         *  that they may notice the condition on their next operation.
+         */
+        uint32_t ready = 0;
+
+        if (mask & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            ready |= Readable;
+        }
+
+        if (mask & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+            ready |= Writable;
+        }
 
-    CL_ASSERT(val == 1);
+        sources[i].token = events[i].data.u64;
+        sources[i].events = ready;
+    }
 
-    return static_cast<LooperSource *>(event.data.ptr);
+    return val;
 }
 
 void WaitSet::platformHandleDestory(WaitSet::Handle handle) {
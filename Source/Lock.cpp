@@ -0,0 +1,105 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Lock.h"
+#include "LockProfile.h"
+
+using namespace cl;
+
+/*
+ *  About the cost of parking and waking a thread, well below a time slice
+ */
+static const size_t Lock_SpinCount = 128;
+
+void Lock::lockContended() const {
+#if CL_ENABLE_LOCK_PROFILING
+    const uint64_t start = LockProfile::Now();
+#endif
+
+    bool acquired = false;
+
+    /*
+     *  Spin while the owner is likely to release the lock soon. A lock
+     *  already marked contended has parked waiters, so park behind them
+     *  right away.
+     */
+    for (size_t spin = 0; spin < Lock_SpinCount; spin++) {
+        uint32_t state = _state.load(std::memory_order_relaxed);
+
+        if (state == Contended) {
+            break;
+        }
+
+        if (state == Unlocked &&
+            _state.compare_exchange_weak(state, Locked,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+            acquired = true;
+            break;
+        }
+
+        CL_CPU_PAUSE();
+    }
+
+    /*
+     *  Acquiring the lock as contended is conservative. The unlock may wake
+     *  a thread that is not parked, which is harmless.
+     */
+    while (!acquired &&
+           _state.exchange(Contended, std::memory_order_acquire) != Unlocked) {
+        Futex::Wait(_state, Contended, std::chrono::nanoseconds::max(),
+                    _scope);
+    }
+
+#if CL_ENABLE_LOCK_PROFILING
+    profileAcquired(true, LockProfile::Now() - start);
+#endif
+}
+
+#if CL_ENABLE_LOCK_PROFILING
+
+void Lock::profileAcquired(bool contended, uint64_t wait) const {
+    /*
+     *  The name of a lock in shared memory is only valid in the process
+     *  that created it, so those are not profiled
+     */
+    if (_scope != Futex::ScopePrivate) {
+        return;
+    }
+
+    _acquiredAt = LockProfile::Now();
+
+    LockProfile::RecordAcquisition(this, _name, contended, wait);
+}
+
+void Lock::profileReleased() const {
+    if (_scope != Futex::ScopePrivate) {
+        return;
+    }
+
+    LockProfile::RecordHold(this, _name, LockProfile::Now() - _acquiredAt);
+}
+
+#endif
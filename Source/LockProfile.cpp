@@ -0,0 +1,269 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "LockProfile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unordered_map>
+
+using namespace cl;
+
+#if CL_ENABLE_LOCK_PROFILING
+
+/*
+ *  Only the owning thread updates a slot, so counters are plain loads and
+ *  stores. They are atomic so that snapshots may read them at any time.
+ */
+struct LockProfile_Slot {
+    std::atomic<const void *> key;
+    const char *name;
+    const void *lock;
+
+    std::atomic<uint64_t> acquisitions;
+    std::atomic<uint64_t> contendedAcquisitions;
+    std::atomic<uint64_t> totalWait;
+    std::atomic<uint64_t> maxWait;
+    std::atomic<uint64_t> totalHold;
+    std::atomic<uint64_t> maxHold;
+};
+
+/*
+ *  Locks of a thread are found by hashing their key into a fixed table.
+ *  Acquisitions of locks that do not fit are only counted.
+ */
+static const size_t LockProfile_SlotCount = 256;
+
+struct LockProfile_Buffer {
+    LockProfile_Slot slots[LockProfile_SlotCount];
+    std::atomic<uint64_t> dropped;
+    LockProfile_Buffer *next;
+
+    LockProfile_Buffer() : next(nullptr) {
+        dropped.store(0, std::memory_order_relaxed);
+
+        for (auto &slot : slots) {
+            slot.key.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+};
+
+static std::atomic<LockProfile_Buffer *> LockProfile_Buffers(nullptr);
+
+static LockProfile_Buffer &LockProfile_ThreadBuffer() {
+    static thread_local LockProfile_Buffer *buffer = nullptr;
+
+    if (buffer == nullptr) {
+        buffer = new LockProfile_Buffer();
+
+        /*
+         *  Buffers are only ever added to the front of the list
+         */
+        LockProfile_Buffer *head =
+            LockProfile_Buffers.load(std::memory_order_relaxed);
+
+        do {
+            buffer->next = head;
+        } while (!LockProfile_Buffers.compare_exchange_weak(
+            head, buffer, std::memory_order_release,
+            std::memory_order_relaxed));
+    }
+
+    return *buffer;
+}
+
+/*
+ *  Locks of the same name are profiled together
+ */
+static LockProfile_Slot *LockProfile_SlotForLock(const void *lock,
+                                                 const char *name) {
+    LockProfile_Buffer &buffer = LockProfile_ThreadBuffer();
+
+    const void *key = name != nullptr ? static_cast<const void *>(name) : lock;
+    const size_t hash = std::hash<const void *>()(key);
+
+    for (size_t probe = 0; probe < LockProfile_SlotCount; probe++) {
+        LockProfile_Slot &slot =
+            buffer.slots[(hash + probe) % LockProfile_SlotCount];
+
+        const void *slotKey = slot.key.load(std::memory_order_relaxed);
+
+        if (slotKey == key) {
+            return &slot;
+        }
+
+        if (slotKey != nullptr) {
+            continue;
+        }
+
+        slot.name = name;
+        slot.lock = name != nullptr ? nullptr : lock;
+
+        slot.acquisitions.store(0, std::memory_order_relaxed);
+        slot.contendedAcquisitions.store(0, std::memory_order_relaxed);
+        slot.totalWait.store(0, std::memory_order_relaxed);
+        slot.maxWait.store(0, std::memory_order_relaxed);
+        slot.totalHold.store(0, std::memory_order_relaxed);
+        slot.maxHold.store(0, std::memory_order_relaxed);
+
+        /*
+         *  Publishes the slot to snapshots
+         */
+        slot.key.store(key, std::memory_order_release);
+
+        return &slot;
+    }
+
+    buffer.dropped.store(buffer.dropped.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+
+    return nullptr;
+}
+
+static inline void LockProfile_Add(std::atomic<uint64_t> &counter,
+                                   uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+}
+
+static inline void LockProfile_Max(std::atomic<uint64_t> &counter,
+                                   uint64_t value) {
+    if (value > counter.load(std::memory_order_relaxed)) {
+        counter.store(value, std::memory_order_relaxed);
+    }
+}
+
+uint64_t LockProfile::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void LockProfile::RecordAcquisition(const void *lock, const char *name,
+                                    bool contended, uint64_t wait) {
+    LockProfile_Slot *slot = LockProfile_SlotForLock(lock, name);
+
+    if (slot == nullptr) {
+        return;
+    }
+
+    LockProfile_Add(slot->acquisitions, 1);
+
+    if (contended) {
+        LockProfile_Add(slot->contendedAcquisitions, 1);
+        LockProfile_Add(slot->totalWait, wait);
+        LockProfile_Max(slot->maxWait, wait);
+    }
+}
+
+void LockProfile::RecordHold(const void *lock, const char *name,
+                             uint64_t hold) {
+    LockProfile_Slot *slot = LockProfile_SlotForLock(lock, name);
+
+    if (slot == nullptr) {
+        return;
+    }
+
+    LockProfile_Add(slot->totalHold, hold);
+    LockProfile_Max(slot->maxHold, hold);
+}
+
+std::vector<LockProfile::Entry> LockProfile::Snapshot() {
+    std::unordered_map<const void *, Entry> entries;
+
+    for (LockProfile_Buffer *buffer =
+             LockProfile_Buffers.load(std::memory_order_acquire);
+         buffer != nullptr; buffer = buffer->next) {
+        for (const auto &slot : buffer->slots) {
+            const void *key = slot.key.load(std::memory_order_acquire);
+
+            if (key == nullptr) {
+                continue;
+            }
+
+            auto result = entries.insert(
+                std::make_pair(key, Entry{slot.name, slot.lock, 0, 0, 0, 0,
+                                          0, 0}));
+            Entry &entry = result.first->second;
+
+            entry.acquisitions +=
+                slot.acquisitions.load(std::memory_order_relaxed);
+            entry.contendedAcquisitions +=
+                slot.contendedAcquisitions.load(std::memory_order_relaxed);
+            entry.totalWait += slot.totalWait.load(std::memory_order_relaxed);
+            entry.maxWait = std::max(
+                entry.maxWait, slot.maxWait.load(std::memory_order_relaxed));
+            entry.totalHold += slot.totalHold.load(std::memory_order_relaxed);
+            entry.maxHold = std::max(
+                entry.maxHold, slot.maxHold.load(std::memory_order_relaxed));
+        }
+    }
+
+    std::vector<Entry> snapshot;
+    snapshot.reserve(entries.size());
+
+    for (const auto &entry : entries) {
+        snapshot.push_back(entry.second);
+    }
+
+    std::sort(snapshot.begin(), snapshot.end(),
+              [](const Entry &a, const Entry &b) {
+                  return a.totalWait > b.totalWait;
+              });
+
+    return snapshot;
+}
+
+#else
+
+std::vector<LockProfile::Entry> LockProfile::Snapshot() {
+    return std::vector<Entry>();
+}
+
+#endif
+
+void LockProfile::Dump() {
+    printf("%-32s %12s %12s %12s %12s %12s %12s\n", "Lock", "Acquired",
+           "Contended", "Wait (ns)", "Max wait", "Hold (ns)", "Max hold");
+
+    for (const auto &entry : Snapshot()) {
+        char name[33];
+
+        if (entry.name != nullptr) {
+            snprintf(name, sizeof(name), "%s", entry.name);
+        } else {
+            snprintf(name, sizeof(name), "%p", entry.lock);
+        }
+
+        printf("%-32s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64
+               " %12" PRIu64 " %12" PRIu64 "\n",
+               name, entry.acquisitions, entry.contendedAcquisitions,
+               entry.totalWait, entry.maxWait, entry.totalHold,
+               entry.maxHold);
+    }
+}
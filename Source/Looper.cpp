@@ -28,6 +28,7 @@
 
 #include <pthread.h>
 #include <mutex>
+#include <algorithm>
 
 using namespace cl;
 
@@ -52,51 +53,358 @@ Looper *Looper::Current() {
     return currentLooper;
 }
 
-Looper::Looper() : _shouldTerminate(false) {
+Looper::Looper()
+    : _dispatchBudget(std::chrono::nanoseconds::max()),
+      _delayedTasksSequence(0), _sourceCount(0), _shouldTerminate(false) {
+    resetWorstDispatchWaits();
+
+    /*
+     *  A trivial source needs to be added to keep the loop idle without any
+     *  other sources present. It is also used to wake the looper from other
+     *  threads, so its handles must be allocated before the looper is
+     *  visible to them. It is not counted as one of the sources of the
+     *  looper.
+     */
+    _trivialSource = LooperSource::AsTrivial();
+    _trivialSource->handles();
+    _trivialSource->setWakeFunction([this]() { drainTasks(); });
+    _trivialSource->setPriority(LooperSource::PriorityControl);
+
+    _waitSet.addSource(_trivialSource);
 }
 
 Looper::~Looper() {
 }
 
 bool Looper::addSource(std::shared_ptr<LooperSource> source) {
-    return _waitSet.addSource(source);
+    if (!_waitSet.addSource(source)) {
+        return false;
+    }
+
+    _sourceCount++;
+    return true;
 }
 
 bool Looper::removeSource(std::shared_ptr<LooperSource> source) {
-    return _waitSet.removeSource(source);
+    if (!_waitSet.removeSource(source)) {
+        return false;
+    }
+
+    _sourceCount--;
+    return true;
+}
+
+bool Looper::updateSource(std::shared_ptr<LooperSource> source) {
+    return _waitSet.updateSource(source);
 }
 
 void Looper::loop() {
 
-    if (_trivialSource.get() == nullptr) {
+    while (!_shouldTerminate) {
         /*
-         *  A trivial source needs to be added to keep the loop idle
-         *  without any other sources present.
+         *  Sources deferred from the previous wakeup are still waiting to
+         *  be dispatched, so only check for new ones without blocking
          */
-        _trivialSource = LooperSource::AsTrivial();
-        addSource(_trivialSource);
+        const std::chrono::nanoseconds timeout =
+            _pendingSources.empty() ? nextTimeout()
+                                    : std::chrono::nanoseconds(0);
+
+        const WaitSet::ReadySources &sources = _waitSet.wait(timeout);
+
+#if CL_ENABLE_INSTRUMENTATION
+        const auto signalTime = std::chrono::steady_clock::now();
+#endif
+
+        for (const auto &ready : sources) {
+            LooperSource *source = _waitSet.source(ready.token);
+
+            if (source == nullptr) {
+                continue;
+            }
+
+            /*
+             *  A source deferred from the previous wakeup may be reported
+             *  again. It keeps its place and picks up the new events.
+             */
+            if (!_waitSet.markPending(ready.token)) {
+                for (auto &pending : _pendingSources) {
+                    if (pending.token == ready.token) {
+                        pending.events |= ready.events;
+                        break;
+                    }
+                }
+
+                continue;
+            }
+
+            PendingSource pending = {ready.token, ready.events,
+                                     source->priority()};
+
+            CL_INSTRUMENT(pending.signalTime = signalTime);
+
+            _pendingSources.push_back(pending);
+        }
+
+        dispatchPendingSources();
+
+        _timerWheel.advance(TimerWheel::Clock::now());
+
+        runDueDelayedTasks();
     }
 
-    while (!_shouldTerminate) {
-        LooperSource *source = _waitSet.wait();
+    _shouldTerminate = false;
+}
 
-        if (source == nullptr) {
-            continue;
+void Looper::dispatchPendingSources() {
+    if (_pendingSources.empty()) {
+        return;
+    }
+
+    const bool budgeted =
+        _dispatchBudget != std::chrono::nanoseconds::max();
+
+    /*
+     *  The clock is only read after each handler if the budget or the
+     *  instrumentation need it
+     */
+    const bool timed = budgeted || CL_ENABLE_INSTRUMENTATION;
+
+    auto now = timed ? std::chrono::steady_clock::now()
+                     : std::chrono::steady_clock::time_point();
+    const auto deadline = budgeted ? now + _dispatchBudget
+                                   : std::chrono::steady_clock::time_point::max();
+
+    bool exhausted = false;
+
+    /*
+     *  There are only a handful of priority classes. A pass per class keeps
+     *  sources of the same class in the order they were signalled without
+     *  sorting.
+     */
+    for (size_t priority = 0; priority < LooperSource::PriorityCount;
+         priority++) {
+        for (const auto &pending : _pendingSources) {
+            if (pending.priority != priority) {
+                continue;
+            }
+
+            if (exhausted) {
+                LooperSource *source = _waitSet.source(pending.token);
+
+                if (source == nullptr) {
+                    continue;
+                }
+
+                /*
+                 *  Level triggered sources are signalled again by the wait
+                 *  set on the next wakeup. Others would be lost.
+                 */
+                const auto flags = source->registrationFlags();
+
+                if (flags & (LooperSource::RegisterEdgeTriggered |
+                             LooperSource::RegisterOneShot)) {
+                    _deferredSources.push_back(pending);
+                } else {
+                    _waitSet.clearPending(pending.token);
+                }
+
+                continue;
+            }
+
+#if CL_ENABLE_INSTRUMENTATION
+            const int64_t wait =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - pending.signalTime).count();
+
+            if (wait > _worstDispatchWaits[priority].load(
+                           std::memory_order_relaxed)) {
+                _worstDispatchWaits[priority].store(
+                    wait, std::memory_order_relaxed);
+            }
+
+            const auto start = now;
+#endif
+
+            _waitSet.clearPending(pending.token);
+            dispatchSource(pending.token, pending.events);
+
+            if (timed) {
+                now = std::chrono::steady_clock::now();
+            }
+
+#if CL_ENABLE_INSTRUMENTATION
+            if (LooperSource *source = _waitSet.source(pending.token)) {
+                source->_handlerTimes.record(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        now - start).count());
+            }
+#endif
+
+            exhausted = now >= deadline;
         }
+    }
 
-        auto reader = source->reader();
+    _pendingSources.clear();
+    std::swap(_pendingSources, _deferredSources);
+}
+
+void Looper::dispatchSource(WaitSet::Token token, uint32_t events) {
+    LooperSource *source = _waitSet.source(token);
+
+    if (source == nullptr) {
+        return;
+    }
 
-        if (reader) {
-            reader(source->readHandle());
+    if (events & WaitSet::Writable) {
+        auto writableHandler = source->writableHandler();
+
+        if (writableHandler) {
+            writableHandler(source->writeHandle());
+
+            /*
+             *  The handler removed its own source from the wait set
+             */
+            if (_waitSet.source(token) == nullptr) {
+                return;
+            }
         }
+    }
 
-        source->onAwoken();
+    if ((events & WaitSet::Readable) == 0) {
+        return;
     }
 
-    _shouldTerminate = false;
+    auto reader = source->reader();
+
+    if (reader) {
+        reader(source->readHandle());
+
+        /*
+         *  The reader removed its own source from the wait set
+         */
+        if (_waitSet.source(token) == nullptr) {
+            return;
+        }
+    }
+
+    source->onAwoken();
+}
+
+std::chrono::nanoseconds
+Looper::worstDispatchWait(LooperSource::Priority priority) const {
+    CL_ASSERT(priority < LooperSource::PriorityCount);
+
+    return std::chrono::nanoseconds(
+        _worstDispatchWaits[priority].load(std::memory_order_relaxed));
+}
+
+std::vector<Looper::SourceStats> Looper::sourceStats() const {
+    std::vector<SourceStats> stats;
+
+#if CL_ENABLE_INSTRUMENTATION
+    for (auto &source : _waitSet.sources()) {
+        if (source == _trivialSource) {
+            continue;
+        }
+
+        stats.push_back(SourceStats{source, source->handlerTimes()});
+    }
+
+    std::sort(stats.begin(), stats.end(),
+              [](const SourceStats &a, const SourceStats &b) {
+                  return a.handlerTimes.max > b.handlerTimes.max;
+              });
+#endif
+
+    return stats;
+}
+
+void Looper::resetWorstDispatchWaits() {
+    for (auto &wait : _worstDispatchWaits) {
+        wait.store(0, std::memory_order_relaxed);
+    }
 }
 
 void Looper::terminate() {
     _shouldTerminate = true;
     _trivialSource->writer()(_trivialSource->writeHandle());
 }
+
+void Looper::post(Task task) {
+    postAt(std::move(task), TaskQueue::Clock::time_point::min());
+}
+
+void Looper::postDelayed(Task task, std::chrono::nanoseconds delay) {
+    postAt(std::move(task), TaskQueue::Clock::now() + delay);
+}
+
+void Looper::postAt(Task task, TaskQueue::Clock::time_point fireTime) {
+    /*
+     *  Only the producer that finds the queue empty needs to wake the looper.
+     *  Everyone else is picked up in the same batch.
+     */
+    if (_tasks.push(std::move(task), fireTime)) {
+        _trivialSource->writer()(_trivialSource->writeHandle());
+    }
+}
+
+void Looper::drainTasks() {
+    auto now = TaskQueue::Clock::now();
+
+    _tasks.drain([&](Task &task, TaskQueue::Clock::time_point fireTime) {
+        if (fireTime <= now) {
+            task();
+            return;
+        }
+
+        _delayedTasks.push(
+            DelayedTask{fireTime, _delayedTasksSequence++, std::move(task)});
+    });
+}
+
+void Looper::runDueDelayedTasks() {
+    if (_delayedTasks.empty()) {
+        return;
+    }
+
+    auto now = TaskQueue::Clock::now();
+
+    while (!_delayedTasks.empty() && _delayedTasks.top().fireTime <= now) {
+        /*
+         *  The heap only exposes a const top. Moving out of it is safe since
+         *  the entry is popped right after.
+         */
+        auto &top = const_cast<DelayedTask &>(_delayedTasks.top());
+
+        Task task = std::move(top.task);
+        _delayedTasks.pop();
+
+        task();
+    }
+}
+
+std::chrono::nanoseconds Looper::nextTimeout() const {
+    auto now = TaskQueue::Clock::now();
+
+    auto timeout = _timerWheel.timeout(now);
+
+    if (!_delayedTasks.empty()) {
+        auto delayedTaskTimeout =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                _delayedTasks.top().fireTime - now);
+
+        timeout = std::min(
+            timeout, std::max(delayedTaskTimeout, std::chrono::nanoseconds(0)));
+    }
+
+    return timeout;
+}
+
+void Looper::scheduleTimer(Timer &timer, std::chrono::nanoseconds delay,
+                           std::chrono::nanoseconds repeatInterval) {
+    _timerWheel.schedule(timer, delay, repeatInterval);
+}
+
+void Looper::cancelTimer(Timer &timer) {
+    _timerWheel.cancel(timer);
+}
@@ -0,0 +1,141 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "LooperPool.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+using namespace cl;
+
+LooperPool::LooperPool(size_t size)
+    : _selectionPolicy(RoundRobinPolicy()) {
+
+    if (size == 0) {
+        size = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    _loopers.resize(size, nullptr);
+    _pendingDispatches.reset(new std::atomic<size_t>[size]);
+
+    std::mutex mutex;
+    std::condition_variable started;
+    size_t startedCount = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        _pendingDispatches[i] = 0;
+
+        _threads.emplace_back([this, i, &mutex, &started, &startedCount]() {
+            auto looper = Looper::Current();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                _loopers[i] = looper;
+                startedCount++;
+            }
+
+            started.notify_one();
+
+            looper->loop();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    started.wait(lock, [&]() { return startedCount == size; });
+}
+
+LooperPool::~LooperPool() {
+    /*
+     *  Terminate from the thread servicing each looper so that termination
+     *  is ordered after all previously dispatched tasks
+     */
+    for (auto looper : _loopers) {
+        looper->post([looper]() { looper->terminate(); });
+    }
+
+    for (auto &thread : _threads) {
+        thread.join();
+    }
+}
+
+Looper *LooperPool::looper(size_t index) const {
+    CL_ASSERT(index < _loopers.size());
+    return _loopers[index];
+}
+
+size_t LooperPool::load(size_t index) const {
+    CL_ASSERT(index < _loopers.size());
+    return _loopers[index]->sourceCount() +
+           _pendingDispatches[index].load(std::memory_order_relaxed);
+}
+
+Looper *LooperPool::dispatch(DispatchTask task) {
+    const size_t index = _selectionPolicy(*this);
+
+    CL_ASSERT(index < _loopers.size());
+
+    Looper *looper = _loopers[index];
+    std::atomic<size_t> &pending = _pendingDispatches[index];
+
+    pending++;
+
+    looper->post([task, looper, &pending]() {
+        /*
+         *  The task is no longer pending once it starts. Any sources it adds
+         *  are accounted for by the looper itself.
+         */
+        pending--;
+        task(looper);
+    });
+
+    return looper;
+}
+
+LooperPool::SelectionPolicy LooperPool::RoundRobinPolicy() {
+    auto next = std::make_shared<std::atomic<size_t>>(0);
+
+    return [next](const LooperPool &pool) {
+        return next->fetch_add(1, std::memory_order_relaxed) % pool.size();
+    };
+}
+
+LooperPool::SelectionPolicy LooperPool::LeastLoadedPolicy() {
+    return [](const LooperPool &pool) {
+        size_t selected = 0;
+        size_t selectedLoad = pool.load(0);
+
+        for (size_t i = 1; i < pool.size() && selectedLoad > 0; i++) {
+            size_t load = pool.load(i);
+
+            if (load < selectedLoad) {
+                selected = i;
+                selectedLoad = load;
+            }
+        }
+
+        return selected;
+    };
+}
@@ -30,13 +30,15 @@
 using namespace cl;
 
 Message::Message(size_t length)
-    : _buffer(nullptr), _bufferLength(0), _dataLength(0), _sizeRead(0) {
+    : _buffer(nullptr), _ownsBuffer(true), _bufferLength(0), _dataLength(0),
+      _sizeRead(0) {
 
     reserve(length);
 }
 
 Message::Message(const uint8_t *buffer, size_t bufferSize)
-    : _dataLength(bufferSize), _bufferLength(bufferSize), _sizeRead(0) {
+    : _ownsBuffer(true), _dataLength(bufferSize), _bufferLength(bufferSize),
+      _sizeRead(0) {
 
     void *allocation = malloc(bufferSize);
 
@@ -45,8 +47,24 @@ Message::Message(const uint8_t *buffer, size_t bufferSize)
     _buffer = static_cast<uint8_t *>(allocation);
 }
 
+Message::Message(const uint8_t *buffer, size_t bufferSize, bool copy)
+    : _buffer(const_cast<uint8_t *>(buffer)), _ownsBuffer(false),
+      _dataLength(bufferSize), _bufferLength(bufferSize), _sizeRead(0) {
+
+    if (copy) {
+        void *allocation = malloc(bufferSize);
+
+        memcpy(allocation, buffer, bufferSize);
+
+        _buffer = static_cast<uint8_t *>(allocation);
+        _ownsBuffer = true;
+    }
+}
+
 Message::~Message() {
-    free(_buffer);
+    if (_ownsBuffer) {
+        free(_buffer);
+    }
 }
 
 static inline size_t Message_NextPOTSize(size_t x) {
@@ -62,6 +80,13 @@ static inline size_t Message_NextPOTSize(size_t x) {
 }
 
 bool Message::reserve(size_t length) {
+    /*
+     *  Messages referencing buffers they don't own are read only
+     */
+    if (!_ownsBuffer) {
+        return false;
+    }
+
     if (length == 0 || _bufferLength >= length) {
         return true;
     }
@@ -99,6 +124,14 @@ bool Message::resizeBuffer(size_t size) {
     return success;
 }
 
+void Message::reset() {
+    CL_ASSERT(_ownsBuffer);
+
+    _dataLength = 0;
+    _sizeRead = 0;
+    _attachments.clear();
+}
+
 void Message::addAttachment(Attachment attachment) {
     CL_ASSERT(_attachments.size() <= Socket::MaxControlBufferItemCount);
     
@@ -24,3 +24,411 @@
 
 
 #include "RingBuffer.h"
+
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace cl;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Ring indices must be lock free to be shared across processes");
+
+static const uint32_t RingBuffer_Magic = 0x434C5242; /* CLRB */
+static const uint32_t RingBuffer_PaddingMarker =
+    std::numeric_limits<uint32_t>::max();
+static const size_t RingBuffer_CacheLineSize = 64;
+static const size_t RingBuffer_MinCapacity = RingBuffer_CacheLineSize;
+static const size_t RingBuffer_RecordAlignment = 8;
+
+/*
+ *  The head is only written by the producer and the tail only by the
+ *  consumer. Each is on its own cache line so that the two sides do not
+ *  contend on every update.
+ */
+struct RingBuffer::Header {
+    uint32_t magic;
+    uint64_t capacity;
+
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+};
+
+/*
+ *  Records are aligned to 8 bytes. A record may not wrap around the end of
+ *  the ring. Instead, the rest of the ring is skipped with a padding record.
+ */
+struct RingBuffer_RecordHeader {
+    uint32_t length;
+    uint32_t tag;
+};
+
+static inline size_t RingBuffer_RecordSize(size_t length) {
+    return sizeof(RingBuffer_RecordHeader) +
+           ((length + RingBuffer_RecordAlignment - 1) &
+            ~(RingBuffer_RecordAlignment - 1));
+}
+
+static inline bool RingBuffer_IsPowerOfTwo(size_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+static inline size_t RingBuffer_RoundedCapacity(size_t capacity) {
+    size_t roundedCapacity = RingBuffer_MinCapacity;
+
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+
+    return roundedCapacity;
+}
+
+static inline bool RingBuffer_IsAligned(const void *region) {
+    return (reinterpret_cast<uintptr_t>(region) &
+            (RingBuffer_CacheLineSize - 1)) == 0;
+}
+
+size_t RingBuffer::RegionSize(size_t capacity) {
+    return sizeof(Header) + RingBuffer_RoundedCapacity(capacity);
+}
+
+std::unique_ptr<RingBuffer> RingBuffer::Create(size_t capacity) {
+    const size_t regionSize = RegionSize(capacity);
+
+    void *region = nullptr;
+
+    if (::posix_memalign(&region, RingBuffer_CacheLineSize, regionSize) !=
+        0) {
+        return nullptr;
+    }
+
+    auto ring = Create(region, regionSize);
+
+    if (ring == nullptr) {
+        ::free(region);
+        return nullptr;
+    }
+
+    ring->_ownedRegion = region;
+
+    return ring;
+}
+
+std::unique_ptr<RingBuffer> RingBuffer::Create(void *region, size_t size) {
+    if (!RingBuffer_IsAligned(region) ||
+        size < sizeof(Header) + RingBuffer_MinCapacity) {
+        return nullptr;
+    }
+
+    size_t capacity = RingBuffer_MinCapacity;
+
+    while (capacity <= (size - sizeof(Header)) / 2) {
+        capacity <<= 1;
+    }
+
+    Header *header = new (region) Header();
+
+    header->magic = RingBuffer_Magic;
+    header->capacity = capacity;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_release);
+
+    return std::unique_ptr<RingBuffer>(
+        new RingBuffer(region, capacity, nullptr));
+}
+
+std::unique_ptr<RingBuffer> RingBuffer::Attach(void *region, size_t size) {
+    if (!RingBuffer_IsAligned(region) || size < sizeof(Header)) {
+        return nullptr;
+    }
+
+    const Header *header = static_cast<const Header *>(region);
+
+    const uint64_t capacity = header->capacity;
+
+    if (header->magic != RingBuffer_Magic ||
+        !RingBuffer_IsPowerOfTwo(capacity) ||
+        capacity < RingBuffer_MinCapacity ||
+        capacity > size - sizeof(Header)) {
+        return nullptr;
+    }
+
+    return std::unique_ptr<RingBuffer>(
+        new RingBuffer(region, capacity, nullptr));
+}
+
+RingBuffer::RingBuffer(void *region, size_t capacity, void *ownedRegion)
+    : _header(static_cast<Header *>(region)),
+      _data(static_cast<uint8_t *>(region) + sizeof(Header)),
+      _capacity(capacity), _ownedRegion(ownedRegion) {
+    const uint64_t head = _header->head.load(std::memory_order_acquire);
+    const uint64_t tail = _header->tail.load(std::memory_order_acquire);
+
+    _producer.position = head;
+    _producer.peerPosition = tail;
+
+    _consumer.position = tail;
+    _consumer.peerPosition = head;
+}
+
+RingBuffer::~RingBuffer() {
+    ::free(_ownedRegion);
+}
+
+void *RingBuffer::operator new(size_t size) noexcept {
+    void *pointer = nullptr;
+
+    if (::posix_memalign(&pointer, alignof(RingBuffer), size) != 0) {
+        return nullptr;
+    }
+
+    return pointer;
+}
+
+void RingBuffer::operator delete(void *pointer) noexcept {
+    ::free(pointer);
+}
+
+size_t RingBuffer::maxRecordLength() const {
+    return std::min<size_t>(_capacity - sizeof(RingBuffer_RecordHeader),
+                            RingBuffer_PaddingMarker - 1);
+}
+
+/*
+ *  Each side works off the last position of its peer that it has seen and
+ *  only loads the shared index again when that is not enough. This keeps
+ *  the cache line holding the index of the peer from bouncing between the
+ *  two sides on every operation.
+ */
+size_t RingBuffer::freeSpace(size_t wanted) {
+    uint64_t used = _producer.position - _producer.peerPosition;
+
+    if (_capacity - std::min<uint64_t>(used, _capacity) < wanted) {
+        _producer.peerPosition = _header->tail.load(std::memory_order_acquire);
+        used = _producer.position - _producer.peerPosition;
+    }
+
+    /*
+     *  A consumer that is not trusted may publish a tail ahead of the head.
+     *  Treat that as a full ring.
+     */
+    return _capacity - std::min<uint64_t>(used, _capacity);
+}
+
+size_t RingBuffer::usedSpace(size_t wanted) {
+    uint64_t used = _consumer.peerPosition - _consumer.position;
+
+    if (used < wanted) {
+        _consumer.peerPosition = _header->head.load(std::memory_order_acquire);
+        used = _consumer.peerPosition - _consumer.position;
+    }
+
+    return used;
+}
+
+uint8_t *RingBuffer::reserve(size_t &length) {
+    const size_t offset = _producer.position & (_capacity - 1);
+
+    length = std::min(length, _capacity - offset);
+    length = std::min(length, freeSpace(length));
+
+    if (length == 0) {
+        return nullptr;
+    }
+
+    _producer.position += length;
+
+    return _data + offset;
+}
+
+uint8_t *RingBuffer::reserveRecord(size_t length, uint32_t tag) {
+    if (length > maxRecordLength()) {
+        return nullptr;
+    }
+
+    const size_t recordSize = RingBuffer_RecordSize(length);
+
+    size_t offset = _producer.position & (_capacity - 1);
+    const size_t contiguous = _capacity - offset;
+
+    if (recordSize > contiguous) {
+        if (freeSpace(contiguous) < contiguous) {
+            return nullptr;
+        }
+
+        RingBuffer_RecordHeader padding = {RingBuffer_PaddingMarker, 0};
+        memcpy(_data + offset, &padding, sizeof(padding));
+
+        _producer.position += contiguous;
+        offset = 0;
+    }
+
+    if (freeSpace(recordSize) < recordSize) {
+        return nullptr;
+    }
+
+    RingBuffer_RecordHeader record = {static_cast<uint32_t>(length), tag};
+    memcpy(_data + offset, &record, sizeof(record));
+
+    _producer.position += recordSize;
+
+    return _data + offset + sizeof(RingBuffer_RecordHeader);
+}
+
+void RingBuffer::commit() {
+    _header->head.store(_producer.position, std::memory_order_release);
+}
+
+/*
+ *  Publishing a new head and then checking the tail pairs with the consumer
+ *  storing its tail and then checking the head. At least one of the two
+ *  sides is guaranteed to see the update of the other. So either the
+ *  consumer picks up the new data or the producer notices that the consumer
+ *  had caught up and may be idle.
+ */
+bool RingBuffer::commitAndCheckIdle() {
+    const uint64_t previousHead = _header->head.load(std::memory_order_relaxed);
+
+    _header->head.store(_producer.position, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    _producer.peerPosition = _header->tail.load(std::memory_order_acquire);
+
+    return _producer.peerPosition == previousHead;
+}
+
+size_t RingBuffer::write(const void *bytes, size_t length) {
+    const uint8_t *source = static_cast<const uint8_t *>(bytes);
+
+    size_t written = 0;
+
+    while (written < length) {
+        size_t reserved = length - written;
+        uint8_t *destination = reserve(reserved);
+
+        if (destination == nullptr) {
+            break;
+        }
+
+        memcpy(destination, source + written, reserved);
+        written += reserved;
+    }
+
+    commit();
+
+    return written;
+}
+
+const uint8_t *RingBuffer::peek(size_t &length) {
+    const size_t offset = _consumer.position & (_capacity - 1);
+
+    length = std::min(length, _capacity - offset);
+    length = std::min<size_t>(length, usedSpace(length));
+
+    if (length == 0) {
+        return nullptr;
+    }
+
+    _consumer.position += length;
+
+    return _data + offset;
+}
+
+RingBuffer::Status RingBuffer::peekRecord(const uint8_t *&payload,
+                                          size_t &length) {
+    uint32_t tag = 0;
+    return peekRecord(payload, length, tag);
+}
+
+RingBuffer::Status RingBuffer::peekRecord(const uint8_t *&payload,
+                                          size_t &length, uint32_t &tag) {
+    while (true) {
+        const uint64_t used = usedSpace(sizeof(RingBuffer_RecordHeader));
+
+        if (used == 0) {
+            return Empty;
+        }
+
+        /*
+         *  The producer only ever commits whole records
+         */
+        if (used > _capacity || used < sizeof(RingBuffer_RecordHeader)) {
+            return Corrupt;
+        }
+
+        const size_t offset = _consumer.position & (_capacity - 1);
+        const size_t contiguous = _capacity - offset;
+
+        /*
+         *  The producer may not be trusted. Copy the record header out of
+         *  the ring before validating it.
+         */
+        RingBuffer_RecordHeader record;
+        memcpy(&record, _data + offset, sizeof(record));
+
+        if (record.length == RingBuffer_PaddingMarker) {
+            if (contiguous > used) {
+                return Corrupt;
+            }
+
+            _consumer.position += contiguous;
+            continue;
+        }
+
+        const size_t recordSize = RingBuffer_RecordSize(record.length);
+
+        if (recordSize > contiguous || recordSize > used) {
+            return Corrupt;
+        }
+
+        payload = _data + offset + sizeof(RingBuffer_RecordHeader);
+        length = record.length;
+        tag = record.tag;
+
+        _consumer.position += recordSize;
+
+        return Success;
+    }
+}
+
+void RingBuffer::release() {
+    _header->tail.store(_consumer.position, std::memory_order_release);
+}
+
+void RingBuffer::unpeek() {
+    _consumer.position = _header->tail.load(std::memory_order_relaxed);
+}
+
+bool RingBuffer::drained() {
+    release();
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    _consumer.peerPosition = _header->head.load(std::memory_order_acquire);
+
+    return _consumer.peerPosition == _consumer.position;
+}
+
+size_t RingBuffer::read(void *bytes, size_t length) {
+    uint8_t *destination = static_cast<uint8_t *>(bytes);
+
+    size_t read = 0;
+
+    while (read < length) {
+        size_t peeked = length - read;
+        const uint8_t *source = peek(peeked);
+
+        if (source == nullptr) {
+            break;
+        }
+
+        memcpy(destination + read, source, peeked);
+        read += peeked;
+    }
+
+    release();
+
+    return read;
+}
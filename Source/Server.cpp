@@ -23,16 +23,52 @@
 */
 
 #include "Server.h"
+#include "Looper.h"
 #include "Utilities.h"
 
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 using namespace cl;
 
-Server::Server(std::string name)
-    : _name(name), _socketHandle(-1), _listening(false) {
+const int Server::DefaultBacklog = SOMAXCONN;
+
+/*
+ *  How long the listener is not watched for when pending connections can
+ *  neither be accepted nor shed
+ */
+static const std::chrono::milliseconds Server_AcceptPause(10);
+
+static Server::Handle Server_AcceptConnection(Server::Handle handle) {
+#if __APPLE__
+    /*
+     *  There is no accept4. Flags must be set on the new descriptor.
+     */
+    Server::Handle connectionHandle =
+        CL_TEMP_FAILURE_RETRY(::accept(handle, nullptr, nullptr));
+
+    if (connectionHandle != -1) {
+        CL_CHECK(::fcntl(connectionHandle, F_SETFD, FD_CLOEXEC));
+        CL_CHECK(::fcntl(connectionHandle, F_SETFL, O_NONBLOCK));
+    }
+
+    return connectionHandle;
+#else
+    return CL_TEMP_FAILURE_RETRY(
+        ::accept4(handle, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC));
+#endif
+}
+
+static Server::Handle Server_OpenReserveHandle() {
+    return CL_TEMP_FAILURE_RETRY(::open("/dev/null", O_RDONLY | O_CLOEXEC));
+}
+
+Server::Server(std::string name, int backlog)
+    : _name(name), _socketHandle(-1), _reserveHandle(-1),
+      _descriptorsExhausted(false), _listening(false),
+      _channelLooperPool(nullptr) {
     /*
      *  Step 1: Create the socket
      */
@@ -88,9 +124,13 @@ Server::Server(std::string name)
     }
 
     /*
-     *  Step 3: Listen
+     *  Step 3: Listen. The socket is non-blocking so that all pending
+     *  connections can be accepted on each wakeup.
      */
-    result = ::listen(socketHandle, 1);
+    CL_CHECK(::fcntl(socketHandle, F_SETFD, FD_CLOEXEC));
+    CL_CHECK(::fcntl(socketHandle, F_SETFL, O_NONBLOCK));
+
+    result = ::listen(socketHandle, backlog);
 
     if (result == -1) {
         CL_LOG_ERRNO();
@@ -98,6 +138,12 @@ Server::Server(std::string name)
         return;
     }
 
+    /*
+     *  Hold on to a spare descriptor so that connections can still be
+     *  accepted (and shed) once the process runs out of descriptors.
+     */
+    _reserveHandle = Server_OpenReserveHandle();
+
     _listening = true;
     _socketHandle = socketHandle;
 }
@@ -107,21 +153,125 @@ Server::~Server() {
         CL_CHECK(::unlink(_name.c_str()));
         CL_CHECK(::close(_socketHandle));
     }
+
+    if (_reserveHandle != -1) {
+        CL_CHECK(::close(_reserveHandle));
+    }
 }
 
 void Server::onConnectionAvailableForAccept(Handle handle) {
 
     CL_ASSERT(handle == _socketHandle);
 
-    Channel::Handle connectionHandle =
-        ::accept(_socketHandle, nullptr, nullptr);
+    /*
+     *  Accept everything that is pending instead of waking up once per
+     *  connection
+     */
+    while (true) {
+        Channel::Handle connectionHandle = Server_AcceptConnection(handle);
+
+        if (connectionHandle != -1) {
+            _descriptorsExhausted = false;
+            onConnectionAccepted(connectionHandle);
+            continue;
+        }
+
+        switch (errno) {
+            case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+            case EWOULDBLOCK:
+#endif
+                return;
+            case ECONNABORTED:
+            case EPROTO:
+                /*
+                 *  The client went away before it could be accepted
+                 */
+                continue;
+            case EMFILE:
+            case ENFILE:
+                if (shedConnectionOnDescriptorExhaustion()) {
+                    continue;
+                }
+                return;
+            default:
+                CL_LOG_ERRNO();
+                return;
+        }
+    }
+}
 
-    if (connectionHandle == -1) {
+bool Server::shedConnectionOnDescriptorExhaustion() {
+    /*
+     *  The pending connection cannot be accepted and would keep the
+     *  listening socket readable forever. Give up the reserve descriptor to
+     *  accept and immediately close the connection so that the client
+     *  sees it terminated instead of being left in limbo. Exhaustion is
+     *  logged once instead of for every connection shed.
+     */
+    if (!_descriptorsExhausted) {
         CL_LOG_ERRNO();
-        CL_ASSERT(false);
+        _descriptorsExhausted = true;
+    }
+
+    /*
+     *  The reserve could not be reopened if another thread took the
+     *  descriptor freed for it. Try again before giving up.
+     */
+    if (_reserveHandle == -1) {
+        _reserveHandle = Server_OpenReserveHandle();
+    }
+
+    if (_reserveHandle == -1) {
+        pauseAccepting();
+        return false;
+    }
+
+    CL_CHECK(::close(_reserveHandle));
+
+    Handle connectionHandle = Server_AcceptConnection(_socketHandle);
+
+    if (connectionHandle != -1) {
+        CL_CHECK(::close(connectionHandle));
+    }
+
+    _reserveHandle = Server_OpenReserveHandle();
+
+    return connectionHandle != -1;
+}
+
+void Server::pauseAccepting() {
+    /*
+     *  The listener is level triggered and stays readable while the
+     *  connection is pending. Stop watching it for a while instead of
+     *  waking up for it in a loop. Does not affect the source if it is
+     *  removed from the looper in the meantime.
+     */
+    auto source = _clientConnectionsSource;
+    auto looper = Looper::Current();
+
+    const auto flags = source->registrationFlags();
+
+    source->setRegistrationFlags(0);
+
+    if (!looper->updateSource(source)) {
+        source->setRegistrationFlags(flags);
         return;
     }
 
+    std::weak_ptr<LooperSource> weakSource = source;
+
+    looper->postDelayed(
+        [looper, weakSource, flags]() {
+            if (auto source = weakSource.lock()) {
+                source->setRegistrationFlags(flags);
+                looper->updateSource(source);
+            }
+        },
+        Server_AcceptPause);
+}
+
+void Server::onConnectionAccepted(Handle connectionHandle) {
     if (!_channelAvailablilityCallback) {
         /*
          *  If the channel availability handler is not set, the server
@@ -133,7 +283,23 @@ void Server::onConnectionAvailableForAccept(Handle handle) {
         return;
     }
 
-    _channelAvailablilityCallback(std::make_shared<Channel>(connectionHandle));
+    auto channel = std::make_shared<Channel>(connectionHandle);
+
+    if (_channelLooperPool == nullptr) {
+        _channelAvailablilityCallback(channel);
+        return;
+    }
+
+    auto callback = _channelAvailablilityCallback;
+
+    _channelLooperPool->dispatch([channel, callback](Looper *looper) {
+        /*
+         *  Let the callback setup the channel before it can receive
+         *  messages on its new looper
+         */
+        callback(channel);
+        channel->scheduleInLooper(looper);
+    });
 }
 
 std::shared_ptr<LooperSource> Server::clientConnectionsSource() {
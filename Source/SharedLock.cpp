@@ -0,0 +1,155 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "SharedLock.h"
+#include "Utilities.h"
+
+#include <limits>
+
+using namespace cl;
+
+const uint32_t SharedLock::ReaderMask;
+const uint32_t SharedLock::Parked;
+const uint32_t SharedLock::WriterWaiting;
+const uint32_t SharedLock::Writer;
+
+static const size_t SharedLock_SpinCount = 128;
+
+/*
+ *  Marks the word as having waiters and waits for it to change. Returns
+ *  false if the word changed before it could be marked, in which case the
+ *  caller looks at it again right away.
+ */
+bool SharedLock::park(uint32_t &state) const {
+    if ((state & Parked) == 0) {
+        if (!_state.compare_exchange_weak(state, state | Parked,
+                                          std::memory_order_relaxed)) {
+            return false;
+        }
+
+        state |= Parked;
+    }
+
+    Futex::Wait(_state, state, std::chrono::nanoseconds::max(), _scope);
+
+    state = _state.load(std::memory_order_relaxed);
+    return true;
+}
+
+void SharedLock::wakeParked() const {
+    /*
+     *  Everyone is woken since readers may all proceed together. Those that
+     *  cannot mark the word again before waiting.
+     */
+    _state.fetch_and(~Parked, std::memory_order_relaxed);
+
+    Futex::Wake(_state, std::numeric_limits<uint32_t>::max(), _scope);
+}
+
+void SharedLock::lockSharedContended() const {
+    uint32_t state = _state.load(std::memory_order_relaxed);
+    size_t spin = 0;
+
+    while (true) {
+        if ((state & (Writer | WriterWaiting)) == 0) {
+            CL_ASSERT((state & ReaderMask) != ReaderMask);
+
+            if (_state.compare_exchange_weak(state, state + 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+                return;
+            }
+
+            continue;
+        }
+
+        if (spin < SharedLock_SpinCount) {
+            spin++;
+            CL_CPU_PAUSE();
+            state = _state.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        park(state);
+    }
+}
+
+void SharedLock::lock() const {
+    _waitingWriters.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t state = _state.load(std::memory_order_relaxed);
+    size_t spin = 0;
+
+    while (true) {
+        if ((state & (Writer | ReaderMask)) == 0) {
+            if (_state.compare_exchange_weak(state, state | Writer,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+                break;
+            }
+
+            continue;
+        }
+
+        /*
+         *  Keep new readers out while readers drain or another writer
+         *  finishes. The previous writer may have cleared this on unlock
+         *  before it saw this writer.
+         */
+        if ((state & WriterWaiting) == 0) {
+            _state.compare_exchange_weak(state, state | WriterWaiting,
+                                         std::memory_order_relaxed);
+            continue;
+        }
+
+        if (spin < SharedLock_SpinCount) {
+            spin++;
+            CL_CPU_PAUSE();
+            state = _state.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        park(state);
+    }
+
+    _waitingWriters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void SharedLock::unlock() const {
+    /*
+     *  There are no readers while a writer holds the lock. Hand the lock
+     *  straight to waiting writers, if any, by keeping readers out.
+     */
+    const uint32_t waiting =
+        _waitingWriters.load(std::memory_order_relaxed) != 0 ? WriterWaiting
+                                                             : 0;
+
+    const uint32_t previous =
+        _state.exchange(waiting, std::memory_order_release);
+
+    if ((previous & Parked) != 0) {
+        Futex::Wake(_state, std::numeric_limits<uint32_t>::max(), _scope);
+    }
+}
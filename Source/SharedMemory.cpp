@@ -22,6 +22,7 @@
   SOFTWARE.
 */
 
+
 #include "SharedMemory.h"
 #include "Utilities.h"
 
@@ -29,125 +30,141 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <sstream>
 
 using namespace cl;
 
-static const int SharedMemoryTempHandleMaxRetries = 25;
+SharedMemory::SharedMemory(size_t size, Options options)
+    : _ready(false), _writable(false), _address(nullptr), _handle(-1),
+      _size(0) {
 
-static std::string SharedMemory_RandomFileName() {
-    auto random = rand() % RAND_MAX;
+    /*
+     *  Create the handle to shared memory, size it and map it
+     */
+    if (!platformCreate(size, options)) {
+        goto failure;
+    }
 
-    std::stringstream stream;
+    /*
+     *  Jobs done!
+     */
 
-    stream << "/CoreLib_SharedMemory" << random;
+    _ready = true;
 
-    return stream.str();
-}
+    return;
 
-static Handle SharedMemory_CreateBackingIfNecessary(Handle handle) {
+failure:
+    CL_LOG_ERRNO();
 
-    /*
-     *  A valid handle is already present. Nothing to do.
-     */
-    if (handle != -1) {
-        return handle;
+    _ready = false;
+
+    if (_address != nullptr) {
+        CL_CHECK(::munmap(_address, _size));
     }
 
-    Handle newHandle = -1;
+    _size = 0;
+    _address = nullptr;
 
-    auto tempFile = SharedMemory_RandomFileName();
+    if (_handle != -1) {
+        CL_CHECK(::close(_handle));
+    }
 
-    int tries = 0;
+    _handle = -1;
+}
 
-    while (tries++ < SharedMemoryTempHandleMaxRetries) {
+SharedMemory::SharedMemory()
+    : _ready(false), _writable(false), _address(nullptr), _handle(-1),
+      _size(0) {
+}
 
-        newHandle = ::shm_open(tempFile.c_str(),
-                               O_RDWR  | O_CREAT | O_EXCL,
-                               S_IRUSR | S_IWUSR);
+std::unique_ptr<SharedMemory>
+SharedMemory::Map(Handle handle, Seals requiredSeals, Options options) {
+    std::unique_ptr<SharedMemory> memory(new SharedMemory());
 
-        if (newHandle == -1 && errno == EEXIST) {
-            /*
-             *  The current handle already exists (the O_CREAT | O_EXCL
-             *  check is atomic). Try a new file name.
-             */
-            tempFile = SharedMemory_RandomFileName();
-            continue;
-        }
+    struct stat statBuffer = {0};
 
-        break;
-    }
+    Seals seals = 0;
 
-    /*
-     *  We already have a file reference, unlink the
-     *  reference by name.
-     */
-    if (newHandle != -1) {
-        CL_CHECK(::shm_unlink(tempFile.c_str()));
+    if (handle == -1 || ::fstat(handle, &statBuffer) == -1 ||
+        statBuffer.st_size <= 0) {
+        goto failure;
     }
 
-    return newHandle;
-}
+    memory->_handle = handle;
+    memory->_size = statBuffer.st_size;
 
-SharedMemory::SharedMemory(size_t size)
-    : _ready(false), _address(nullptr), _handle(-1), _size(0) {
+    seals = memory->seals();
 
-    /*
-     *  Step 1: Create a handle to shared memory
-     */
-    _handle = SharedMemory_CreateBackingIfNecessary(-1);
+    if (SupportsSealing() && (seals & requiredSeals) != requiredSeals) {
+        CL_LOG("Shared memory region is missing required seals");
+        goto failure;
+    }
 
-    if (_handle == -1) {
+    if (!memory->platformMap((seals & SealWrite) == 0,
+                             options & OptionPrefault)) {
         goto failure;
     }
 
-    /*
-     *  Step 2: Set the size of the shared memory
-     */
+    memory->_ready = true;
 
-    if (CL_TEMP_FAILURE_RETRY(::ftruncate(_handle, size)) == -1) {
-        goto failure;
+    return memory;
+
+failure:
+    CL_LOG_ERRNO();
+
+    memory->_handle = -1;
+    memory->_size = 0;
+
+    if (handle != -1) {
+        CL_CHECK(::close(handle));
     }
 
-    _size = size;
+    return memory;
+}
 
-    /*
-     *  Step 3: Memory map a region with the given handle
-     */
+bool SharedMemory::seal(Seals seals) {
+    if (!_ready) {
+        return false;
+    }
 
-    _address =
-        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _handle, 0);
+    if (!SupportsSealing()) {
+        return true;
+    }
 
-    if (_address == MAP_FAILED) {
-        goto failure;
+    if ((seals & SealWrite) == 0 || !_writable) {
+        return platformAddSeals(seals);
     }
 
     /*
-     *  Jobs done!
+     *  Our own writable mapping would prevent sealing against writes. Swap
+     *  it for a read only one, or back if the seals could not be added.
      */
+    CL_CHECK(::munmap(_address, _size));
+    _address = nullptr;
 
-    _ready = true;
+    const bool sealed = platformAddSeals(seals);
 
-    return;
+    if (!platformMap(!sealed, 0)) {
+        CL_LOG_ERRNO();
 
-failure:
-    CL_LOG_ERRNO();
+        _address = nullptr;
+        _ready = false;
+        _size = 0;
 
-    _ready = false;
+        CL_CHECK(::close(_handle));
+        _handle = -1;
 
-    if (_address != nullptr) {
-        CL_CHECK(::munmap(_address, size));
+        return false;
     }
 
-    _size = 0;
-    _address = nullptr;
+    return sealed;
+}
 
+SharedMemory::Seals SharedMemory::seals() const {
     if (_handle == -1) {
-        CL_CHECK(::close(_handle));
+        return 0;
     }
 
-    _handle = -1;
+    return platformSeals();
 }
 
 void SharedMemory::cleanup() {
@@ -162,6 +179,7 @@ void SharedMemory::cleanup() {
     _size = 0;
     _address = nullptr;
     _ready = false;
+    _writable = false;
 }
 
 SharedMemory::~SharedMemory() {
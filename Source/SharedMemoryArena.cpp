@@ -0,0 +1,433 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "SharedMemoryArena.h"
+#include "AutoLock.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <new>
+
+using namespace cl;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Free lists must be lock free to be shared across processes");
+
+const SharedMemoryArena::Block SharedMemoryArena::InvalidBlock;
+const size_t SharedMemoryArena::DefaultRegionSize = 16 << 20;
+const size_t SharedMemoryArena::DefaultMaxRegionCount;
+const size_t SharedMemoryArena::MaxRegionCount;
+const size_t SharedMemoryArena::MinBlockSize;
+const size_t SharedMemoryArena::SizeClassCount;
+
+static const uint32_t SharedMemoryArena_Magic = 0x434C5341; /* CLSA */
+static const SharedMemory::Seals SharedMemoryArena_Seals =
+    SharedMemory::SealShrink | SharedMemory::SealGrow;
+
+/*
+ *  Blocks are referred to by the index of their region, their size class
+ *  and their offset in the region. Offsets are never zero since every
+ *  region starts with its header, so a zero block is never valid.
+ */
+static const unsigned SharedMemoryArena_IndexShift = 56;
+static const unsigned SharedMemoryArena_SizeClassShift = 48;
+static const uint64_t SharedMemoryArena_OffsetMask =
+    (1ULL << SharedMemoryArena_SizeClassShift) - 1;
+
+/*
+ *  Free list heads pack a tag that changes on every update into the upper
+ *  half, so that a head that was popped and pushed back in the meantime is
+ *  not mistaken for an unchanged one. The lower half is the offset of the
+ *  first free block in units of the minimum block size, zero if the list
+ *  is empty.
+ */
+static const uint64_t SharedMemoryArena_LinkMask = 0xFFFFFFFF;
+
+/*
+ *  The owner bumps the offset of the next unused block. Each free list is
+ *  on its own cache line so that sizes do not contend with each other.
+ */
+struct SharedMemoryArena::RegionHeader {
+    uint32_t magic;
+    uint32_t index;
+    uint64_t size;
+
+    alignas(64) std::atomic<uint64_t> bump;
+
+    struct alignas(64) FreeList {
+        std::atomic<uint64_t> head;
+    };
+
+    FreeList freeLists[SharedMemoryArena::SizeClassCount];
+};
+
+const uint64_t SharedMemoryArena::DataOffset = sizeof(RegionHeader);
+
+static inline SharedMemoryArena::Block
+SharedMemoryArena_Encode(size_t index, size_t sizeClass, uint64_t offset) {
+    return (static_cast<uint64_t>(index) << SharedMemoryArena_IndexShift) |
+           (static_cast<uint64_t>(sizeClass)
+            << SharedMemoryArena_SizeClassShift) |
+           offset;
+}
+
+static inline size_t SharedMemoryArena_BlockSize(size_t sizeClass) {
+    return SharedMemoryArena::MinBlockSize << sizeClass;
+}
+
+bool SharedMemoryArena::IsValidOffset(uint64_t offset, size_t sizeClass,
+                                      size_t regionSize) {
+    return offset >= DataOffset && offset % MinBlockSize == 0 &&
+           offset + SharedMemoryArena_BlockSize(sizeClass) <= regionSize;
+}
+
+/*
+ *  The link to the next free block is kept in the first word of a free
+ *  block
+ */
+static inline std::atomic<uint64_t> &
+SharedMemoryArena_NextLink(uint8_t *base, uint64_t offset) {
+    return *reinterpret_cast<std::atomic<uint64_t> *>(base + offset);
+}
+
+size_t SharedMemoryArena::MaxBlockSize() {
+    return SharedMemoryArena_BlockSize(SizeClassCount - 1);
+}
+
+SharedMemoryArena::SharedMemoryArena(bool owner, size_t regionSize,
+                                     size_t maxRegionCount)
+    : _owner(owner), _regionSize(regionSize),
+      _maxRegionCount(maxRegionCount), _regionCount(0),
+      _regionsLock("SharedMemoryArena.regions") {
+    for (auto &region : _regions) {
+        region.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+SharedMemoryArena::~SharedMemoryArena() {
+}
+
+std::unique_ptr<SharedMemoryArena>
+SharedMemoryArena::Create(size_t regionSize, size_t maxRegionCount) {
+    /*
+     *  Every region must at least fit its header and one largest block
+     */
+    const size_t maxBlockSize = MaxBlockSize();
+
+    regionSize = std::max(regionSize, 2 * maxBlockSize);
+    regionSize = (regionSize + maxBlockSize - 1) & ~(maxBlockSize - 1);
+
+    maxRegionCount = std::max<size_t>(
+        1, std::min<size_t>(maxRegionCount, MaxRegionCount));
+
+    std::unique_ptr<SharedMemoryArena> arena(
+        new SharedMemoryArena(true, regionSize, maxRegionCount));
+
+    if (!arena->createRegion(0)) {
+        return nullptr;
+    }
+
+    return arena;
+}
+
+std::unique_ptr<SharedMemoryArena> SharedMemoryArena::Attach() {
+    return std::unique_ptr<SharedMemoryArena>(
+        new SharedMemoryArena(false, 0, MaxRegionCount));
+}
+
+Handle SharedMemoryArena::regionHandle(size_t index) const {
+    if (index >= MaxRegionCount) {
+        return -1;
+    }
+
+    Region *region = _regions[index].load(std::memory_order_acquire);
+
+    return region == nullptr ? -1 : region->memory->handle();
+}
+
+bool SharedMemoryArena::addRegion(std::unique_ptr<Region> region,
+                                  size_t index) {
+    if (_regions[index].load(std::memory_order_relaxed) != nullptr) {
+        return false;
+    }
+
+    _regions[index].store(region.get(), std::memory_order_release);
+    _ownedRegions.push_back(std::move(region));
+
+    if (_regionCount.load(std::memory_order_relaxed) <= index) {
+        _regionCount.store(index + 1, std::memory_order_release);
+    }
+
+    return true;
+}
+
+bool SharedMemoryArena::createRegion(size_t index) {
+    AutoLock lock(_regionsLock);
+
+    /*
+     *  Another thread got here first
+     */
+    if (_regionCount.load(std::memory_order_relaxed) != index) {
+        return true;
+    }
+
+    if (index >= _maxRegionCount) {
+        return false;
+    }
+
+    auto memory = Utils::make_unique<SharedMemory>(_regionSize);
+
+    if (!memory->isReady() || !memory->seal(SharedMemoryArena_Seals)) {
+        return false;
+    }
+
+    /*
+     *  The region is zero filled, which leaves every free list empty
+     */
+    RegionHeader *header = new (memory->address()) RegionHeader();
+
+    header->magic = SharedMemoryArena_Magic;
+    header->index = static_cast<uint32_t>(index);
+    header->size = _regionSize;
+    header->bump.store(DataOffset,
+                       std::memory_order_relaxed);
+
+    for (auto &freeList : header->freeLists) {
+        freeList.head.store(0, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<Region> region(new Region());
+    region->memory = std::move(memory);
+    region->header = header;
+
+    return addRegion(std::move(region), index);
+}
+
+bool SharedMemoryArena::mapRegion(Handle handle) {
+    auto memory = SharedMemory::Map(handle, SharedMemoryArena_Seals);
+
+    if (!memory->isReady() || memory->size() <= DataOffset) {
+        return false;
+    }
+
+    RegionHeader *header = static_cast<RegionHeader *>(memory->address());
+
+    if (header->magic != SharedMemoryArena_Magic ||
+        header->size != memory->size() || header->index >= MaxRegionCount) {
+        CL_LOG("Peer provided an invalid shared memory arena region");
+        return false;
+    }
+
+    std::unique_ptr<Region> region(new Region());
+    region->memory = std::move(memory);
+    region->header = header;
+
+    AutoLock lock(_regionsLock);
+
+    return addRegion(std::move(region), header->index);
+}
+
+SharedMemoryArena::Region *
+SharedMemoryArena::region(Block block, size_t &sizeClass,
+                          uint64_t &offset) const {
+    const size_t index = block >> SharedMemoryArena_IndexShift;
+
+    sizeClass = (block >> SharedMemoryArena_SizeClassShift) & 0xFF;
+    offset = block & SharedMemoryArena_OffsetMask;
+
+    if (index >= MaxRegionCount || sizeClass >= SizeClassCount) {
+        return nullptr;
+    }
+
+    Region *region = _regions[index].load(std::memory_order_acquire);
+
+    if (region == nullptr ||
+        !IsValidOffset(offset, sizeClass, region->memory->size())) {
+        return nullptr;
+    }
+
+    return region;
+}
+
+SharedMemoryArena::Block SharedMemoryArena::pop(Region &region, size_t index,
+                                                size_t sizeClass) {
+    uint8_t *base = static_cast<uint8_t *>(region.memory->address());
+    auto &head = region.header->freeLists[sizeClass].head;
+
+    uint64_t current = head.load(std::memory_order_acquire);
+
+    while (true) {
+        const uint64_t offset =
+            (current & SharedMemoryArena_LinkMask) * MinBlockSize;
+
+        if (offset == 0) {
+            return InvalidBlock;
+        }
+
+        /*
+         *  Peers may push anything. Leave a list with a bad link alone
+         *  rather than hand out memory outside the region.
+         */
+        if (!IsValidOffset(offset, sizeClass, region.memory->size())) {
+            CL_LOG("Shared memory arena free list is corrupt");
+            return InvalidBlock;
+        }
+
+        /*
+         *  The block may be popped and reused by someone else while the
+         *  link is read. The link is then garbage, but the tag makes the
+         *  exchange below fail.
+         */
+        const uint64_t next =
+            SharedMemoryArena_NextLink(base, offset)
+                .load(std::memory_order_relaxed) &
+            SharedMemoryArena_LinkMask;
+
+        const uint64_t replacement = ((current >> 32) + 1) << 32 | next;
+
+        if (head.compare_exchange_weak(current, replacement,
+                                       std::memory_order_acquire,
+                                       std::memory_order_acquire)) {
+            return SharedMemoryArena_Encode(index, sizeClass, offset);
+        }
+    }
+}
+
+SharedMemoryArena::Block SharedMemoryArena::bump(Region &region, size_t index,
+                                                 size_t sizeClass) {
+    const size_t blockSize = SharedMemoryArena_BlockSize(sizeClass);
+    const size_t regionSize = region.memory->size();
+
+    uint64_t offset = region.header->bump.load(std::memory_order_relaxed);
+
+    do {
+        if (offset + blockSize > regionSize) {
+            return InvalidBlock;
+        }
+    } while (!region.header->bump.compare_exchange_weak(
+        offset, offset + blockSize, std::memory_order_relaxed));
+
+    return SharedMemoryArena_Encode(index, sizeClass, offset);
+}
+
+SharedMemoryArena::Block SharedMemoryArena::allocate(size_t size) {
+    if (!_owner || size > MaxBlockSize()) {
+        return InvalidBlock;
+    }
+
+    size_t sizeClass = 0;
+
+    while (SharedMemoryArena_BlockSize(sizeClass) < size) {
+        sizeClass++;
+    }
+
+    /*
+     *  Reuse freed blocks first. There are only a few regions.
+     */
+    size_t count = regionCount();
+
+    for (size_t index = 0; index < count; index++) {
+        Region *region = _regions[index].load(std::memory_order_acquire);
+
+        Block block = pop(*region, index, sizeClass);
+
+        if (block != InvalidBlock) {
+            return block;
+        }
+    }
+
+    /*
+     *  Then carve a new block out of the newest region, adding a region
+     *  once it is used up
+     */
+    while (true) {
+        const size_t index = count - 1;
+
+        Block block = bump(*_regions[index].load(std::memory_order_acquire),
+                           index, sizeClass);
+
+        if (block != InvalidBlock) {
+            return block;
+        }
+
+        if (!createRegion(count)) {
+            return InvalidBlock;
+        }
+
+        count = regionCount();
+    }
+}
+
+void SharedMemoryArena::free(Block block) {
+    size_t sizeClass = 0;
+    uint64_t offset = 0;
+
+    Region *region = this->region(block, sizeClass, offset);
+
+    if (region == nullptr) {
+        return;
+    }
+
+    uint8_t *base = static_cast<uint8_t *>(region->memory->address());
+    auto &head = region->header->freeLists[sizeClass].head;
+    auto &link = SharedMemoryArena_NextLink(base, offset);
+
+    const uint64_t blockLink = offset / MinBlockSize;
+
+    uint64_t current = head.load(std::memory_order_relaxed);
+    uint64_t replacement = 0;
+
+    do {
+        link.store(current & SharedMemoryArena_LinkMask,
+                   std::memory_order_relaxed);
+        replacement = ((current >> 32) + 1) << 32 | blockLink;
+    } while (!head.compare_exchange_weak(current, replacement,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+}
+
+uint8_t *SharedMemoryArena::address(Block block) const {
+    size_t sizeClass = 0;
+    uint64_t offset = 0;
+
+    Region *region = this->region(block, sizeClass, offset);
+
+    if (region == nullptr) {
+        return nullptr;
+    }
+
+    return static_cast<uint8_t *>(region->memory->address()) + offset;
+}
+
+size_t SharedMemoryArena::size(Block block) const {
+    size_t sizeClass = 0;
+    uint64_t offset = 0;
+
+    if (region(block, sizeClass, offset) == nullptr) {
+        return 0;
+    }
+
+    return SharedMemoryArena_BlockSize(sizeClass);
+}
@@ -0,0 +1,259 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "SharedMemoryRing.h"
+#include "Utilities.h"
+
+#include <atomic>
+#include <new>
+#include <string.h>
+#include <unistd.h>
+
+using namespace cl;
+
+const size_t SharedMemoryRing::DefaultCapacity = 1 << 20;
+
+static const uint32_t SharedMemoryRing_Magic = 0x434C5352; /* CLSR */
+static const SharedMemory::Seals SharedMemoryRing_Seals =
+    SharedMemory::SealShrink | SharedMemory::SealGrow;
+
+/*
+ *  Precedes the ring in the region. The consumer sets the parked flag
+ *  before it waits on its doorbell and whoever clears it first owns the
+ *  wakeup.
+ */
+struct SharedMemoryRing::Header {
+    uint32_t magic;
+
+    alignas(64) std::atomic<uint32_t> consumerParked;
+};
+
+SharedMemoryRing::SharedMemoryRing(std::unique_ptr<SharedMemory> memory,
+                                   std::unique_ptr<RingBuffer> ring)
+    : _memory(std::move(memory)),
+      _header(static_cast<Header *>(_memory->address())),
+      _ring(std::move(ring)), _source(nullptr), _recordHandler(nullptr),
+      _readBudget(DefaultReadBudget), _corrupt(false), _doorbell(-1),
+      _ringDoorbell(nullptr) {
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    if (_doorbell != -1) {
+        CL_CHECK(::close(_doorbell));
+    }
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Create(size_t capacity) {
+    auto memory = Utils::make_unique<SharedMemory>(
+        sizeof(Header) + RingBuffer::RegionSize(capacity),
+        SharedMemory::OptionPrefault);
+
+    /*
+     *  The producer must be able to rely on the region not being truncated
+     *  under it
+     */
+    if (!memory->isReady() || !memory->seal(SharedMemoryRing_Seals)) {
+        return nullptr;
+    }
+
+    uint8_t *address = static_cast<uint8_t *>(memory->address());
+
+    /*
+     *  The consumer starts out parked so that the first commit rings the
+     *  doorbell
+     */
+    Header *header = new (address) Header();
+
+    header->magic = SharedMemoryRing_Magic;
+    header->consumerParked.store(1, std::memory_order_relaxed);
+
+    auto ring = RingBuffer::Create(address + sizeof(Header),
+                                   memory->size() - sizeof(Header));
+
+    if (ring == nullptr) {
+        return nullptr;
+    }
+
+    std::unique_ptr<SharedMemoryRing> sharedRing(
+        new SharedMemoryRing(std::move(memory), std::move(ring)));
+
+    SharedMemoryRing *consumer = sharedRing.get();
+
+    consumer->_source = LooperSource::AsTrivial();
+    consumer->_source->handles();
+    consumer->_source->setWakeFunction([consumer]() {
+        consumer->readRecords();
+    });
+
+    return sharedRing;
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Open(Handle memoryHandle,
+                                                         Handle doorbellHandle) {
+    auto memory = SharedMemory::Map(memoryHandle, SharedMemoryRing_Seals);
+
+    if (!memory->isReady() || memory->size() <= sizeof(Header)) {
+        CL_CHECK(::close(doorbellHandle));
+        return nullptr;
+    }
+
+    uint8_t *address = static_cast<uint8_t *>(memory->address());
+
+    const Header *header = reinterpret_cast<const Header *>(address);
+
+    std::unique_ptr<RingBuffer> ring;
+
+    if (header->magic == SharedMemoryRing_Magic) {
+        ring = RingBuffer::Attach(address + sizeof(Header),
+                                  memory->size() - sizeof(Header));
+    }
+
+    if (ring == nullptr) {
+        CL_CHECK(::close(doorbellHandle));
+        return nullptr;
+    }
+
+    std::unique_ptr<SharedMemoryRing> producer(
+        new SharedMemoryRing(std::move(memory), std::move(ring)));
+
+    /*
+     *  Only the writer of the doorbell is needed. Its handles are never
+     *  allocated.
+     */
+    producer->_doorbell = doorbellHandle;
+    producer->_ringDoorbell = LooperSource::AsTrivial()->writer();
+
+    return producer;
+}
+
+Handle SharedMemoryRing::doorbellHandle() const {
+    return _source ? _source->writeHandle() : _doorbell;
+}
+
+uint8_t *SharedMemoryRing::reserve(size_t length) {
+    return _ring->reserveRecord(length);
+}
+
+void SharedMemoryRing::commit() {
+    _ring->commit();
+
+    /*
+     *  Publishing records and then checking the flag pairs with the
+     *  consumer setting the flag and then checking for records. At least
+     *  one of the two sides is guaranteed to see the update of the other.
+     */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (_header->consumerParked.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    if (_header->consumerParked.exchange(0, std::memory_order_seq_cst) != 0) {
+        _ringDoorbell(_doorbell);
+    }
+}
+
+bool SharedMemoryRing::write(const uint8_t *payload, size_t length) {
+    uint8_t *reserved = reserve(length);
+
+    if (reserved == nullptr) {
+        /*
+         *  A failed reservation may have skipped the end of the ring
+         */
+        commit();
+        return false;
+    }
+
+    if (length > 0) {
+        memcpy(reserved, payload, length);
+    }
+
+    commit();
+
+    return true;
+}
+
+void SharedMemoryRing::readRecords() {
+    if (_corrupt) {
+        return;
+    }
+
+    bool parked = false;
+    size_t count = 0;
+
+    while (count < _readBudget) {
+        const uint8_t *payload = nullptr;
+        size_t length = 0;
+
+        const auto status = _ring->peekRecord(payload, length);
+
+        if (status == RingBuffer::Corrupt) {
+            CL_LOG("Producer corrupted the shared memory ring");
+            _corrupt = true;
+            return;
+        }
+
+        if (status == RingBuffer::Empty) {
+            _ring->release();
+
+            /*
+             *  Park and look for records one last time in case the
+             *  producer committed them before it could see the flag
+             */
+            if (parked) {
+                return;
+            }
+
+            _header->consumerParked.store(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            parked = true;
+            continue;
+        }
+
+        /*
+         *  Records raced in while parking. If the producer did not notice,
+         *  take the flag back. Otherwise the doorbell rings needlessly once.
+         */
+        if (parked) {
+            _header->consumerParked.store(0, std::memory_order_relaxed);
+            parked = false;
+        }
+
+        if (_recordHandler) {
+            _recordHandler(payload, length);
+        }
+
+        count++;
+    }
+
+    _ring->release();
+
+    /*
+     *  The budget ran out. Ring the doorbell so that the looper comes back
+     *  for the rest after other sources had their turn.
+     */
+    _source->writer()(_source->writeHandle());
+}
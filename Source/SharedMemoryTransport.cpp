@@ -0,0 +1,154 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "SharedMemoryTransport.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <string.h>
+
+using namespace cl;
+
+const size_t SharedMemoryTransport::DefaultCapacity = 1 << 20;
+
+static const size_t SharedMemoryTransport_MinCapacity = 4096;
+static const SharedMemory::Seals SharedMemoryTransport_Seals =
+    SharedMemory::SealShrink | SharedMemory::SealGrow;
+
+SharedMemoryTransport::SharedMemoryTransport(
+    std::unique_ptr<SharedMemory> memory, std::unique_ptr<RingBuffer> ring)
+    : _memory(std::move(memory)), _ring(std::move(ring)) {
+}
+
+SharedMemoryTransport::~SharedMemoryTransport() {
+}
+
+std::unique_ptr<SharedMemoryTransport>
+SharedMemoryTransport::Create(size_t capacity) {
+    auto memory = Utils::make_unique<SharedMemory>(
+        RingBuffer::RegionSize(
+            std::max(capacity, SharedMemoryTransport_MinCapacity)),
+        SharedMemory::OptionPrefault);
+
+    /*
+     *  The consumer must be able to rely on the region not being truncated
+     *  under it
+     */
+    if (!memory->isReady() || !memory->seal(SharedMemoryTransport_Seals)) {
+        return nullptr;
+    }
+
+    auto ring = RingBuffer::Create(memory->address(), memory->size());
+
+    if (ring == nullptr) {
+        return nullptr;
+    }
+
+    return std::unique_ptr<SharedMemoryTransport>(
+        new SharedMemoryTransport(std::move(memory), std::move(ring)));
+}
+
+std::unique_ptr<SharedMemoryTransport>
+SharedMemoryTransport::Open(Handle handle) {
+    auto memory = SharedMemory::Map(handle, SharedMemoryTransport_Seals);
+
+    if (!memory->isReady()) {
+        return nullptr;
+    }
+
+    auto ring = RingBuffer::Attach(memory->address(), memory->size());
+
+    if (ring == nullptr) {
+        return nullptr;
+    }
+
+    return std::unique_ptr<SharedMemoryTransport>(
+        new SharedMemoryTransport(std::move(memory), std::move(ring)));
+}
+
+size_t SharedMemoryTransport::maxRecordLength() const {
+    return _ring->maxRecordLength();
+}
+
+SharedMemoryTransport::Status
+SharedMemoryTransport::write(const uint8_t *payload, size_t length,
+                             uint32_t attachmentCount, bool &notify) {
+    notify = false;
+
+    if (length > maxRecordLength()) {
+        return RecordTooLarge;
+    }
+
+    uint8_t *record = _ring->reserveRecord(length, attachmentCount);
+
+    if (record == nullptr) {
+        /*
+         *  A failed reservation may still have skipped the end of the ring.
+         *  It is committed so that the consumer can make room past it.
+         */
+        notify = _ring->commitAndCheckIdle();
+        return InsufficientSpace;
+    }
+
+    if (length > 0) {
+        memcpy(record, payload, length);
+    }
+
+    notify = _ring->commitAndCheckIdle();
+
+    return Success;
+}
+
+bool SharedMemoryTransport::read(RecordHandler handler) {
+    while (true) {
+        const uint8_t *payload = nullptr;
+        size_t length = 0;
+        uint32_t attachmentCount = 0;
+
+        auto status = _ring->peekRecord(payload, length, attachmentCount);
+
+        if (status == RingBuffer::Corrupt) {
+            return false;
+        }
+
+        if (status == RingBuffer::Empty) {
+            if (_ring->drained()) {
+                return true;
+            }
+
+            continue;
+        }
+
+        if (!handler(payload, length, attachmentCount)) {
+            _ring->unpeek();
+            return true;
+        }
+
+        /*
+         *  Release space as soon as each record is consumed so that a
+         *  producer waiting on a large record may proceed
+         */
+        _ring->release();
+    }
+}
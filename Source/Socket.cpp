@@ -32,6 +32,8 @@
 #define _DARWIN_C_SOURCE
 #endif
 
+#include <algorithm>
+#include <limits>
 #include <mutex>
 
 #include <fcntl.h>
@@ -48,11 +50,17 @@
 using namespace cl;
 
 const size_t Socket::MaxBufferSize = 4096;
+const size_t Socket::MaxBatchCount = 16;
 const size_t Socket::MaxControlBufferItemCount = 8;
 const size_t Socket::ControlBufferItemSize = sizeof(int);
 const size_t Socket::MaxControlBufferSize =
     CMSG_SPACE(ControlBufferItemSize * MaxControlBufferItemCount);
 
+/*
+ *  Enough for a batch being dispatched while the next one is read
+ */
+static const size_t Socket_MaxPooledMessageCount = 2 * Socket::MaxBatchCount;
+
 std::unique_ptr<Socket> Socket::Create(Socket::Handle handle) {
     return cl::Utils::make_unique<Socket>(handle);
 }
@@ -69,7 +77,7 @@ Socket::Pair Socket::CreatePair() {
                 Socket::Create(socketHandles[1]));
 }
 
-Socket::Socket(Handle handle) {
+Socket::Socket(Handle handle) : _lock("Socket"), _boundToThread(false) {
 
     /*
      *  Create a socket if one is not provided
@@ -84,9 +92,10 @@ Socket::Socket(Handle handle) {
 
     /*
      *  Limit the socket send and receive buffer sizes since we dont need large
-     *  buffers for channels
+     *  buffers for channels. They still need to be able to hold a full batch
+     *  of records though.
      */
-    const int size = MaxBufferSize;
+    const int size = MaxBufferSize * MaxBatchCount;
 
     CL_CHECK(
         ::setsockopt(handle, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)));
@@ -104,14 +113,39 @@ Socket::Socket(Handle handle) {
     CL_CHECK(::fcntl(handle, F_SETFL, O_NONBLOCK));
 
     /*
-     *  Setup the channel buffer
+     *  Setup the control buffer. Payloads are read directly into pooled
+     *  messages.
      */
-    _buffer = static_cast<uint8_t *>(malloc(MaxBufferSize));
-    _controlBuffer = static_cast<uint8_t *>(malloc(MaxControlBufferSize));
+    _messagePool.reserve(Socket_MaxPooledMessageCount);
+
+    _controlBuffer =
+        static_cast<uint8_t *>(malloc(MaxControlBufferSize * MaxBatchCount));
 
     _handle = handle;
 };
 
+void Socket::bindToCurrentThread() {
+    _boundThread = pthread_self();
+    _boundToThread.store(true, std::memory_order_release);
+}
+
+void Socket::unbindFromThread() {
+    CL_ASSERT(!isBoundToThread() || isBoundToCurrentThread());
+
+    _boundToThread.store(false, std::memory_order_release);
+}
+
+const Lock *Socket::accessLock() const {
+    if (!isBoundToThread()) {
+        return &_lock;
+    }
+
+    CL_ASSERT(pthread_equal(_boundThread, pthread_self()) &&
+              "Socket used off the thread it is bound to");
+
+    return nullptr;
+}
+
 bool Socket::connect(std::string endpoint) {
     /*
      *  Connect
@@ -148,169 +182,361 @@ bool Socket::close() {
 Socket::~Socket() {
     close();
 
-    free(_buffer);
     free(_controlBuffer);
 }
 
 Socket::ReadResult Socket::ReadMessages() {
-    AutoLock lock(_lock);
+    Messages messages;
+
+    Status status =
+        ReadMessages(messages, std::numeric_limits<size_t>::max());
+
+    return ReadResult(status, std::move(messages));
+}
+
+std::unique_ptr<Message> Socket::acquireMessage() {
+    if (_messagePool.size() > 0) {
+        auto message = std::move(_messagePool.back());
+        _messagePool.pop_back();
+        return message;
+    }
 
-    struct iovec vec[1] = {{0}};
+    auto message = cl::Utils::make_unique<Message>(MaxBufferSize);
+    message->_attachments.reserve(MaxControlBufferItemCount);
+
+    return message;
+}
 
-    vec[0].iov_base = _buffer;
-    vec[0].iov_len = MaxBufferSize;
+void Socket::RecycleMessages(Messages &messages) {
+    OptionalAutoLock lock(accessLock());
 
-    std::vector<std::unique_ptr<Message>> messages;
+    for (auto &message : messages) {
+        if (_messagePool.size() == Socket_MaxPooledMessageCount) {
+            break;
+        }
+
+        /*
+         *  Only messages read from a socket have buffers large enough to
+         *  read any record into
+         */
+        if (!message->_ownsBuffer || message->_bufferLength < MaxBufferSize) {
+            continue;
+        }
+
+        message->reset();
+        _messagePool.push_back(std::move(message));
+    }
+
+    messages.clear();
+}
+
+void Socket::relinquishMessages(std::unique_ptr<Message> *messages,
+                                size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (messages[i] &&
+            _messagePool.size() < Socket_MaxPooledMessageCount) {
+            _messagePool.push_back(std::move(messages[i]));
+        }
+    }
+}
+
+Socket::Status Socket::ReadMessages(Messages &messages, size_t maxCount) {
+    OptionalAutoLock lock(accessLock());
+
+    /*
+     *  Messages are taken from the pool for the entire batch up front. The
+     *  ones that don't get used are returned at the end.
+     */
+    std::unique_ptr<Message> batch[MaxBatchCount];
 
-    while (true) {
+    Status status = Status::Success;
+    size_t readCount = 0;
 
-        struct msghdr messageHeader = {
+    while (status == Status::Success && readCount < maxCount) {
+        const size_t batchCount = std::min(maxCount - readCount, MaxBatchCount);
+
+        size_t received = 0;
+        status = readRecords(batch, batchCount, received);
+
+        for (size_t i = 0; i < received; i++) {
+            messages.push_back(std::move(batch[i]));
+        }
+
+        readCount += received;
+
+        if (received < batchCount) {
+            break;
+        }
+    }
+
+    relinquishMessages(batch, MaxBatchCount);
+
+    return status;
+}
+
+Socket::Status Socket::ReadMessages(const MessageHandler &handler,
+                                    size_t maxCount, size_t &readCount) {
+    std::unique_ptr<Message> batch[MaxBatchCount];
+
+    Status status = Status::Success;
+    readCount = 0;
+
+    while (status == Status::Success && readCount < maxCount) {
+        const size_t batchCount = std::min(maxCount - readCount, MaxBatchCount);
+
+        size_t received = 0;
+
+        {
+            OptionalAutoLock lock(accessLock());
+            status = readRecords(batch, batchCount, received);
+        }
+
+        /*
+         *  The lock is not held while the handler runs since it may well
+         *  write to this socket. The same messages are reused for the next
+         *  batch.
+         */
+        for (size_t i = 0; i < received; i++) {
+            handler(*batch[i]);
+            batch[i]->reset();
+        }
+
+        readCount += received;
+
+        if (received < batchCount) {
+            break;
+        }
+    }
+
+    OptionalAutoLock lock(accessLock());
+    relinquishMessages(batch, MaxBatchCount);
+
+    return status;
+}
+
+Socket::Status Socket::readRecords(std::unique_ptr<Message> *batch,
+                                   size_t batchCount, size_t &received) {
+    struct iovec vecs[MaxBatchCount];
+    struct msghdr headers[MaxBatchCount];
+    size_t lengths[MaxBatchCount];
+
+    CL_ASSERT(batchCount <= MaxBatchCount);
+
+    received = 0;
+
+    for (size_t i = 0; i < batchCount; i++) {
+        if (!batch[i]) {
+            batch[i] = acquireMessage();
+        }
+
+        vecs[i].iov_base = batch[i]->_buffer;
+        vecs[i].iov_len = MaxBufferSize;
+
+        headers[i] = {
             .msg_name = nullptr,
             .msg_namelen = 0,
-            .msg_iov = vec,
-            .msg_iovlen = sizeof(vec) / sizeof(struct iovec),
-            .msg_control = _controlBuffer,
+            .msg_iov = &vecs[i],
+            .msg_iovlen = 1,
+            .msg_control = _controlBuffer + i * MaxControlBufferSize,
             .msg_controllen = static_cast<socklen_t>(MaxControlBufferSize),
             .msg_flags = 0,
         };
+    }
+
+    int count = platformReceiveRecords(_handle, headers, lengths, batchCount);
 
-        int received =
-            CL_TEMP_FAILURE_RETRY(::recvmsg(_handle, &messageHeader, 0));
+    if (count == -1) {
+        /*
+         *  All pending messages have been read. poll for more
+         *  in subsequent calls. We are finally done!
+         */
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            /*
+             *  Return as a successful read
+             */
+            return Status::Success;
+        }
 
-        if (received > 0) {
+        return Status::TemporaryFailure;
+    }
 
-            auto message =
-                cl::Utils::make_unique<Message>(_buffer, received);
+    for (int i = 0; i < count; i++) {
+        struct msghdr &messageHeader = headers[i];
 
+        /*
+         *  A message with no payload but with attachments is received as
+         *  a zero length record. Only the absence of control data indicates
+         *  an orderly shutdown.
+         */
+        if (lengths[i] == 0 && messageHeader.msg_controllen == 0) {
             /*
-             *  Check if the message contains descriptors.
-             *  Read all descriptors in one go
+             *  if no messages are available to be received and the peer
+             *  has performed an orderly shutdown, recvmsg() returns 0
              */
-            if (messageHeader.msg_controllen != 0) {
-                struct cmsghdr *cmsgh = nullptr;
+            return Status::PermanentFailure;
+        }
+
+        Message &message = *batch[i];
+
+        message._dataLength = lengths[i];
+
+        /*
+         *  Check if the message contains descriptors.
+         *  Read all descriptors in one go
+         */
+        if (messageHeader.msg_controllen != 0) {
+            for (struct cmsghdr *cmsgh = CMSG_FIRSTHDR(&messageHeader);
+                 cmsgh != nullptr;
+                 cmsgh = CMSG_NXTHDR(&messageHeader, cmsgh)) {
+                CL_ASSERT(cmsgh->cmsg_level == SOL_SOCKET);
+                CL_ASSERT(cmsgh->cmsg_type == SCM_RIGHTS);
 
-                while ((cmsgh = CMSG_NXTHDR(&messageHeader, cmsgh)) !=
-                       nullptr) {
-                    CL_ASSERT(cmsgh->cmsg_level == SOL_SOCKET);
-                    CL_ASSERT(cmsgh->cmsg_type == SCM_RIGHTS);
-                    CL_ASSERT(cmsgh->cmsg_len ==
-                                  CMSG_LEN(ControlBufferItemSize));
+                /*
+                 *  All descriptors of a message are sent in a single
+                 *  control message
+                 */
+                const size_t descriptorCount =
+                    (cmsgh->cmsg_len - CMSG_LEN(0)) / ControlBufferItemSize;
 
+                for (size_t j = 0; j < descriptorCount; j++) {
                     int descriptor = -1;
-                    memcpy(&descriptor, CMSG_DATA(cmsgh),
+                    memcpy(&descriptor,
+                           CMSG_DATA(cmsgh) + j * ControlBufferItemSize,
                            ControlBufferItemSize);
 
                     CL_ASSERT(descriptor != -1);
 
                     Attachment attachment(descriptor);
-                    message->addAttachment(attachment);
+                    message.addAttachment(attachment);
                 }
             }
+        }
 
-            /*
-             *  Since we dont handle partial writes of the control messages,
-             *  assert that the same was not truncated.
-             */
-            CL_ASSERT((messageHeader.msg_flags & MSG_CTRUNC) == 0);
-
-            /*
-             *  Finally! We have the message and possible attachments. Try for
-             * more.
-             */
-            messages.push_back(std::move(message));
+        /*
+         *  Since we dont handle partial writes of the control messages,
+         *  assert that the same was not truncated.
+         */
+        CL_ASSERT((messageHeader.msg_flags & MSG_CTRUNC) == 0);
 
-            continue;
-        }
+        /*
+         *  Finally! We have the message and possible attachments.
+         */
+        received++;
+    }
 
-        if (received == -1) {
-            /*
-             *  All pending messages have been read. poll for more
-             *  in subsequent calls. We are finally done!
-             */
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                /*
-                 *  Return as a successful read
-                 */
-                break;
-            }
+    return Status::Success;
+}
 
-            return ReadResult(Status::TemporaryFailure, std::move(messages));
-        }
+Socket::Status Socket::WriteMessage(Message &message, const uint8_t *prefix,
+                                    size_t prefixLength) {
+    Message *messages[1] = {&message};
+    size_t written = 0;
+    return writeRecords(messages, 1, prefix, prefixLength, true, written);
+}
 
-        if (received == 0) {
-            /*
-             *  if no messages are available to be received and the peer
-             *  has performed an orderly shutdown, recvmsg() returns 0
-             */
-            return ReadResult(Status::PermanentFailure, std::move(messages));
-        }
-    }
+Socket::Status Socket::WriteMessages(const std::vector<Message *> &messages,
+                                     const uint8_t *prefix,
+                                     size_t prefixLength) {
+    size_t written = 0;
+    return writeRecords(messages.data(), messages.size(), prefix,
+                        prefixLength, true, written);
+}
 
-    return ReadResult(Status::Success, std::move(messages));
+Socket::Status Socket::TryWriteMessages(Message *const *messages,
+                                        size_t count, size_t &written,
+                                        const uint8_t *prefix,
+                                        size_t prefixLength) {
+    return writeRecords(messages, count, prefix, prefixLength, false,
+                        written);
 }
 
-Socket::Status Socket::WriteMessage(Message &message) {
-    AutoLock lock(_lock);
+Socket::Status Socket::writeRecords(Message *const *messages, size_t count,
+                                    const uint8_t *prefix,
+                                    size_t prefixLength, bool wait,
+                                    size_t &written) {
+    OptionalAutoLock lock(accessLock());
 
-    if (message.size() > MaxBufferSize) {
-        return Status::TemporaryFailure;
-    }
+    struct iovec vecs[MaxBatchCount][2];
+    struct msghdr headers[MaxBatchCount];
+    size_t lengths[MaxBatchCount];
 
-    struct iovec vec[1] = {{0}};
+    /*
+     *  The control buffers must outlive the send calls below, so they cannot
+     *  be scoped to the loop that fills them in.
+     */
+    char controlBuffers[MaxBatchCount][MaxControlBufferSize];
 
-    vec[0].iov_base = (void *)message.data();
-    vec[0].iov_len = message.size();
+    written = 0;
 
-    struct msghdr messageHeader = {
-        .msg_name = nullptr,
-        .msg_namelen = 0,
-        .msg_iov = vec,
-        .msg_iovlen = sizeof(vec) / sizeof(struct iovec),
-        .msg_control = nullptr,
-        .msg_controllen = 0,
-        .msg_flags = 0,
-    };
+    while (written < count) {
+        const size_t batchCount = std::min(count - written, MaxBatchCount);
 
-    const auto range = message.attachmentRange();
+        for (size_t i = 0; i < batchCount; i++) {
+            Message &message = *messages[written + i];
 
-    const size_t descriptorCount = range.second - range.first;
+            lengths[i] = prefixLength + message.size();
 
-    if (descriptorCount > 0) {
+            if (lengths[i] > MaxBufferSize) {
+                return Status::TemporaryFailure;
+            }
 
-        /*
-         *  Create an array of file descriptors
-         */
+            vecs[i][0].iov_base = (void *)prefix;
+            vecs[i][0].iov_len = prefixLength;
 
-        int descriptors[descriptorCount];
+            vecs[i][1].iov_base = (void *)message.data();
+            vecs[i][1].iov_len = message.size();
 
-        size_t index = 0;
-        for (auto i = range.first; i != range.second; i++) {
-            descriptors[index++] = (*i).handle();
-        }
+            headers[i] = {
+                .msg_name = nullptr,
+                .msg_namelen = 0,
+                .msg_iov = vecs[i],
+                .msg_iovlen = 2,
+                .msg_control = nullptr,
+                .msg_controllen = 0,
+                .msg_flags = 0,
+            };
+
+            const auto range = message.attachmentRange();
 
-        auto controlLength = CMSG_SPACE(sizeof(descriptors));
+            const size_t descriptorCount = range.second - range.first;
 
-        char buffer[controlLength];
-        messageHeader.msg_control = buffer;
-        messageHeader.msg_controllen = controlLength;
+            CL_ASSERT(descriptorCount <= MaxControlBufferItemCount);
 
-        struct cmsghdr *cmsgh = CMSG_FIRSTHDR(&messageHeader);
+            if (descriptorCount == 0) {
+                continue;
+            }
 
-        cmsgh->cmsg_level = SOL_SOCKET;
-        cmsgh->cmsg_type = SCM_RIGHTS;
-        cmsgh->cmsg_len = CMSG_LEN(sizeof(descriptors));
+            /*
+             *  Create an array of file descriptors
+             */
+            int descriptors[descriptorCount];
 
-        memcpy((int *)CMSG_DATA(cmsgh), descriptors, sizeof(descriptors));
+            size_t index = 0;
+            for (auto j = range.first; j != range.second; j++) {
+                descriptors[index++] = (*j).handle();
+            }
 
-        messageHeader.msg_controllen = cmsgh->cmsg_len;
-    }
+            headers[i].msg_control = controlBuffers[i];
+            headers[i].msg_controllen = CMSG_SPACE(sizeof(descriptors));
 
-    int sent = 0;
+            struct cmsghdr *cmsgh = CMSG_FIRSTHDR(&headers[i]);
 
-    while (true) {
-        sent = CL_TEMP_FAILURE_RETRY(::sendmsg(_handle, &messageHeader, 0));
+            cmsgh->cmsg_level = SOL_SOCKET;
+            cmsgh->cmsg_type = SCM_RIGHTS;
+            cmsgh->cmsg_len = CMSG_LEN(sizeof(descriptors));
+
+            memcpy((int *)CMSG_DATA(cmsgh), descriptors, sizeof(descriptors));
+
+            headers[i].msg_controllen = cmsgh->cmsg_len;
+        }
+
+        int sent = platformSendRecords(_handle, headers, batchCount);
 
         if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!wait) {
+                return Status::WouldBlock;
+            }
+
             struct pollfd pollFd = {
                 .fd = _handle, .events = POLLOUT, .revents = 0,
             };
@@ -319,14 +545,20 @@ Socket::Status Socket::WriteMessage(Message &message) {
                 CL_TEMP_FAILURE_RETRY(::poll(&pollFd, 1, -1 /* timeout */));
 
             CL_ASSERT(res == 1);
-        } else {
-            break;
+
+            continue;
         }
-    }
 
-    if (sent != message.size()) {
-        return errno == EPIPE ? Status::PermanentFailure
-                              : Status::TemporaryFailure;
+        if (sent == -1) {
+            return errno == EPIPE ? Status::PermanentFailure
+                                  : Status::TemporaryFailure;
+        }
+
+        /*
+         *  Records are sent whole or not at all. The ones that did not fit
+         *  are retried in the next batch.
+         */
+        written += sent;
     }
 
     return Status::Success;
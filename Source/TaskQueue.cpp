@@ -0,0 +1,87 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "TaskQueue.h"
+#include "Utilities.h"
+
+using namespace cl;
+
+TaskQueue::TaskQueue() : _head(nullptr) {
+}
+
+TaskQueue::~TaskQueue() {
+    Entry *entry = _head.exchange(nullptr);
+
+    while (entry != nullptr) {
+        Entry *next = entry->next;
+        delete entry;
+        entry = next;
+    }
+}
+
+bool TaskQueue::push(Task task, Clock::time_point fireTime) {
+    Entry *entry = new Entry{std::move(task), fireTime, nullptr};
+
+    Entry *head = _head.load(std::memory_order_relaxed);
+
+    do {
+        entry->next = head;
+    } while (!_head.compare_exchange_weak(head, entry,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+
+    return head == nullptr;
+}
+
+size_t TaskQueue::drain(DrainHandler handler) {
+    /*
+     *  Since the consumer takes the entire list at once, there is no ABA
+     *  hazard on the head. The list is in LIFO order, so reverse it first.
+     */
+    Entry *entry = _head.exchange(nullptr, std::memory_order_acquire);
+
+    Entry *reversed = nullptr;
+
+    while (entry != nullptr) {
+        Entry *next = entry->next;
+        entry->next = reversed;
+        reversed = entry;
+        entry = next;
+    }
+
+    size_t count = 0;
+
+    while (reversed != nullptr) {
+        Entry *next = reversed->next;
+
+        handler(reversed->task, reversed->fireTime);
+
+        delete reversed;
+        reversed = next;
+
+        count++;
+    }
+
+    return count;
+}
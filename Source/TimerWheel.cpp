@@ -0,0 +1,372 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "TimerWheel.h"
+#include "Utilities.h"
+
+#include <algorithm>
+
+using namespace cl;
+
+TimerWheel::Timer::Timer(Callback callback)
+    : _wheel(nullptr), _slot(nullptr), _expiryTick(0), _repeatTicks(0),
+      _callback(callback) {
+    prev = this;
+    next = this;
+}
+
+TimerWheel::Timer::~Timer() {
+    if (_wheel != nullptr) {
+        _wheel->cancel(*this);
+    }
+}
+
+TimerWheel::TimerWheel(std::chrono::nanoseconds resolution)
+    : _start(Clock::now()), _resolution(resolution), _currentTick(0),
+      _count(0), _outerCount(0) {
+
+    CL_ASSERT(resolution.count() > 0);
+
+    for (auto &slot : _inner) {
+        slot.prev = slot.next = &slot;
+    }
+
+    for (auto &level : _outer) {
+        for (auto &slot : level) {
+            slot.prev = slot.next = &slot;
+        }
+    }
+
+    memset(_innerOccupied, 0, sizeof(_innerOccupied));
+}
+
+TimerWheel::~TimerWheel() {
+    auto detachAll = [this](Link &slot) {
+        while (slot.next != &slot) {
+            unlink(static_cast<Timer &>(*slot.next));
+        }
+    };
+
+    for (auto &slot : _inner) {
+        detachAll(slot);
+    }
+
+    for (auto &level : _outer) {
+        for (auto &slot : level) {
+            detachAll(slot);
+        }
+    }
+}
+
+uint64_t TimerWheel::ticksForDuration(std::chrono::nanoseconds duration) const {
+    if (duration.count() <= 0) {
+        return 0;
+    }
+
+    /*
+     *  Round up so that timers never fire early
+     */
+    return (duration.count() + _resolution.count() - 1) / _resolution.count();
+}
+
+uint64_t TimerWheel::tickForTime(Clock::time_point time) const {
+    auto elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(time - _start);
+
+    if (elapsed.count() <= 0) {
+        return 0;
+    }
+
+    return elapsed.count() / _resolution.count();
+}
+
+void TimerWheel::schedule(Timer &timer, std::chrono::nanoseconds delay,
+                          std::chrono::nanoseconds repeatInterval) {
+    if (timer._wheel != nullptr) {
+        timer._wheel->unlink(timer);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - _start);
+
+    timer._expiryTick =
+        std::max(ticksForDuration(elapsed + delay), _currentTick);
+
+    timer._repeatTicks = repeatInterval.count() > 0
+                             ? std::max<uint64_t>(
+                                   ticksForDuration(repeatInterval), 1)
+                             : 0;
+
+    link(timer);
+}
+
+void TimerWheel::cancel(Timer &timer) {
+    if (timer._wheel == nullptr) {
+        return;
+    }
+
+    CL_ASSERT(timer._wheel == this);
+
+    unlink(timer);
+}
+
+void TimerWheel::link(Timer &timer) {
+    CL_ASSERT(timer._wheel == nullptr);
+    CL_ASSERT(timer._expiryTick >= _currentTick);
+
+    uint64_t expiry = timer._expiryTick;
+    uint64_t delta = expiry - _currentTick;
+
+    Link *slot = nullptr;
+
+    if (delta < InnerSlots) {
+        size_t index = expiry & (InnerSlots - 1);
+
+        slot = &_inner[index];
+        _innerOccupied[index / 64] |= (1ull << (index % 64));
+    } else {
+        const size_t MaxLevelShift =
+            InnerSlotsBits + (OuterLevels - 1) * OuterSlotsBits;
+
+        /*
+         *  Timers beyond the range of the wheel are parked in the outermost
+         *  level and placed again when that slot is cascaded.
+         */
+        if (delta >= (1ull << (MaxLevelShift + OuterSlotsBits))) {
+            expiry = _currentTick +
+                     (1ull << (MaxLevelShift + OuterSlotsBits)) - 1;
+            delta = expiry - _currentTick;
+        }
+
+        for (size_t level = 0; level < OuterLevels; level++) {
+            size_t shift = InnerSlotsBits + level * OuterSlotsBits;
+
+            if (delta < (1ull << (shift + OuterSlotsBits))) {
+                slot = &_outer[level][(expiry >> shift) & (OuterSlots - 1)];
+                break;
+            }
+        }
+
+        _outerCount++;
+    }
+
+    CL_ASSERT(slot != nullptr);
+
+    /*
+     *  Append to the tail so that timers with the same deadline fire in the
+     *  order in which they were scheduled
+     */
+    timer.prev = slot->prev;
+    timer.next = slot;
+    slot->prev->next = &timer;
+    slot->prev = &timer;
+
+    timer._slot = slot;
+    timer._wheel = this;
+
+    _count++;
+}
+
+void TimerWheel::unlink(Timer &timer) {
+    CL_ASSERT(timer._wheel == this);
+
+    timer.prev->next = timer.next;
+    timer.next->prev = timer.prev;
+    timer.prev = timer.next = &timer;
+
+    Link *slot = timer._slot;
+
+    if (slot >= _inner && slot < _inner + InnerSlots) {
+        if (slot->next == slot) {
+            size_t index = slot - _inner;
+            _innerOccupied[index / 64] &= ~(1ull << (index % 64));
+        }
+    } else {
+        _outerCount--;
+    }
+
+    timer._slot = nullptr;
+    timer._wheel = nullptr;
+
+    _count--;
+}
+
+void TimerWheel::cascade(size_t level) {
+    size_t shift = InnerSlotsBits + level * OuterSlotsBits;
+
+    Link &slot = _outer[level][(_currentTick >> shift) & (OuterSlots - 1)];
+
+    while (slot.next != &slot) {
+        Timer &timer = static_cast<Timer &>(*slot.next);
+
+        unlink(timer);
+        link(timer);
+    }
+}
+
+void TimerWheel::moveTo(uint64_t tick) {
+    if (tick == _currentTick) {
+        return;
+    }
+
+    _currentTick = tick;
+
+    if ((tick & (InnerSlots - 1)) != 0) {
+        return;
+    }
+
+    /*
+     *  Move timers from the outer levels inwards each time a level wraps
+     *  around. This must happen on every boundary the wheel enters, not just
+     *  the ones whose tick is fired, or the timers in the slot are skipped.
+     */
+    for (size_t level = 0; level < OuterLevels; level++) {
+        cascade(level);
+
+        size_t shift = InnerSlotsBits + level * OuterSlotsBits;
+
+        if (((_currentTick >> shift) & (OuterSlots - 1)) != 0) {
+            break;
+        }
+    }
+}
+
+size_t TimerWheel::fireCurrentTick() {
+    size_t index = _currentTick & (InnerSlots - 1);
+
+    Link &slot = _inner[index];
+
+    if (slot.next == &slot) {
+        moveTo(_currentTick + 1);
+        return 0;
+    }
+
+    /*
+     *  Move the expired timers to a local list before firing them. The tick
+     *  is advanced first so that timers scheduled by the callbacks land in
+     *  future ticks.
+     */
+    Link expired;
+    expired.next = slot.next;
+    expired.prev = slot.prev;
+    expired.next->prev = &expired;
+    expired.prev->next = &expired;
+    slot.prev = slot.next = &slot;
+
+    _innerOccupied[index / 64] &= ~(1ull << (index % 64));
+
+    moveTo(_currentTick + 1);
+
+    size_t fired = 0;
+
+    while (expired.next != &expired) {
+        Timer &timer = static_cast<Timer &>(*expired.next);
+
+        unlink(timer);
+
+        if (timer._repeatTicks != 0) {
+            timer._expiryTick =
+                std::max(timer._expiryTick + timer._repeatTicks, _currentTick);
+            link(timer);
+        }
+
+        /*
+         *  The callback may collect the timer
+         */
+        auto callback = timer._callback;
+
+        if (callback) {
+            callback();
+        }
+
+        fired++;
+    }
+
+    return fired;
+}
+
+uint64_t TimerWheel::nextEventTick() const {
+    size_t index = _currentTick & (InnerSlots - 1);
+
+    for (size_t word = index / 64; word < BitmapWords; word++) {
+        uint64_t bits = _innerOccupied[word];
+
+        if (word == index / 64) {
+            bits &= ~0ull << (index % 64);
+        }
+
+        if (bits != 0) {
+            size_t occupied = word * 64 + __builtin_ctzll(bits);
+            return _currentTick + (occupied - index);
+        }
+    }
+
+    /*
+     *  Nothing before the inner level wraps around. That is when the
+     *  remaining timers are either due or need to be cascaded.
+     */
+    return (_currentTick | (InnerSlots - 1)) + 1;
+}
+
+size_t TimerWheel::advance(Clock::time_point now) {
+    uint64_t target = tickForTime(now);
+
+    size_t fired = 0;
+
+    while (_currentTick <= target) {
+        if (_count == 0) {
+            _currentTick = target + 1;
+            break;
+        }
+
+        /*
+         *  The next event is never past the next boundary, so moving there
+         *  or just past the target never skips a cascade
+         */
+        uint64_t next = nextEventTick();
+
+        if (next > target) {
+            moveTo(target + 1);
+            break;
+        }
+
+        moveTo(next);
+
+        fired += fireCurrentTick();
+    }
+
+    return fired;
+}
+
+std::chrono::nanoseconds TimerWheel::timeout(Clock::time_point now) const {
+    if (_count == 0) {
+        return std::chrono::nanoseconds::max();
+    }
+
+    auto deadline = _start + nextEventTick() * _resolution;
+
+    return std::max(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now),
+        std::chrono::nanoseconds(0));
+}
@@ -28,39 +28,214 @@
 
 using namespace cl;
 
-WaitSet::WaitSet() : _handle(platformHandleCreate()) {
+const size_t WaitSet::DefaultMaxReadySources = 64;
+const WaitSet::Token WaitSet::InvalidToken;
+
+static inline WaitSet::Token WaitSet_MakeToken(uint32_t index,
+                                               uint32_t generation) {
+    return (static_cast<WaitSet::Token>(generation) << 32) | index;
+}
+
+static inline uint32_t WaitSet_TokenIndex(WaitSet::Token token) {
+    return static_cast<uint32_t>(token & 0xFFFFFFFF);
+}
+
+static inline uint32_t WaitSet_TokenGeneration(WaitSet::Token token) {
+    return static_cast<uint32_t>(token >> 32);
+}
+
+WaitSet::WaitSet(size_t maxReadySources)
+    : _handle(platformHandleCreate()), _maxReadySources(maxReadySources) {
+    CL_ASSERT(_maxReadySources > 0);
+
+    CL_INSTRUMENT(_blockedNanoseconds = 0);
+
+    _readySources.reserve(_maxReadySources);
+}
+
+bool WaitSet::isRegistered(const LooperSource *source) const {
+    if (source == nullptr) {
+        return false;
+    }
+
+    const Token token = source->waitSetToken();
+
+    if (token == InvalidToken) {
+        return false;
+    }
+
+    const uint32_t index = WaitSet_TokenIndex(token);
+
+    return index < _slots.size() && _slots[index].source.get() == source &&
+           _slots[index].generation == WaitSet_TokenGeneration(token);
 }
 
 bool WaitSet::addSource(std::shared_ptr<LooperSource> source) {
-    if (_sources.find(source) != _sources.end()) {
+    if (source == nullptr || source->waitSetToken() != InvalidToken) {
         return false;
     }
 
-    _sources.insert(source);
-    source->updateInWaitSetHandle(_handle, true);
+    uint32_t index = 0;
+
+    if (_freeSlots.empty()) {
+        index = static_cast<uint32_t>(_slots.size());
+        _slots.push_back(Slot{nullptr, 1, false});
+    } else {
+        index = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+
+    Slot &slot = _slots[index];
+
+    source->setWaitSetToken(WaitSet_MakeToken(index, slot.generation));
+    source->updateInWaitSetHandle(_handle, LooperSource::WaitSetAdd);
+
+    slot.source = std::move(source);
 
     return true;
 }
 
 bool WaitSet::removeSource(std::shared_ptr<LooperSource> source) {
-    if (_sources.find(source) == _sources.end()) {
+    if (!isRegistered(source.get())) {
         return false;
     }
 
-    _sources.erase(source);
-    source->updateInWaitSetHandle(_handle, false);
+    const uint32_t index = WaitSet_TokenIndex(source->waitSetToken());
+
+    source->updateInWaitSetHandle(_handle, LooperSource::WaitSetRemove);
+    source->setWaitSetToken(InvalidToken);
+
+    /*
+     *  Bumping the generation invalidates any tokens for this source still
+     *  present in the batch being dispatched. Zero is never a valid
+     *  generation so that the invalid token never resolves.
+     */
+    Slot &slot = _slots[index];
+
+    slot.source = nullptr;
+    slot.pending = false;
+
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+
+    _freeSlots.push_back(index);
 
     return true;
 }
 
-LooperSource *WaitSet::wait() {
-    return platformHandleWait(_handle);
+bool WaitSet::updateSource(std::shared_ptr<LooperSource> source) {
+    if (!isRegistered(source.get())) {
+        return false;
+    }
+
+    source->updateInWaitSetHandle(_handle, LooperSource::WaitSetUpdate);
+
+    return true;
+}
+
+const WaitSet::ReadySources &WaitSet::wait(std::chrono::nanoseconds timeout) {
+    _readySources.resize(_maxReadySources);
+
+#if CL_ENABLE_INSTRUMENTATION
+    const auto start = std::chrono::steady_clock::now();
+#endif
+
+    size_t count = platformHandleWait(_handle, _readySources.data(),
+                                      _maxReadySources, timeout);
+
+#if CL_ENABLE_INSTRUMENTATION
+    const auto blocked = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    _blockedNanoseconds.store(
+        _blockedNanoseconds.load(std::memory_order_relaxed) + blocked.count(),
+        std::memory_order_relaxed);
+
+    _eventsPerWakeup.record(count);
+#endif
+
+    _readySources.resize(count);
+
+    return _readySources;
+}
+
+LooperSource *WaitSet::source(Token token) const {
+    const uint32_t index = WaitSet_TokenIndex(token);
+
+    if (index >= _slots.size()) {
+        return nullptr;
+    }
+
+    const Slot &slot = _slots[index];
+
+    if (slot.generation != WaitSet_TokenGeneration(token)) {
+        return nullptr;
+    }
+
+    return slot.source.get();
+}
+
+bool WaitSet::markPending(Token token) {
+    if (source(token) == nullptr) {
+        return false;
+    }
+
+    Slot &slot = _slots[WaitSet_TokenIndex(token)];
+
+    if (slot.pending) {
+        return false;
+    }
+
+    slot.pending = true;
+
+    return true;
+}
+
+void WaitSet::clearPending(Token token) {
+    if (source(token) == nullptr) {
+        return;
+    }
+
+    _slots[WaitSet_TokenIndex(token)].pending = false;
 }
 
 WaitSet::~WaitSet() {
-    for (auto const &source : _sources) {
-        source->updateInWaitSetHandle(_handle, false);
+    for (auto &slot : _slots) {
+        if (slot.source == nullptr) {
+            continue;
+        }
+
+        slot.source->updateInWaitSetHandle(_handle,
+                                           LooperSource::WaitSetRemove);
+        slot.source->setWaitSetToken(InvalidToken);
     }
 
     platformHandleDestory(_handle);
 }
+
+std::vector<std::shared_ptr<LooperSource>> WaitSet::sources() const {
+    std::vector<std::shared_ptr<LooperSource>> sources;
+
+    for (const auto &slot : _slots) {
+        if (slot.source) {
+            sources.push_back(slot.source);
+        }
+    }
+
+    return sources;
+}
+
+WaitSet::Stats WaitSet::stats() const {
+    Stats stats;
+
+#if CL_ENABLE_INSTRUMENTATION
+    stats.eventsPerWakeup = _eventsPerWakeup.snapshot();
+    stats.wakeups = stats.eventsPerWakeup.count;
+    stats.events = stats.eventsPerWakeup.sum;
+    stats.blockedTime = std::chrono::nanoseconds(
+        _blockedNanoseconds.load(std::memory_order_relaxed));
+#endif
+
+    return stats;
+}
@@ -0,0 +1,197 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "BoundedQueue.h"
+#include "LooperPool.h"
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(BoundedQueueTest, FirstInFirstOutTillFull) {
+    cl::BoundedQueue<int> queue(5);
+
+    ASSERT_EQ(queue.capacity(), 8u);
+
+    for (int i = 0; i < 8; i++) {
+        ASSERT_TRUE(queue.tryPush(i));
+    }
+
+    ASSERT_FALSE(queue.tryPush(8));
+
+    int item = -1;
+
+    for (int i = 0; i < 8; i++) {
+        ASSERT_TRUE(queue.tryPop(item));
+        ASSERT_EQ(item, i);
+    }
+
+    ASSERT_FALSE(queue.tryPop(item));
+}
+
+TEST(BoundedQueueTest, RemainingItemsAreDestroyed) {
+    auto shared = std::make_shared<int>(0);
+
+    {
+        cl::BoundedQueue<std::shared_ptr<int>> queue(4);
+
+        ASSERT_TRUE(queue.tryPush(shared));
+        ASSERT_TRUE(queue.tryPush(shared));
+        ASSERT_EQ(shared.use_count(), 3);
+    }
+
+    ASSERT_EQ(shared.use_count(), 1);
+}
+
+TEST(BoundedQueueTest, FailedPushDoesNotMoveItem) {
+    cl::BoundedQueue<std::unique_ptr<int>> queue(2);
+
+    ASSERT_TRUE(queue.tryPush(cl::Utils::make_unique<int>(1)));
+    ASSERT_TRUE(queue.tryPush(cl::Utils::make_unique<int>(2)));
+
+    auto item = cl::Utils::make_unique<int>(3);
+
+    ASSERT_FALSE(queue.tryPush(std::move(item)));
+    ASSERT_TRUE(item != nullptr);
+}
+
+TEST(BoundedQueueTest, PopBlocksTillPush) {
+    cl::BoundedQueue<int> queue(4);
+
+    int item = 0;
+
+    ASSERT_FALSE(queue.pop(item, std::chrono::milliseconds(10)));
+
+    std::thread producer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.push(42);
+    });
+
+    ASSERT_TRUE(queue.pop(item));
+    ASSERT_EQ(item, 42);
+
+    producer.join();
+}
+
+TEST(BoundedQueueTest, PushBlocksTillPop) {
+    cl::BoundedQueue<int> queue(2);
+
+    queue.push(1);
+    queue.push(2);
+
+    std::atomic<bool> pushed(false);
+
+    std::thread producer([&]() {
+        queue.push(3);
+        pushed = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(pushed);
+
+    int item = 0;
+    ASSERT_TRUE(queue.pop(item));
+    ASSERT_EQ(item, 1);
+
+    producer.join();
+    ASSERT_TRUE(pushed);
+
+    ASSERT_TRUE(queue.pop(item));
+    ASSERT_EQ(item, 2);
+    ASSERT_TRUE(queue.pop(item));
+    ASSERT_EQ(item, 3);
+}
+
+TEST(BoundedQueueTest, MultipleProducersAndConsumers) {
+    const size_t ThreadCount = 4;
+    const uint64_t ItemsPerProducer = 20000;
+
+    cl::BoundedQueue<uint64_t> queue(64);
+
+    std::atomic<uint64_t> sum(0);
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < ThreadCount; i++) {
+        threads.emplace_back([&]() {
+            for (uint64_t item = 1; item <= ItemsPerProducer; item++) {
+                queue.push(item);
+            }
+        });
+
+        threads.emplace_back([&]() {
+            uint64_t item = 0;
+
+            for (uint64_t j = 0; j < ItemsPerProducer; j++) {
+                ASSERT_TRUE(queue.pop(item));
+                sum += item;
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(sum.load(),
+              ThreadCount * ItemsPerProducer * (ItemsPerProducer + 1) / 2);
+}
+
+TEST(BoundedQueueTest, LooperSourcesShareWork) {
+    const size_t ItemCount = 10000;
+
+    cl::BoundedQueue<size_t> queue(256);
+
+    std::atomic<size_t> handled(0);
+    std::atomic<size_t> sourcesAdded(0);
+
+    cl::LooperPool pool(2);
+
+    for (size_t i = 0; i < pool.size(); i++) {
+        auto source = queue.createSource([&](size_t &) { handled++; }, 16);
+
+        pool.dispatch([source, &sourcesAdded](cl::Looper *looper) {
+            looper->addSource(source);
+            sourcesAdded++;
+        });
+    }
+
+    while (sourcesAdded != pool.size()) {
+        std::this_thread::yield();
+    }
+
+    for (size_t i = 0; i < ItemCount; i++) {
+        queue.push(i);
+    }
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    while (handled != ItemCount &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+
+    ASSERT_EQ(handled.load(), ItemCount);
+}
@@ -25,10 +25,17 @@
 #include <gtest/gtest.h>
 #include "Channel.h"
 #include "Server.h"
+#include "Socket.h"
 #include "Looper.h"
 #include "Message.h"
+#include "SharedMemory.h"
 
+#include <atomic>
 #include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 
 TEST(ChannelTest, SimpleInitialization) {
 
@@ -264,3 +271,1080 @@ TEST(ChannelTest, CreateConnectedChannels) {
     ASSERT_TRUE(connectedChannels.first.get() != nullptr);
     ASSERT_TRUE(connectedChannels.second.get() != nullptr);
 }
+
+TEST(ChannelTest, SharedMemoryTransport) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    /*
+     *  Payloads well beyond the limits of the socket, interleaved with
+     *  messages carrying attachments
+     */
+    const std::vector<size_t> PayloadSizes = {64, 4096, 65536, 3 << 20, 0};
+
+    const size_t Capacity = 8 << 20;
+
+    std::thread senderThread([&]() {
+        ASSERT_TRUE(channels.first->enableSharedMemoryTransport(Capacity));
+        ASSERT_TRUE(channels.first->isSharedMemoryTransportEnabled());
+
+        for (size_t i = 0; i < PayloadSizes.size(); i++) {
+            cl::Message message(PayloadSizes[i]);
+
+            for (size_t j = 0; j < PayloadSizes[i]; j++) {
+                message.encode(static_cast<uint8_t>(i + j));
+            }
+
+            cl::SharedMemory memory(1024);
+
+            if (i % 2 == 1) {
+                message.addAttachment(cl::Attachment(memory.handle()));
+            }
+
+            ASSERT_TRUE(channels.first->sendMessage(message));
+        }
+    });
+
+    size_t received = 0;
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            ASSERT_TRUE(received < PayloadSizes.size());
+            ASSERT_EQ(message.size(), PayloadSizes[received]);
+
+            for (size_t j = 0; j < message.size(); j++) {
+                uint8_t value = 0;
+                ASSERT_TRUE(message.decode(value));
+                ASSERT_EQ(value, static_cast<uint8_t>(received + j));
+            }
+
+            auto range = message.attachmentRange();
+            auto count = range.second - range.first;
+
+            ASSERT_EQ(count, received % 2 == 1 ? 1 : 0);
+
+            for (auto i = range.first; i != range.second; i++) {
+                close(i->handle());
+            }
+
+            if (++received == PayloadSizes.size()) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    senderThread.join();
+    receiverThread.join();
+
+    ASSERT_EQ(received, PayloadSizes.size());
+}
+
+TEST(ChannelTest, SharedMemoryTransportSpillsLargeMessages) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    /*
+     *  Messages larger than the ring at its default capacity keep their
+     *  place among the ones that fit
+     */
+    const std::vector<size_t> PayloadSizes = {64, 4 << 20, 64, 3 << 20};
+
+    ASSERT_TRUE(channels.first->enableSharedMemoryTransport());
+
+    for (size_t i = 0; i < PayloadSizes.size(); i++) {
+        cl::Message message(PayloadSizes[i]);
+
+        for (size_t j = 0; j < PayloadSizes[i]; j++) {
+            message.encode(static_cast<uint8_t>(i + j));
+        }
+
+        cl::SharedMemory memory(1024);
+
+        if (i == 1) {
+            message.addAttachment(cl::Attachment(memory.handle()));
+        }
+
+        ASSERT_TRUE(channels.first->sendMessage(message));
+    }
+
+    size_t received = 0;
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            ASSERT_TRUE(received < PayloadSizes.size());
+            ASSERT_EQ(message.size(), PayloadSizes[received]);
+
+            for (size_t j = 0; j < message.size(); j++) {
+                ASSERT_EQ(message.data()[j],
+                          static_cast<uint8_t>(received + j));
+            }
+
+            auto range = message.attachmentRange();
+            ASSERT_EQ(range.second - range.first, received == 1 ? 1 : 0);
+
+            for (auto i = range.first; i != range.second; i++) {
+                close(i->handle());
+            }
+
+            if (++received == PayloadSizes.size()) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    receiverThread.join();
+
+    ASSERT_EQ(received, PayloadSizes.size());
+}
+
+TEST(ChannelTest, LargeMessages) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    /*
+     *  Sizes around the single record limit, fragmented sizes up to the
+     *  spill threshold and spilled sizes beyond it
+     */
+    const std::vector<size_t> PayloadSizes = {
+        100,
+        cl::Socket::MaxBufferSize - 1,
+        cl::Socket::MaxBufferSize,
+        10000,
+        cl::Channel::DefaultSpillThreshold,
+        cl::Channel::DefaultSpillThreshold + 1,
+        5 << 20,
+    };
+
+    std::thread senderThread([&]() {
+        for (size_t i = 0; i < PayloadSizes.size(); i++) {
+            cl::Message message(PayloadSizes[i]);
+
+            for (size_t j = 0; j < PayloadSizes[i]; j++) {
+                message.encode(static_cast<uint8_t>(i + j));
+            }
+
+            cl::SharedMemory memory(1024);
+
+            if (i % 2 == 1) {
+                message.addAttachment(cl::Attachment(memory.handle()));
+            }
+
+            ASSERT_TRUE(channels.first->sendMessage(message));
+        }
+    });
+
+    size_t received = 0;
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            ASSERT_TRUE(received < PayloadSizes.size());
+            ASSERT_EQ(message.size(), PayloadSizes[received]);
+
+            for (size_t j = 0; j < message.size(); j++) {
+                uint8_t value = 0;
+                ASSERT_TRUE(message.decode(value));
+                ASSERT_EQ(value, static_cast<uint8_t>(received + j));
+            }
+
+            auto range = message.attachmentRange();
+            auto count = range.second - range.first;
+
+            ASSERT_EQ(count, received % 2 == 1 ? 1 : 0);
+
+            for (auto i = range.first; i != range.second; i++) {
+                close(i->handle());
+            }
+
+            if (++received == PayloadSizes.size()) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    senderThread.join();
+    receiverThread.join();
+
+    ASSERT_EQ(received, PayloadSizes.size());
+}
+
+TEST(ChannelTest, OversizedFragmentedMessageTerminates) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    /*
+     *  Fragmented since it is larger than a record but below the spill
+     *  threshold
+     */
+    const size_t Size = 10000;
+
+    cl::Message message(Size);
+
+    for (size_t i = 0; i < Size; i++) {
+        message.encode(static_cast<uint8_t>(i));
+    }
+
+    ASSERT_TRUE(channels.first->sendMessage(message));
+
+    bool received = false;
+    bool terminated = false;
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        channel->maxFragmentedMessageSize(8192);
+
+        channel->messageReceivedCallback(
+            [&](cl::Message &message) { received = true; });
+
+        channel->terminationCallback([&]() {
+            terminated = true;
+            looper->terminate();
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    receiverThread.join();
+
+    ASSERT_FALSE(received);
+    ASSERT_TRUE(terminated);
+    ASSERT_FALSE(channels.second->isConnected());
+}
+
+TEST(ChannelTest, OverflowingFragmentClosesAttachments) {
+
+    auto sockets = cl::Socket::CreatePair();
+    auto &peer = sockets.first;
+
+    cl::Channel channel(std::move(sockets.second));
+
+    int pipeHandles[2] = {-1, -1};
+    ASSERT_EQ(pipe(pipeHandles), 0);
+    ASSERT_EQ(fcntl(pipeHandles[0], F_SETFL, O_NONBLOCK), 0);
+
+    /*
+     *  Frame kinds as written by the channel
+     */
+    const uint8_t MessageFrame = 0;
+    const uint8_t FragmentStartFrame = 4;
+    const uint8_t FragmentFrame = 5;
+
+    /*
+     *  Announce a 16 byte message carrying the write end of the pipe, then
+     *  send more than the remaining bytes
+     */
+    uint8_t startPrefix[sizeof(uint8_t) + sizeof(uint64_t)];
+    const uint64_t length = 16;
+    startPrefix[0] = FragmentStartFrame;
+    memcpy(startPrefix + sizeof(uint8_t), &length, sizeof(length));
+
+    const uint8_t payload[16] = {0};
+
+    cl::Message start(payload, 8);
+    start.addAttachment(cl::Attachment(pipeHandles[1]));
+    ASSERT_EQ(peer->WriteMessage(start, startPrefix, sizeof(startPrefix)),
+              cl::Socket::Status::Success);
+    ASSERT_EQ(close(pipeHandles[1]), 0);
+
+    cl::Message overflow(payload, sizeof(payload));
+    ASSERT_EQ(peer->WriteMessage(overflow, &FragmentFrame, 1),
+              cl::Socket::Status::Success);
+
+    cl::Message done(payload, 1);
+    ASSERT_EQ(peer->WriteMessage(done, &MessageFrame, 1),
+              cl::Socket::Status::Success);
+
+    size_t received = 0;
+
+    std::thread receiverThread([&]() {
+        auto looper = cl::Looper::Current();
+
+        channel.messageReceivedCallback([&](cl::Message &message) {
+            received++;
+            looper->terminate();
+        });
+
+        channel.scheduleInLooper(looper);
+        looper->loop();
+        channel.unscheduleFromLooper(looper);
+    });
+
+    receiverThread.join();
+
+    ASSERT_EQ(received, 1);
+
+    /*
+     *  The pipe only reports the end of the stream once every copy of the
+     *  write end is closed
+     */
+    char byte = 0;
+    ASSERT_EQ(read(pipeHandles[0], &byte, 1), 0);
+    ASSERT_EQ(close(pipeHandles[0]), 0);
+}
+
+TEST(ChannelTest, SendMessagesInOrder) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    /*
+     *  Runs of small messages that are batched, separated by messages that
+     *  are fragmented and spilled
+     */
+    std::vector<size_t> PayloadSizes;
+
+    for (size_t i = 0; i < 3 * cl::Socket::MaxBatchCount; i++) {
+        PayloadSizes.push_back(i % 17 == 16 ? 20000 : 16 + i);
+    }
+
+    PayloadSizes.push_back(cl::Channel::DefaultSpillThreshold + 1);
+    PayloadSizes.push_back(8);
+
+    std::vector<std::unique_ptr<cl::Message>> messages;
+    std::vector<cl::Message *> messagePointers;
+
+    for (size_t i = 0; i < PayloadSizes.size(); i++) {
+        auto message =
+            std::unique_ptr<cl::Message>(new cl::Message(PayloadSizes[i]));
+
+        for (size_t j = 0; j < PayloadSizes[i]; j++) {
+            message->encode(static_cast<uint8_t>(i + j));
+        }
+
+        messagePointers.push_back(message.get());
+        messages.push_back(std::move(message));
+    }
+
+    std::thread senderThread([&]() {
+        ASSERT_TRUE(channels.first->sendMessages(messagePointers));
+    });
+
+    size_t received = 0;
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            ASSERT_TRUE(received < PayloadSizes.size());
+            ASSERT_EQ(message.size(), PayloadSizes[received]);
+
+            for (size_t j = 0; j < message.size(); j++) {
+                uint8_t value = 0;
+                ASSERT_TRUE(message.decode(value));
+                ASSERT_EQ(value, static_cast<uint8_t>(received + j));
+            }
+
+            if (++received == PayloadSizes.size()) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    senderThread.join();
+    receiverThread.join();
+
+    ASSERT_EQ(received, PayloadSizes.size());
+}
+
+TEST(ChannelTest, ThreadAffinityHandsOffSends) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    /*
+     *  Small messages and ones that are fragmented, sent one by one and in
+     *  a batch
+     */
+    const size_t Count = 40;
+
+    std::vector<std::unique_ptr<cl::Message>> messages;
+    std::vector<cl::Message *> batch;
+    std::vector<size_t> sizes;
+
+    for (size_t i = 0; i < Count; i++) {
+        const size_t size = i % 9 == 8 ? 20000 : 16 + i;
+        sizes.push_back(size);
+
+        auto message = std::unique_ptr<cl::Message>(new cl::Message(size));
+
+        for (size_t j = 0; j < size; j++) {
+            message->encode(static_cast<uint8_t>(i + j));
+        }
+
+        if (i >= Count / 2) {
+            batch.push_back(message.get());
+        }
+
+        messages.push_back(std::move(message));
+    }
+
+    std::atomic<cl::Looper *> senderLooper(nullptr);
+
+    /*
+     *  The sending channel is bound to the thread of its looper
+     */
+    std::thread senderLooperThread([&]() {
+        auto &channel = channels.first;
+        auto looper = cl::Looper::Current();
+
+        channel->threadAffinity(true);
+        channel->scheduleInLooper(looper);
+
+        senderLooper = looper;
+
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    size_t received = 0;
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            ASSERT_TRUE(received < Count);
+            ASSERT_EQ(message.size(), sizes[received]);
+
+            uint8_t value = 0;
+            ASSERT_TRUE(message.decode(value));
+            ASSERT_EQ(value, static_cast<uint8_t>(received));
+
+            if (++received == Count) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    while (senderLooper == nullptr) {
+        std::this_thread::yield();
+    }
+
+    /*
+     *  Sends from this thread are handed to the looper of the channel. The
+     *  messages may be changed as soon as the sends return.
+     */
+    for (size_t i = 0; i < Count / 2; i++) {
+        ASSERT_TRUE(channels.first->sendMessage(*messages[i]));
+    }
+
+    ASSERT_TRUE(channels.first->sendMessages(batch));
+
+    for (auto &message : messages) {
+        message->reset();
+    }
+
+    receiverThread.join();
+
+    senderLooper.load()->terminate();
+    senderLooperThread.join();
+
+    ASSERT_EQ(received, Count);
+}
+
+TEST(ChannelTest, ThreadAffinityHandOffToTerminatedChannel) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    std::atomic<cl::Looper *> senderLooper(nullptr);
+    size_t terminations = 0;
+
+    /*
+     *  The sending channel is terminated on its own thread before anything
+     *  is handed to it
+     */
+    std::thread senderLooperThread([&]() {
+        auto &channel = channels.first;
+        auto looper = cl::Looper::Current();
+
+        channel->threadAffinity(true);
+        channel->terminationCallback([&]() { terminations++; });
+        channel->scheduleInLooper(looper);
+        channel->terminate();
+
+        senderLooper = looper;
+
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    while (senderLooper == nullptr) {
+        std::this_thread::yield();
+    }
+
+    int pipeHandles[2] = {-1, -1};
+    ASSERT_EQ(pipe(pipeHandles), 0);
+    ASSERT_EQ(fcntl(pipeHandles[0], F_SETFL, O_NONBLOCK), 0);
+
+    cl::Message first(16);
+    first.encode(static_cast<uint64_t>(1));
+    first.addAttachment(cl::Attachment(pipeHandles[1]));
+
+    cl::Message second(16);
+    second.encode(static_cast<uint64_t>(2));
+    second.addAttachment(cl::Attachment(pipeHandles[1]));
+
+    /*
+     *  Succeeds since the messages are only handed off
+     */
+    std::vector<cl::Message *> batch = {&first, &second};
+    ASSERT_TRUE(channels.first->sendMessages(batch));
+    ASSERT_EQ(close(pipeHandles[1]), 0);
+
+    /*
+     *  Tasks run in the order they were posted
+     */
+    cl::Looper *looper = senderLooper;
+    looper->post([looper]() { looper->terminate(); });
+    senderLooperThread.join();
+
+    ASSERT_EQ(terminations, 1);
+    ASSERT_FALSE(channels.first->isConnected());
+
+    /*
+     *  The copies of the write end held by the dropped messages were closed
+     */
+    char byte = 0;
+    ASSERT_EQ(read(pipeHandles[0], &byte, 1), 0);
+    ASSERT_EQ(close(pipeHandles[0]), 0);
+}
+
+TEST(ChannelTest, ThreadAffinitySendsWhileRebinding) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    const uint32_t Count = 2000;
+    const size_t Rebinds = 200;
+
+    /*
+     *  The looper of the sending channel keeps scheduling and unscheduling
+     *  it while this thread sends. The channel is left unscheduled.
+     */
+    std::atomic<cl::Looper *> senderLooper(nullptr);
+    std::atomic<bool> rebound(false);
+
+    std::thread senderLooperThread([&]() {
+        auto &channel = channels.first;
+        auto looper = cl::Looper::Current();
+
+        channel->threadAffinity(true);
+
+        size_t rebinds = 0;
+        std::function<void(void)> rebind;
+
+        rebind = [&]() {
+            if (rebinds % 2 == 0) {
+                channel->scheduleInLooper(looper);
+            } else {
+                channel->unscheduleFromLooper(looper);
+            }
+
+            if (++rebinds < Rebinds) {
+                looper->postDelayed(rebind, std::chrono::microseconds(50));
+            } else {
+                rebound = true;
+            }
+        };
+
+        looper->post(rebind);
+
+        senderLooper = looper;
+        looper->loop();
+    });
+
+    /*
+     *  Messages handed to the looper are dropped if the channel was unbound
+     *  by the time they are sent, but the rest must arrive whole and in
+     *  order
+     */
+    int64_t last = -1;
+    bool ordered = true;
+    bool intact = true;
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            uint32_t index = 0;
+            intact = intact && message.decode(index);
+
+            ordered = ordered && static_cast<int64_t>(index) > last;
+            last = index;
+
+            uint8_t value = 0;
+
+            while (message.decode(value)) {
+                intact = intact && value == static_cast<uint8_t>(index);
+            }
+
+            if (index == Count) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    while (senderLooper == nullptr) {
+        std::this_thread::yield();
+    }
+
+    auto send = [&](uint32_t index) {
+        const size_t size = index % 16 == 15 ? 20000 : 64;
+
+        cl::Message message(size);
+        message.encode(index);
+
+        for (size_t j = sizeof(index); j < size; j++) {
+            message.encode(static_cast<uint8_t>(index));
+        }
+
+        return channels.first->sendMessage(message);
+    };
+
+    for (uint32_t i = 0; i < Count; i++) {
+        ASSERT_TRUE(send(i));
+    }
+
+    while (!rebound) {
+        std::this_thread::yield();
+    }
+
+    ASSERT_TRUE(send(Count));
+
+    receiverThread.join();
+
+    senderLooper.load()->terminate();
+    senderLooperThread.join();
+
+    ASSERT_TRUE(ordered);
+    ASSERT_TRUE(intact);
+    ASSERT_EQ(last, Count);
+}
+
+TEST(ChannelTest, NonBlockingSendQueue) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    auto &sender = channels.first;
+
+    sender->nonBlockingSends(true);
+    sender->sendQueueWatermarks(64 << 10, 256 << 10);
+
+    std::atomic<int> backpressureCount(0);
+    std::atomic<int> relievedCount(0);
+
+    sender->backpressureCallback([&](bool backpressure) {
+        if (backpressure) {
+            backpressureCount++;
+        } else {
+            relievedCount++;
+        }
+    });
+
+    /*
+     *  The looper the sender is scheduled in drains its send queue
+     */
+    cl::Looper *senderLooper = nullptr;
+    std::atomic<bool> senderReady(false);
+
+    std::thread senderThread([&]() {
+        senderLooper = cl::Looper::Current();
+        sender->scheduleInLooper(senderLooper);
+        senderReady = true;
+        senderLooper->loop();
+        sender->unscheduleFromLooper(senderLooper);
+    });
+
+    while (!senderReady) {
+        std::this_thread::yield();
+    }
+
+    /*
+     *  Nobody is reading yet. Sends must neither block nor fail.
+     */
+    const size_t Count = 4000;
+    const size_t MessageSize = 1000;
+
+    for (size_t i = 0; i < Count; i++) {
+        cl::Message message(MessageSize);
+
+        for (size_t j = 0; j < MessageSize; j++) {
+            message.encode(static_cast<uint8_t>(i + j));
+        }
+
+        ASSERT_TRUE(sender->sendMessage(message));
+    }
+
+    ASSERT_EQ(backpressureCount, 1);
+    ASSERT_EQ(relievedCount, 0);
+    ASSERT_GT(sender->sendQueueSize(), 0u);
+
+    size_t received = 0;
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            ASSERT_EQ(message.size(), MessageSize);
+
+            for (size_t j = 0; j < message.size(); j++) {
+                uint8_t value = 0;
+                ASSERT_TRUE(message.decode(value));
+                ASSERT_EQ(value, static_cast<uint8_t>(received + j));
+            }
+
+            if (++received == Count) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    receiverThread.join();
+
+    senderLooper->terminate();
+    senderThread.join();
+
+    ASSERT_EQ(received, Count);
+    ASSERT_EQ(backpressureCount, 1);
+    ASSERT_EQ(relievedCount, 1);
+    ASSERT_EQ(sender->sendQueueSize(), 0u);
+}
+
+TEST(ChannelTest, SharedMemoryTransportQueuesWhenFull) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    auto &sender = channels.first;
+
+    sender->sendQueueWatermarks(8 << 10, 32 << 10);
+
+    std::atomic<int> backpressureCount(0);
+    std::atomic<int> relievedCount(0);
+
+    sender->backpressureCallback([&](bool backpressure) {
+        if (backpressure) {
+            backpressureCount++;
+        } else {
+            relievedCount++;
+        }
+    });
+
+    ASSERT_TRUE(sender->enableSharedMemoryTransport(4096));
+
+    /*
+     *  The looper the sender is scheduled in hears about the room the peer
+     *  makes in the transport
+     */
+    cl::Looper *senderLooper = nullptr;
+    std::atomic<bool> senderReady(false);
+
+    std::thread senderThread([&]() {
+        senderLooper = cl::Looper::Current();
+        sender->scheduleInLooper(senderLooper);
+        senderReady = true;
+        senderLooper->loop();
+        sender->unscheduleFromLooper(senderLooper);
+    });
+
+    while (!senderReady) {
+        std::this_thread::yield();
+    }
+
+    /*
+     *  Nobody is reading yet. The ring fills up after a few messages, but
+     *  sends must neither block nor fail.
+     */
+    const size_t Count = 400;
+    const size_t MessageSize = 1000;
+
+    for (size_t i = 0; i < Count; i++) {
+        cl::Message message(MessageSize);
+
+        for (size_t j = 0; j < MessageSize; j++) {
+            message.encode(static_cast<uint8_t>(i + j));
+        }
+
+        ASSERT_TRUE(sender->sendMessage(message));
+    }
+
+    ASSERT_EQ(backpressureCount, 1);
+    ASSERT_EQ(relievedCount, 0);
+    ASSERT_GT(sender->sendQueueSize(), 0u);
+
+    size_t received = 0;
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            ASSERT_EQ(message.size(), MessageSize);
+
+            for (size_t j = 0; j < message.size(); j++) {
+                ASSERT_EQ(message.data()[j],
+                          static_cast<uint8_t>(received + j));
+            }
+
+            if (++received == Count) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    receiverThread.join();
+
+    senderLooper->terminate();
+    senderThread.join();
+
+    ASSERT_EQ(received, Count);
+    ASSERT_EQ(backpressureCount, 1);
+    ASSERT_EQ(relievedCount, 1);
+    ASSERT_EQ(sender->sendQueueSize(), 0u);
+}
+
+TEST(ChannelTest, ReadBudgetIsFair) {
+
+    auto busy = cl::Channel::CreateConnectedChannels();
+    auto quiet = cl::Channel::CreateConnectedChannels();
+
+    const size_t Budget = 8;
+    const size_t Count = 40;
+
+    busy.second->readBudget(Budget);
+
+    /*
+     *  Both channels have records pending before the looper ever runs
+     */
+    for (size_t i = 0; i < Count; i++) {
+        cl::Message message;
+        ASSERT_TRUE(message.encode(static_cast<uint32_t>(i)));
+        ASSERT_TRUE(busy.first->sendMessage(message));
+    }
+
+    cl::Message message;
+    ASSERT_TRUE(message.encode(static_cast<uint32_t>(0)));
+    ASSERT_TRUE(quiet.first->sendMessage(message));
+
+    size_t busyReceived = 0;
+    size_t busyReceivedBeforeQuiet = Count;
+    bool quietReceived = false;
+
+    std::thread receiverThread([&]() {
+        auto looper = cl::Looper::Current();
+
+        auto terminateIfDone = [&]() {
+            if (busyReceived == Count && quietReceived) {
+                looper->terminate();
+            }
+        };
+
+        busy.second->messageReceivedCallback([&](cl::Message &message) {
+            uint32_t value = 0;
+            ASSERT_TRUE(message.decode(value));
+            ASSERT_EQ(value, busyReceived);
+
+            busyReceived++;
+            terminateIfDone();
+        });
+
+        quiet.second->messageReceivedCallback([&](cl::Message &message) {
+            busyReceivedBeforeQuiet = busyReceived;
+            quietReceived = true;
+            terminateIfDone();
+        });
+
+        busy.second->scheduleInLooper(looper);
+        quiet.second->scheduleInLooper(looper);
+
+        looper->loop();
+
+        busy.second->unscheduleFromLooper(looper);
+        quiet.second->unscheduleFromLooper(looper);
+    });
+
+    receiverThread.join();
+
+    /*
+     *  Records beyond the budget are still read, but only after the quiet
+     *  channel got its turn
+     */
+    ASSERT_EQ(busyReceived, Count);
+    ASSERT_TRUE(quietReceived);
+    ASSERT_LE(busyReceivedBeforeQuiet, Budget);
+}
+
+TEST(ChannelTest, ReadBudgetCoversSharedMemoryTransport) {
+
+    auto busy = cl::Channel::CreateConnectedChannels();
+    auto quiet = cl::Channel::CreateConnectedChannels();
+
+    const size_t Budget = 8;
+    const size_t Count = 40;
+
+    busy.second->readBudget(Budget);
+
+    /*
+     *  The records of the busy channel are all in the ring before the looper
+     *  ever runs, and the socket only carries a few frames
+     */
+    ASSERT_TRUE(busy.first->enableSharedMemoryTransport());
+
+    for (size_t i = 0; i < Count; i++) {
+        cl::Message message;
+        ASSERT_TRUE(message.encode(static_cast<uint32_t>(i)));
+        ASSERT_TRUE(busy.first->sendMessage(message));
+    }
+
+    cl::Message message;
+    ASSERT_TRUE(message.encode(static_cast<uint32_t>(0)));
+    ASSERT_TRUE(quiet.first->sendMessage(message));
+
+    size_t busyReceived = 0;
+    size_t busyReceivedBeforeQuiet = Count;
+    bool quietReceived = false;
+
+    std::thread receiverThread([&]() {
+        auto looper = cl::Looper::Current();
+
+        auto terminateIfDone = [&]() {
+            if (busyReceived == Count && quietReceived) {
+                looper->terminate();
+            }
+        };
+
+        busy.second->messageReceivedCallback([&](cl::Message &message) {
+            uint32_t value = 0;
+            ASSERT_TRUE(message.decode(value));
+            ASSERT_EQ(value, busyReceived);
+
+            busyReceived++;
+            terminateIfDone();
+        });
+
+        quiet.second->messageReceivedCallback([&](cl::Message &message) {
+            busyReceivedBeforeQuiet = busyReceived;
+            quietReceived = true;
+            terminateIfDone();
+        });
+
+        busy.second->scheduleInLooper(looper);
+        quiet.second->scheduleInLooper(looper);
+
+        looper->loop();
+
+        busy.second->unscheduleFromLooper(looper);
+        quiet.second->unscheduleFromLooper(looper);
+    });
+
+    receiverThread.join();
+
+    /*
+     *  The rest of the ring is read in later wakeups even though the socket
+     *  has nothing more to signal
+     */
+    ASSERT_EQ(busyReceived, Count);
+    ASSERT_TRUE(quietReceived);
+    ASSERT_LE(busyReceivedBeforeQuiet, Budget);
+}
+
+#if CL_ENABLE_INSTRUMENTATION
+
+TEST(ChannelTest, Stats) {
+
+    auto channels = cl::Channel::CreateConnectedChannels();
+
+    /*
+     *  A plain, a fragmented and a spilled message
+     */
+    const size_t PayloadSizes[] = {
+        10, 10000, cl::Channel::DefaultSpillThreshold + 1,
+    };
+
+    size_t totalSize = 0;
+
+    for (auto size : PayloadSizes) {
+        cl::Message message(size);
+
+        for (size_t i = 0; i < size; i++) {
+            message.encode(static_cast<uint8_t>(i));
+        }
+
+        ASSERT_TRUE(channels.first->sendMessage(message));
+
+        totalSize += size;
+    }
+
+    std::thread receiverThread([&]() {
+        auto &channel = channels.second;
+        auto looper = cl::Looper::Current();
+
+        size_t received = 0;
+
+        channel->messageReceivedCallback([&](cl::Message &message) {
+            if (++received == 3) {
+                looper->terminate();
+            }
+        });
+
+        channel->scheduleInLooper(looper);
+        looper->loop();
+        channel->unscheduleFromLooper(looper);
+    });
+
+    receiverThread.join();
+
+    auto sent = channels.first->stats();
+    auto received = channels.second->stats();
+
+    ASSERT_EQ(sent.messagesSent, 3u);
+    ASSERT_EQ(sent.bytesSent, totalSize);
+    ASSERT_EQ(received.messagesReceived, 3u);
+    ASSERT_EQ(received.bytesReceived, totalSize);
+    ASSERT_EQ(received.messagesSent, 0u);
+}
+
+#endif
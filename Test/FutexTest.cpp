@@ -0,0 +1,57 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Futex.h"
+#include <gtest/gtest.h>
+
+#include <thread>
+
+TEST(FutexTest, WaitReturnsIfWordChanged) {
+    std::atomic<uint32_t> word(1);
+
+    ASSERT_TRUE(cl::Futex::Wait(word, 0));
+}
+
+TEST(FutexTest, WaitTimesOut) {
+    std::atomic<uint32_t> word(0);
+
+    ASSERT_FALSE(cl::Futex::Wait(word, 0, std::chrono::milliseconds(10)));
+}
+
+TEST(FutexTest, WakeWakesWaiter) {
+    std::atomic<uint32_t> word(0);
+
+    std::thread waker([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        word.store(1);
+        cl::Futex::Wake(word, 1);
+    });
+
+    while (word.load() == 0) {
+        cl::Futex::Wait(word, 0);
+    }
+
+    waker.join();
+}
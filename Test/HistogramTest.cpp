@@ -0,0 +1,95 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Histogram.h"
+
+#include <gtest/gtest.h>
+
+TEST(HistogramTest, BucketsBoundRelativeError) {
+    for (uint64_t value = 0; value < (1 << 20); value += 7) {
+        const size_t index = cl::Histogram::BucketIndex(value);
+
+        ASSERT_LT(index, cl::Histogram::BucketCount);
+
+        const uint64_t upper = cl::Histogram::BucketUpperBound(index);
+
+        ASSERT_GE(upper, value);
+        ASSERT_LE(upper - value, value / 4 + 1);
+
+        /*
+         *  Buckets are ordered by the values they hold
+         */
+        if (index > 0) {
+            ASSERT_LT(cl::Histogram::BucketUpperBound(index - 1), value);
+        }
+    }
+}
+
+TEST(HistogramTest, LargeValuesClampToLastBucket) {
+    cl::Histogram histogram;
+
+    const uint64_t large = UINT64_MAX;
+
+    ASSERT_EQ(cl::Histogram::BucketIndex(large),
+              cl::Histogram::BucketCount - 1);
+
+    histogram.record(large);
+
+    auto snapshot = histogram.snapshot();
+
+    ASSERT_EQ(snapshot.count, 1u);
+    ASSERT_EQ(snapshot.max, large);
+    ASSERT_EQ(snapshot.percentile(1.0), large);
+}
+
+TEST(HistogramTest, Percentiles) {
+    cl::Histogram histogram;
+
+    ASSERT_EQ(histogram.snapshot().percentile(0.5), 0u);
+
+    for (uint64_t value = 1; value <= 1000; value++) {
+        histogram.record(value);
+    }
+
+    auto snapshot = histogram.snapshot();
+
+    ASSERT_EQ(snapshot.count, 1000u);
+    ASSERT_EQ(snapshot.sum, 500500u);
+    ASSERT_EQ(snapshot.max, 1000u);
+    ASSERT_DOUBLE_EQ(snapshot.mean(), 500.5);
+
+    /*
+     *  Within the precision of a sub bucket
+     */
+    ASSERT_GE(snapshot.percentile(0.5), 500u);
+    ASSERT_LE(snapshot.percentile(0.5), 625u);
+
+    ASSERT_GE(snapshot.percentile(0.99), 990u);
+    ASSERT_LE(snapshot.percentile(0.99), 1000u);
+
+    histogram.reset();
+
+    ASSERT_EQ(histogram.snapshot().count, 0u);
+}
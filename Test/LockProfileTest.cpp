@@ -0,0 +1,125 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "AutoLock.h"
+#include "Lock.h"
+#include "LockProfile.h"
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <thread>
+
+#if CL_ENABLE_LOCK_PROFILING
+
+static bool LockProfileTest_Find(const char *name,
+                                 cl::LockProfile::Entry &found) {
+    for (const auto &entry : cl::LockProfile::Snapshot()) {
+        if (entry.name != nullptr && strcmp(entry.name, name) == 0) {
+            found = entry;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+TEST(LockProfileTest, UncontendedAcquisitions) {
+    cl::Lock lock("LockProfileTest.uncontended");
+
+    for (size_t i = 0; i < 10; i++) {
+        cl::AutoLock autoLock(lock);
+    }
+
+    ASSERT_TRUE(lock.tryLock());
+    lock.unlock();
+
+    cl::LockProfile::Entry entry;
+    ASSERT_TRUE(LockProfileTest_Find("LockProfileTest.uncontended", entry));
+
+    ASSERT_EQ(entry.acquisitions, 11u);
+    ASSERT_EQ(entry.contendedAcquisitions, 0u);
+    ASSERT_EQ(entry.totalWait, 0u);
+}
+
+TEST(LockProfileTest, ContendedAcquisitionsAcrossThreads) {
+    cl::Lock lock("LockProfileTest.contended");
+
+    lock.lock();
+
+    std::thread waiter([&]() {
+        cl::AutoLock autoLock(lock);
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    lock.unlock();
+
+    waiter.join();
+
+    cl::LockProfile::Entry entry;
+    ASSERT_TRUE(LockProfileTest_Find("LockProfileTest.contended", entry));
+
+    /*
+     *  The waiter exited, but its counts are still reported
+     */
+    ASSERT_EQ(entry.acquisitions, 2u);
+    ASSERT_EQ(entry.contendedAcquisitions, 1u);
+    ASSERT_GE(entry.maxWait, 1000000u);
+    ASSERT_GE(entry.maxHold, 1000000u);
+    ASSERT_GE(entry.totalWait, entry.maxWait);
+}
+
+TEST(LockProfileTest, UnnamedLocksAreKeyedByAddress) {
+    cl::Lock lock;
+
+    {
+        cl::AutoLock autoLock(lock);
+    }
+
+    bool found = false;
+
+    for (const auto &entry : cl::LockProfile::Snapshot()) {
+        if (entry.lock == &lock) {
+            ASSERT_EQ(entry.name, nullptr);
+            ASSERT_EQ(entry.acquisitions, 1u);
+            found = true;
+        }
+    }
+
+    ASSERT_TRUE(found);
+}
+
+#else
+
+TEST(LockProfileTest, EmptyWithoutProfiling) {
+    cl::Lock lock("LockProfileTest.disabled");
+
+    {
+        cl::AutoLock autoLock(lock);
+    }
+
+    ASSERT_TRUE(cl::LockProfile::Snapshot().empty());
+}
+
+#endif
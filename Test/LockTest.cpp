@@ -0,0 +1,121 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "AutoLock.h"
+#include "Lock.h"
+#include "SharedMemory.h"
+#include <gtest/gtest.h>
+
+#include <new>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+TEST(LockTest, TryLock) {
+    cl::Lock lock;
+
+    ASSERT_TRUE(lock.tryLock());
+    ASSERT_FALSE(lock.tryLock());
+
+    lock.unlock();
+
+    {
+        cl::AutoLock autoLock(lock);
+        ASSERT_FALSE(lock.tryLock());
+    }
+
+    ASSERT_TRUE(lock.tryLock());
+    lock.unlock();
+}
+
+TEST(LockTest, MutualExclusion) {
+    cl::Lock lock;
+
+    const size_t ThreadCount = 4;
+    const size_t Iterations = 100000;
+
+    size_t counter = 0;
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < ThreadCount; i++) {
+        threads.emplace_back([&]() {
+            for (size_t j = 0; j < Iterations; j++) {
+                cl::AutoLock autoLock(lock);
+                counter++;
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(counter, ThreadCount * Iterations);
+}
+
+TEST(LockTest, SharedAcrossProcesses) {
+    struct Shared {
+        cl::Lock lock;
+        uint64_t counter;
+
+        Shared() : lock(cl::Futex::ScopeShared), counter(0) {
+        }
+    };
+
+    cl::SharedMemory memory(sizeof(Shared));
+    ASSERT_TRUE(memory.isReady());
+
+    Shared *shared = new (memory.address()) Shared();
+
+    const size_t Iterations = 100000;
+
+    pid_t child = fork();
+
+    ASSERT_NE(child, -1);
+
+    auto increment = [&]() {
+        for (size_t i = 0; i < Iterations; i++) {
+            cl::AutoLock autoLock(shared->lock);
+            shared->counter++;
+        }
+    };
+
+    if (child == 0) {
+        increment();
+        _exit(0);
+    }
+
+    increment();
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    ASSERT_EQ(shared->counter, 2 * Iterations);
+
+    shared->~Shared();
+}
@@ -0,0 +1,129 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "LooperPool.h"
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <set>
+
+/*
+ *  Waits till the given number of tasks have run on the pool
+ */
+class LooperPoolTest_Latch {
+  public:
+    explicit LooperPoolTest_Latch(size_t count) : _count(count) {
+    }
+
+    void countDown() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _count--;
+        _condition.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [&]() { return _count == 0; });
+    }
+
+  private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    size_t _count;
+};
+
+TEST(LooperPoolTest, DispatchRunsOnPoolLooper) {
+    cl::LooperPool pool(4);
+
+    ASSERT_TRUE(pool.size() == 4);
+
+    const size_t TaskCount = 16;
+
+    LooperPoolTest_Latch latch(TaskCount);
+
+    std::mutex mutex;
+    std::set<cl::Looper *> loopers;
+    bool allOnCurrentLooper = true;
+
+    for (size_t i = 0; i < TaskCount; i++) {
+        pool.dispatch([&](cl::Looper *looper) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                loopers.insert(looper);
+                allOnCurrentLooper &= (looper == cl::Looper::Current());
+            }
+
+            latch.countDown();
+        });
+    }
+
+    latch.wait();
+
+    ASSERT_TRUE(allOnCurrentLooper);
+
+    /*
+     *  Round robin is the default policy
+     */
+    ASSERT_TRUE(loopers.size() == pool.size());
+}
+
+TEST(LooperPoolTest, LeastLoadedPolicy) {
+    cl::LooperPool pool(2);
+
+    pool.selectionPolicy(cl::LooperPool::LeastLoadedPolicy());
+
+    auto source = cl::LooperSource::AsTrivial();
+
+    LooperPoolTest_Latch added(1);
+
+    cl::Looper *loadedLooper = pool.dispatch([&](cl::Looper *looper) {
+        looper->addSource(source);
+        added.countDown();
+    });
+
+    added.wait();
+
+    ASSERT_TRUE(loadedLooper == pool.looper(0));
+    ASSERT_TRUE(pool.load(0) == 1);
+    ASSERT_TRUE(pool.load(1) == 0);
+
+    LooperPoolTest_Latch latch(1);
+
+    cl::Looper *selected =
+        pool.dispatch([&](cl::Looper *looper) { latch.countDown(); });
+
+    latch.wait();
+
+    ASSERT_TRUE(selected == pool.looper(1));
+
+    LooperPoolTest_Latch removed(1);
+
+    loadedLooper->post([&]() {
+        loadedLooper->removeSource(source);
+        removed.countDown();
+    });
+
+    removed.wait();
+}
@@ -23,10 +23,14 @@
 */
 
 #include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include "Looper.h"
 #include <gtest/gtest.h>
+#include <string>
 #include <thread>
+#include <vector>
 
 TEST(LooperTest, CurrentLooperAccess) {
     cl::Looper *looper = cl::Looper::Current();
@@ -136,3 +140,547 @@ TEST(LooperTest, TimerRepetition) {
 
     ASSERT_TRUE(count == 10);
 }
+
+TEST(LooperTest, BatchedDispatch) {
+
+    const int SourceCount = 16;
+
+    int count = 0;
+
+    std::thread thread([&count] {
+
+        auto looper = cl::Looper::Current();
+
+        std::vector<std::shared_ptr<cl::LooperSource>> sources;
+
+        for (int i = 0; i < SourceCount; i++) {
+            auto source = cl::LooperSource::AsTrivial();
+
+            source->setWakeFunction([&count, looper]() {
+                count++;
+
+                if (count == SourceCount) {
+                    looper->terminate();
+                }
+            });
+
+            looper->addSource(source);
+            sources.push_back(source);
+        }
+
+        /*
+         *  Signal all sources before the loop starts so they are all
+         *  reported in the same batch
+         */
+        for (auto &source : sources) {
+            source->writer()(source->writeHandle());
+        }
+
+        looper->loop();
+
+        for (auto &source : sources) {
+            looper->removeSource(source);
+        }
+    });
+
+    thread.join();
+
+    ASSERT_TRUE(count == SourceCount);
+}
+
+TEST(LooperTest, TrivialSourceCoalescesWakes) {
+
+    int count = 0;
+
+    std::thread thread([&count] {
+
+        auto looper = cl::Looper::Current();
+
+        auto source = cl::LooperSource::AsTrivial();
+
+        source->setWakeFunction([&count, looper]() {
+            count++;
+            looper->terminate();
+        });
+
+        looper->addSource(source);
+
+        /*
+         *  More wakes than a pipe could buffer. None of these must block and
+         *  all of them must be folded into a single dispatch.
+         */
+        for (int i = 0; i < 100000; i++) {
+            source->writer()(source->writeHandle());
+        }
+
+        looper->loop();
+
+        looper->removeSource(source);
+    });
+
+    thread.join();
+
+    ASSERT_TRUE(count == 1);
+}
+
+TEST(LooperTest, PostFromAnotherThread) {
+
+    const int TaskCount = 1000;
+
+    std::vector<int> order;
+
+    std::thread looperThread([&order, TaskCount] {
+
+        auto looper = cl::Looper::Current();
+
+        std::thread producerThread([&order, looper, TaskCount] {
+            for (int i = 0; i < TaskCount; i++) {
+                looper->post([&order, i]() { order.push_back(i); });
+            }
+
+            looper->post([looper]() { looper->terminate(); });
+        });
+
+        looper->loop();
+
+        producerThread.join();
+    });
+
+    looperThread.join();
+
+    ASSERT_TRUE(order.size() == TaskCount);
+
+    for (int i = 0; i < TaskCount; i++) {
+        ASSERT_TRUE(order[i] == i);
+    }
+}
+
+TEST(LooperTest, PostDelayed) {
+
+    std::vector<int> order;
+
+    std::thread looperThread([&order] {
+
+        auto looper = cl::Looper::Current();
+
+        std::chrono::steady_clock clock;
+
+        auto start = clock.now();
+
+        looper->postDelayed([&order]() { order.push_back(2); },
+                            std::chrono::milliseconds(20));
+
+        looper->postDelayed([&order, looper]() {
+            order.push_back(3);
+            looper->terminate();
+        }, std::chrono::milliseconds(30));
+
+        looper->postDelayed([&order]() { order.push_back(1); },
+                            std::chrono::milliseconds(10));
+
+        looper->post([&order]() { order.push_back(0); });
+
+        looper->loop();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            clock.now() - start);
+
+        ASSERT_TRUE(elapsed.count() >= 30);
+    });
+
+    looperThread.join();
+
+    ASSERT_TRUE(order.size() == 4);
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(order[i] == i);
+    }
+}
+
+TEST(LooperTest, WheelTimer) {
+
+    int count = 0;
+
+    std::thread timerThread([&count] {
+
+        auto looper = cl::Looper::Current();
+
+        cl::Looper::Timer terminator([looper]() { looper->terminate(); });
+
+        cl::Looper::Timer repeating;
+
+        repeating.setCallback([&]() {
+            count++;
+
+            if (count == 10) {
+                /*
+                 *  Make sure the timer does not fire after being cancelled
+                 */
+                looper->cancelTimer(repeating);
+                looper->scheduleTimer(terminator,
+                                      std::chrono::milliseconds(20));
+            }
+        });
+
+        looper->scheduleTimer(repeating, std::chrono::milliseconds(1),
+                              std::chrono::milliseconds(1));
+
+        looper->loop();
+    });
+
+    timerThread.join();
+
+    ASSERT_TRUE(count == 10);
+}
+
+TEST(LooperTest, OneShotSourceRearm) {
+
+    int count = 0;
+    int countBeforeRearm = 0;
+
+    std::thread thread([&count, &countBeforeRearm] {
+
+        auto looper = cl::Looper::Current();
+
+        auto source = cl::LooperSource::AsTrivial();
+
+        source->setRegistrationFlags(cl::LooperSource::RegisterReadable |
+                                     cl::LooperSource::RegisterOneShot);
+
+        source->setWakeFunction([&, looper]() {
+            count++;
+
+            if (count == 2) {
+                looper->terminate();
+                return;
+            }
+
+            /*
+             *  Signalling a disarmed source must not wake the looper till it
+             *  is re-armed
+             */
+            source->writer()(source->writeHandle());
+
+            looper->postDelayed(
+                [&, looper]() {
+                    countBeforeRearm = count;
+                    looper->updateSource(source);
+                },
+                std::chrono::milliseconds(20));
+        });
+
+        looper->addSource(source);
+
+        source->writer()(source->writeHandle());
+
+        looper->loop();
+
+        looper->removeSource(source);
+    });
+
+    thread.join();
+
+    ASSERT_TRUE(countBeforeRearm == 1);
+    ASSERT_TRUE(count == 2);
+}
+
+TEST(LooperTest, WritableSource) {
+
+    int writableCount = 0;
+    int readCount = 0;
+
+    std::thread thread([&writableCount, &readCount] {
+
+        auto looper = cl::Looper::Current();
+
+        int sockets[2] = {-1, -1};
+        ASSERT_TRUE(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+
+        auto source = std::make_shared<cl::LooperSource>(
+            [sockets]() {
+                return cl::LooperSource::Handles(sockets[0], sockets[0]);
+            },
+            [](cl::LooperSource::Handles handles) { close(handles.first); },
+            [&readCount](cl::LooperSource::Handle) { readCount++; }, nullptr);
+
+        source->setRegistrationFlags(cl::LooperSource::RegisterWritable);
+
+        source->setWritableHandler(
+            [&writableCount, looper](cl::LooperSource::Handle handle) {
+                writableCount++;
+
+                char byte = 'a';
+                ASSERT_TRUE(write(handle, &byte, 1) == 1);
+
+                looper->terminate();
+            });
+
+        looper->addSource(source);
+
+        looper->loop();
+
+        looper->removeSource(source);
+
+        char byte = 0;
+        ASSERT_TRUE(read(sockets[1], &byte, 1) == 1);
+        ASSERT_TRUE(byte == 'a');
+
+        close(sockets[1]);
+    });
+
+    thread.join();
+
+    ASSERT_TRUE(writableCount >= 1);
+    ASSERT_TRUE(readCount == 0);
+}
+
+TEST(LooperTest, SourcePriorities) {
+
+    std::vector<cl::LooperSource::Priority> order;
+
+    std::thread thread([&order] {
+
+        auto looper = cl::Looper::Current();
+
+        const cl::LooperSource::Priority Priorities[] = {
+            cl::LooperSource::PriorityBackground,
+            cl::LooperSource::PriorityData,
+            cl::LooperSource::PriorityControl,
+        };
+
+        std::vector<std::shared_ptr<cl::LooperSource>> sources;
+
+        for (auto priority : Priorities) {
+            auto source = cl::LooperSource::AsTrivial();
+
+            source->setPriority(priority);
+            source->setWakeFunction([&order, looper, priority]() {
+                order.push_back(priority);
+
+                if (order.size() == 3) {
+                    looper->terminate();
+                }
+            });
+
+            looper->addSource(source);
+            sources.push_back(source);
+        }
+
+        /*
+         *  Signalled in the same batch, in reverse order of priority
+         */
+        for (auto &source : sources) {
+            source->writer()(source->writeHandle());
+        }
+
+        looper->loop();
+
+        for (auto &source : sources) {
+            looper->removeSource(source);
+        }
+    });
+
+    thread.join();
+
+    ASSERT_EQ(order.size(), 3u);
+    ASSERT_EQ(order[0], cl::LooperSource::PriorityControl);
+    ASSERT_EQ(order[1], cl::LooperSource::PriorityData);
+    ASSERT_EQ(order[2], cl::LooperSource::PriorityBackground);
+}
+
+TEST(LooperTest, DispatchBudget) {
+
+    std::vector<std::string> order;
+
+    std::chrono::nanoseconds worstDataWait(0);
+
+    std::thread thread([&] {
+
+        auto looper = cl::Looper::Current();
+
+        looper->dispatchBudget(std::chrono::milliseconds(1));
+
+        auto control = cl::LooperSource::AsTrivial();
+        control->setPriority(cl::LooperSource::PriorityControl);
+
+        auto first = cl::LooperSource::AsTrivial();
+        auto second = cl::LooperSource::AsTrivial();
+
+        /*
+         *  Edge triggered sources are not signalled again, so they must be
+         *  carried over when deferred
+         */
+        const auto flags = cl::LooperSource::RegisterReadable |
+                           cl::LooperSource::RegisterEdgeTriggered;
+
+        first->setRegistrationFlags(flags);
+        second->setRegistrationFlags(flags);
+
+        auto slowHandler = [&, looper](const char *name) {
+            order.push_back(name);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+            if (order.size() == 1) {
+                control->writer()(control->writeHandle());
+            }
+
+            if (order.size() == 3) {
+                looper->terminate();
+            }
+        };
+
+        first->setWakeFunction([&]() { slowHandler("data"); });
+        second->setWakeFunction([&]() { slowHandler("data"); });
+        control->setWakeFunction([&]() { order.push_back("control"); });
+
+        looper->addSource(control);
+        looper->addSource(first);
+        looper->addSource(second);
+
+        first->writer()(first->writeHandle());
+        second->writer()(second->writeHandle());
+
+        looper->loop();
+
+        worstDataWait =
+            looper->worstDispatchWait(cl::LooperSource::PriorityData);
+
+        looper->removeSource(control);
+        looper->removeSource(first);
+        looper->removeSource(second);
+    });
+
+    thread.join();
+
+    /*
+     *  The budget is spent by the first data source. The control source
+     *  signalled by it overtakes the deferred data source.
+     */
+    ASSERT_EQ(order.size(), 3u);
+    ASSERT_EQ(order[0], "data");
+    ASSERT_EQ(order[1], "control");
+    ASSERT_EQ(order[2], "data");
+
+#if CL_ENABLE_INSTRUMENTATION
+    ASSERT_GE(worstDataWait, std::chrono::milliseconds(5));
+#endif
+}
+
+TEST(LooperTest, DeferredSourceSignalledAgain) {
+
+    size_t firstCount = 0;
+    size_t secondCount = 0;
+
+    std::thread thread([&] {
+
+        auto looper = cl::Looper::Current();
+
+        looper->dispatchBudget(std::chrono::milliseconds(1));
+
+        auto first = cl::LooperSource::AsTrivial();
+        auto second = cl::LooperSource::AsTrivial();
+
+        const auto flags = cl::LooperSource::RegisterReadable |
+                           cl::LooperSource::RegisterEdgeTriggered;
+
+        first->setRegistrationFlags(flags);
+        second->setRegistrationFlags(flags);
+
+        /*
+         *  The first source spends the budget and signals the second one
+         *  again while it is deferred. The second one must still only be
+         *  dispatched once.
+         */
+        first->setWakeFunction([&]() {
+            firstCount++;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+            if (secondCount == 0) {
+                second->writer()(second->writeHandle());
+            }
+        });
+
+        second->setWakeFunction([&, looper]() {
+            secondCount++;
+
+            looper->postDelayed([looper]() { looper->terminate(); },
+                                std::chrono::milliseconds(20));
+        });
+
+        looper->addSource(first);
+        looper->addSource(second);
+
+        first->writer()(first->writeHandle());
+        second->writer()(second->writeHandle());
+
+        looper->loop();
+
+        looper->removeSource(first);
+        looper->removeSource(second);
+    });
+
+    thread.join();
+
+    ASSERT_EQ(firstCount, 1u);
+    ASSERT_EQ(secondCount, 1u);
+}
+
+#if CL_ENABLE_INSTRUMENTATION
+
+TEST(LooperTest, Instrumentation) {
+
+    std::vector<cl::Looper::SourceStats> sourceStats;
+    cl::Looper::Stats stats;
+
+    std::thread thread([&] {
+
+        auto looper = cl::Looper::Current();
+
+        auto fast = cl::LooperSource::AsTrivial();
+        auto slow = cl::LooperSource::AsTrivial();
+
+        int count = 0;
+
+        fast->setWakeFunction([&]() { count++; });
+        slow->setWakeFunction([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+            if (++count == 2) {
+                looper->terminate();
+            }
+        });
+
+        looper->addSource(fast);
+        looper->addSource(slow);
+
+        fast->writer()(fast->writeHandle());
+        slow->writer()(slow->writeHandle());
+
+        looper->loop();
+
+        sourceStats = looper->sourceStats();
+        stats = looper->stats();
+
+        looper->removeSource(fast);
+        looper->removeSource(slow);
+    });
+
+    thread.join();
+
+    ASSERT_GE(stats.wakeups, 1u);
+    ASSERT_GE(stats.events, 2u);
+    ASSERT_EQ(stats.eventsPerWakeup.count, stats.wakeups);
+
+    /*
+     *  The source that stalled the looper the longest comes first
+     */
+    ASSERT_EQ(sourceStats.size(), 2u);
+    ASSERT_EQ(sourceStats[0].handlerTimes.count, 1u);
+    ASSERT_GE(sourceStats[0].handlerTimes.max, 5000000u);
+    ASSERT_EQ(sourceStats[1].handlerTimes.count, 1u);
+    ASSERT_LT(sourceStats[1].handlerTimes.max, sourceStats[0].handlerTimes.max);
+}
+
+#endif
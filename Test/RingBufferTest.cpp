@@ -0,0 +1,362 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "RingBuffer.h"
+#include "SharedMemory.h"
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+TEST(RingBufferTest, CapacityIsRoundedToPowerOfTwo) {
+    auto ring = cl::RingBuffer::Create(1000);
+    ASSERT_TRUE(ring != nullptr);
+    ASSERT_EQ(ring->capacity(), 1024u);
+    ASSERT_EQ(ring->maxRecordLength(), 1016u);
+}
+
+TEST(RingBufferTest, BytesWrapAround) {
+    auto ring = cl::RingBuffer::Create(64);
+    ASSERT_TRUE(ring != nullptr);
+
+    uint8_t written[48];
+    uint8_t read[48];
+
+    for (size_t round = 0; round < 10; round++) {
+        for (size_t i = 0; i < sizeof(written); i++) {
+            written[i] = static_cast<uint8_t>(round * 7 + i);
+        }
+
+        ASSERT_EQ(ring->write(written, sizeof(written)), sizeof(written));
+
+        /*
+         *  There is only room for part of a second write
+         */
+        if (round == 0) {
+            ASSERT_EQ(ring->write(written, sizeof(written)), 16u);
+            ASSERT_EQ(ring->read(read, 16), 16u);
+            ASSERT_EQ(ring->read(read, sizeof(read)), sizeof(read));
+            continue;
+        }
+
+        memset(read, 0, sizeof(read));
+        ASSERT_EQ(ring->read(read, sizeof(read)), sizeof(read));
+        ASSERT_EQ(memcmp(read, written, sizeof(read)), 0);
+    }
+
+    ASSERT_EQ(ring->read(read, sizeof(read)), 0u);
+}
+
+TEST(RingBufferTest, ReservationsAreOnlyVisibleOnceCommitted) {
+    auto ring = cl::RingBuffer::Create(256);
+
+    for (uint32_t i = 0; i < 4; i++) {
+        uint8_t *payload = ring->reserveRecord(sizeof(i));
+        ASSERT_TRUE(payload != nullptr);
+        memcpy(payload, &i, sizeof(i));
+    }
+
+    const uint8_t *payload = nullptr;
+    size_t length = 0;
+
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Empty);
+
+    ring->commit();
+
+    for (uint32_t i = 0; i < 4; i++) {
+        ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Success);
+        ASSERT_EQ(length, sizeof(i));
+
+        uint32_t value = 0;
+        memcpy(&value, payload, sizeof(value));
+        ASSERT_EQ(value, i);
+    }
+
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Empty);
+}
+
+TEST(RingBufferTest, SpaceIsOnlyFreedOnceReleased) {
+    auto ring = cl::RingBuffer::Create(64);
+
+    /*
+     *  Each record with its header takes half the ring
+     */
+    ASSERT_TRUE(ring->reserveRecord(24) != nullptr);
+    ASSERT_TRUE(ring->reserveRecord(24) != nullptr);
+    ASSERT_TRUE(ring->reserveRecord(24) == nullptr);
+    ring->commit();
+
+    const uint8_t *payload = nullptr;
+    size_t length = 0;
+
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Success);
+    ASSERT_TRUE(ring->reserveRecord(24) == nullptr);
+
+    ring->release();
+
+    ASSERT_TRUE(ring->reserveRecord(24) != nullptr);
+    ring->commit();
+
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Success);
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Success);
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Empty);
+}
+
+TEST(RingBufferTest, RecordsDoNotWrapAround) {
+    auto ring = cl::RingBuffer::Create(64);
+
+    const uint8_t *payload = nullptr;
+    size_t length = 0;
+
+    ASSERT_TRUE(ring->reserveRecord(32) != nullptr);
+    ring->commit();
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Success);
+    ring->release();
+
+    /*
+     *  Only 24 bytes are left before the end of the ring. The record is
+     *  placed at the start instead.
+     */
+    uint8_t *reserved = ring->reserveRecord(32);
+    ASSERT_TRUE(reserved != nullptr);
+    memset(reserved, 'x', 32);
+    ring->commit();
+
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Success);
+    ASSERT_EQ(payload, reserved);
+    ASSERT_EQ(length, 32u);
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Empty);
+}
+
+TEST(RingBufferTest, RecordsCarryTags) {
+    auto ring = cl::RingBuffer::Create(256);
+
+    /*
+     *  The cursors must be cache line aligned on the heap
+     */
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(ring.get()) % 64, 0u);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        ASSERT_TRUE(ring->reserveRecord(i, i + 7) != nullptr);
+    }
+
+    ring->commit();
+
+    const uint8_t *payload = nullptr;
+    size_t length = 0;
+    uint32_t tag = 0;
+
+    /*
+     *  Records that are unpeeked are peeked again
+     */
+    ASSERT_EQ(ring->peekRecord(payload, length, tag), cl::RingBuffer::Success);
+    ASSERT_EQ(tag, 7u);
+    ring->release();
+
+    ASSERT_EQ(ring->peekRecord(payload, length, tag), cl::RingBuffer::Success);
+    ASSERT_EQ(tag, 8u);
+    ring->unpeek();
+
+    for (uint32_t i = 1; i < 3; i++) {
+        ASSERT_EQ(ring->peekRecord(payload, length, tag),
+                  cl::RingBuffer::Success);
+        ASSERT_EQ(length, i);
+        ASSERT_EQ(tag, i + 7);
+    }
+
+    ASSERT_EQ(ring->peekRecord(payload, length, tag), cl::RingBuffer::Empty);
+}
+
+TEST(RingBufferTest, ProducerFindsIdleConsumer) {
+    auto ring = cl::RingBuffer::Create(256);
+
+    const uint8_t *payload = nullptr;
+    size_t length = 0;
+
+    /*
+     *  Only the first commit after the consumer drained the ring finds it
+     *  idle
+     */
+    ASSERT_TRUE(ring->reserveRecord(8) != nullptr);
+    ASSERT_TRUE(ring->commitAndCheckIdle());
+
+    ASSERT_TRUE(ring->reserveRecord(8) != nullptr);
+    ASSERT_FALSE(ring->commitAndCheckIdle());
+
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Success);
+    ring->release();
+    ASSERT_FALSE(ring->drained());
+
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Success);
+    ring->release();
+    ASSERT_TRUE(ring->drained());
+
+    ASSERT_TRUE(ring->reserveRecord(8) != nullptr);
+    ASSERT_TRUE(ring->commitAndCheckIdle());
+}
+
+TEST(RingBufferTest, ProducerFindsConsumerIdleAfterPadding) {
+    auto ring = cl::RingBuffer::Create(64);
+
+    const uint8_t *payload = nullptr;
+    size_t length = 0;
+
+    ASSERT_TRUE(ring->reserveRecord(48) != nullptr);
+    ring->commit();
+
+    /*
+     *  The second record does not fit before the end of the ring. Only the
+     *  padding is committed.
+     */
+    ASSERT_TRUE(ring->reserveRecord(48) == nullptr);
+    ring->commit();
+
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Success);
+    ring->release();
+
+    ASSERT_EQ(ring->peekRecord(payload, length), cl::RingBuffer::Empty);
+    ASSERT_TRUE(ring->drained());
+
+    /*
+     *  The consumer skipped the padding before it went idle
+     */
+    ASSERT_TRUE(ring->reserveRecord(48) != nullptr);
+    ASSERT_TRUE(ring->commitAndCheckIdle());
+}
+
+TEST(RingBufferTest, SharedMemoryPeers) {
+    cl::SharedMemory memory(cl::RingBuffer::RegionSize(4096));
+    ASSERT_TRUE(memory.isReady());
+
+    auto producer = cl::RingBuffer::Create(memory.address(), memory.size());
+    ASSERT_TRUE(producer != nullptr);
+    ASSERT_EQ(producer->capacity(), 4096u);
+
+    /*
+     *  The consumer maps the region separately as a peer process would
+     */
+    auto mapping = cl::SharedMemory::Map(dup(memory.handle()));
+    ASSERT_TRUE(mapping->isReady());
+
+    auto consumer = cl::RingBuffer::Attach(mapping->address(), mapping->size());
+    ASSERT_TRUE(consumer != nullptr);
+    ASSERT_EQ(consumer->capacity(), 4096u);
+
+    const char hello[] = "hello";
+    memcpy(producer->reserveRecord(sizeof(hello)), hello, sizeof(hello));
+    producer->commit();
+
+    const uint8_t *payload = nullptr;
+    size_t length = 0;
+
+    ASSERT_EQ(consumer->peekRecord(payload, length), cl::RingBuffer::Success);
+    ASSERT_EQ(length, sizeof(hello));
+    ASSERT_EQ(memcmp(payload, hello, sizeof(hello)), 0);
+}
+
+TEST(RingBufferTest, RejectsCorruptRegions) {
+    cl::SharedMemory memory(cl::RingBuffer::RegionSize(4096));
+    ASSERT_TRUE(memory.isReady());
+
+    ASSERT_TRUE(cl::RingBuffer::Attach(memory.address(), memory.size()) ==
+                nullptr);
+
+    auto producer = cl::RingBuffer::Create(memory.address(), memory.size());
+    auto consumer = cl::RingBuffer::Attach(memory.address(), memory.size());
+    ASSERT_TRUE(consumer != nullptr);
+
+    memset(producer->reserveRecord(16), 0, 16);
+    producer->commit();
+
+    /*
+     *  Scribble over the record length the way a misbehaving peer might
+     */
+    uint32_t length = 1 << 20;
+    memcpy(static_cast<uint8_t *>(memory.address()) +
+               (memory.size() - producer->capacity()),
+           &length, sizeof(length));
+
+    const uint8_t *payload = nullptr;
+    size_t peekedLength = 0;
+
+    ASSERT_EQ(consumer->peekRecord(payload, peekedLength),
+              cl::RingBuffer::Corrupt);
+}
+
+TEST(RingBufferTest, ProducerAndConsumerThreads) {
+    auto ring = cl::RingBuffer::Create(4096);
+
+    const uint64_t Count = 100000;
+
+    std::thread producer([&]() {
+        uint64_t next = 0;
+
+        while (next < Count) {
+            uint8_t *payload = ring->reserveRecord(sizeof(next));
+
+            if (payload == nullptr) {
+                ring->commit();
+                std::this_thread::yield();
+                continue;
+            }
+
+            memcpy(payload, &next, sizeof(next));
+            next++;
+
+            if (next % 16 == 0) {
+                ring->commit();
+            }
+        }
+
+        ring->commit();
+    });
+
+    uint64_t expected = 0;
+
+    while (expected < Count) {
+        const uint8_t *payload = nullptr;
+        size_t length = 0;
+
+        auto status = ring->peekRecord(payload, length);
+        ASSERT_NE(status, cl::RingBuffer::Corrupt);
+
+        if (status == cl::RingBuffer::Empty) {
+            ring->release();
+            std::this_thread::yield();
+            continue;
+        }
+
+        uint64_t value = 0;
+        ASSERT_EQ(length, sizeof(value));
+        memcpy(&value, payload, sizeof(value));
+        ASSERT_EQ(value, expected);
+        expected++;
+    }
+
+    ring->release();
+    producer.join();
+}
@@ -0,0 +1,107 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "SeqLock.h"
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+struct SeqLockTest_Config {
+    uint64_t version;
+    uint32_t values[5];
+    uint64_t checksum;
+};
+
+static SeqLockTest_Config SeqLockTest_MakeConfig(uint64_t version) {
+    SeqLockTest_Config config;
+
+    config.version = version;
+    config.checksum = version;
+
+    for (size_t i = 0; i < 5; i++) {
+        config.values[i] = static_cast<uint32_t>(version * (i + 1));
+        config.checksum += config.values[i];
+    }
+
+    return config;
+}
+
+static bool SeqLockTest_IsConsistent(const SeqLockTest_Config &config) {
+    uint64_t checksum = config.version;
+
+    for (size_t i = 0; i < 5; i++) {
+        checksum += config.values[i];
+    }
+
+    return checksum == config.checksum;
+}
+
+TEST(SeqLockTest, LoadAndStore) {
+    cl::SeqLock<SeqLockTest_Config> lock(SeqLockTest_MakeConfig(1));
+
+    ASSERT_EQ(lock.load().version, 1u);
+
+    lock.store(SeqLockTest_MakeConfig(2));
+
+    SeqLockTest_Config config;
+    ASSERT_TRUE(lock.tryLoad(config));
+    ASSERT_EQ(config.version, 2u);
+    ASSERT_TRUE(SeqLockTest_IsConsistent(config));
+}
+
+TEST(SeqLockTest, ReadersNeverSeeTornValues) {
+    cl::SeqLock<SeqLockTest_Config> lock(SeqLockTest_MakeConfig(0));
+
+    const uint64_t Versions = 100000;
+
+    std::atomic<bool> done(false);
+    std::vector<std::thread> readers;
+
+    for (size_t i = 0; i < 2; i++) {
+        readers.emplace_back([&]() {
+            uint64_t last = 0;
+
+            while (!done) {
+                auto config = lock.load();
+
+                ASSERT_TRUE(SeqLockTest_IsConsistent(config));
+                ASSERT_GE(config.version, last);
+
+                last = config.version;
+            }
+        });
+    }
+
+    for (uint64_t version = 1; version <= Versions; version++) {
+        lock.store(SeqLockTest_MakeConfig(version));
+    }
+
+    done = true;
+
+    for (auto &reader : readers) {
+        reader.join();
+    }
+}
@@ -25,7 +25,20 @@
 #include <gtest/gtest.h>
 #include "Server.h"
 #include "Looper.h"
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <thread>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <vector>
 
 TEST(ServerTest, SimpleInitialization) {
     cl::Server server("/tmp/corelib_test");
@@ -38,3 +51,423 @@ TEST(ServerTest, AccessListenerSource) {
 
     ASSERT_TRUE(server.clientConnectionsSource().get() != nullptr);
 }
+
+TEST(ServerTest, ShardChannelsInLooperPool) {
+    auto endpoint = "/tmp/corelib_test_for_looper_pool";
+
+    const size_t ClientCount = 8;
+
+    cl::LooperPool pool(2);
+
+    cl::Server server(endpoint);
+    ASSERT_TRUE(server.isListening());
+
+    server.channelLooperPool(&pool);
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::pair<std::shared_ptr<cl::Channel>, cl::Looper *>>
+        accepted;
+
+    server.channelAvailabilityCallback(
+        [&](std::shared_ptr<cl::Channel> channel) {
+            std::lock_guard<std::mutex> lock(mutex);
+            accepted.push_back(std::make_pair(channel, cl::Looper::Current()));
+            condition.notify_all();
+        });
+
+    cl::Looper *acceptLooper = nullptr;
+
+    std::thread acceptThread([&] {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            acceptLooper = cl::Looper::Current();
+            acceptLooper->addSource(server.clientConnectionsSource());
+            condition.notify_all();
+        }
+
+        acceptLooper->loop();
+        acceptLooper->removeSource(server.clientConnectionsSource());
+    });
+
+    std::vector<std::unique_ptr<cl::Channel>> clients;
+
+    /*
+     *  The listen backlog is small, so retry till the accept looper catches
+     *  up with the clients
+     */
+    for (size_t i = 0; i < ClientCount; i++) {
+        std::unique_ptr<cl::Channel> client(new cl::Channel(endpoint));
+
+        for (int attempt = 0; attempt < 100; attempt++) {
+            if (client->tryConnect()) {
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        EXPECT_TRUE(client->isConnected());
+        clients.push_back(std::move(client));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&]() { return accepted.size() == ClientCount; });
+    }
+
+    acceptLooper->post([&]() { acceptLooper->terminate(); });
+    acceptThread.join();
+
+    /*
+     *  Round robin must have used both loopers of the pool
+     */
+    std::set<cl::Looper *> loopers;
+
+    for (auto &entry : accepted) {
+        ASSERT_TRUE(entry.second == pool.looper(0) ||
+                    entry.second == pool.looper(1));
+        loopers.insert(entry.second);
+    }
+
+    ASSERT_TRUE(loopers.size() == 2);
+
+    /*
+     *  Unschedule the channels on their loopers before collecting them
+     */
+    std::atomic<size_t> unscheduled(0);
+
+    for (auto &entry : accepted) {
+        auto channel = entry.first;
+        auto looper = entry.second;
+
+        looper->post([channel, looper, &unscheduled, &mutex, &condition]() {
+            channel->unscheduleFromLooper(looper);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            unscheduled++;
+            condition.notify_all();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&]() { return unscheduled == ClientCount; });
+}
+
+static int ServerTest_ConnectClient(const char *endpoint) {
+    int handle = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+
+    if (handle == -1) {
+        return -1;
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, endpoint);
+
+    if (connect(handle, (const struct sockaddr *)&addr,
+                (socklen_t)SUN_LEN(&addr)) == -1) {
+        close(handle);
+        return -1;
+    }
+
+    return handle;
+}
+
+TEST(ServerTest, AcceptConnectionStorm) {
+    auto endpoint = "/tmp/corelib_test_for_connection_storm";
+
+    /*
+     *  Each connection needs a descriptor on either end. Scale down if the
+     *  descriptor limit does not allow for all of them.
+     */
+    struct rlimit limit = {0};
+    ASSERT_TRUE(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+    struct rlimit raisedLimit = limit;
+    raisedLimit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &raisedLimit);
+    getrlimit(RLIMIT_NOFILE, &raisedLimit);
+
+    const size_t ClientCount =
+        std::min<size_t>(10000, (raisedLimit.rlim_cur - 512) / 2);
+
+    cl::Server server(endpoint);
+    ASSERT_TRUE(server.isListening());
+
+    std::vector<std::shared_ptr<cl::Channel>> accepted;
+
+    cl::Looper *looper = nullptr;
+    std::atomic<bool> looperReady(false);
+
+    server.channelAvailabilityCallback(
+        [&](std::shared_ptr<cl::Channel> channel) {
+            accepted.push_back(channel);
+
+            if (accepted.size() == ClientCount) {
+                looper->terminate();
+            }
+        });
+
+    std::thread serverThread([&] {
+        looper = cl::Looper::Current();
+        looper->addSource(server.clientConnectionsSource());
+        looperReady = true;
+        looper->loop();
+        looper->removeSource(server.clientConnectionsSource());
+    });
+
+    while (!looperReady) {
+        std::this_thread::yield();
+    }
+
+    /*
+     *  Connect from a few threads at once. Connects block while the backlog
+     *  is full.
+     */
+    const size_t ThreadCount = 4;
+
+    std::vector<std::vector<int>> clients(ThreadCount);
+    std::vector<std::thread> clientThreads;
+
+    for (size_t i = 0; i < ThreadCount; i++) {
+        clientThreads.emplace_back([&, i] {
+            for (size_t j = i; j < ClientCount; j += ThreadCount) {
+                clients[i].push_back(ServerTest_ConnectClient(endpoint));
+            }
+        });
+    }
+
+    for (auto &thread : clientThreads) {
+        thread.join();
+    }
+
+    serverThread.join();
+
+    ASSERT_TRUE(accepted.size() == ClientCount);
+
+    for (auto &handles : clients) {
+        for (auto handle : handles) {
+            ASSERT_TRUE(handle != -1);
+            close(handle);
+        }
+    }
+
+    accepted.clear();
+
+    setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+TEST(ServerTest, ShedConnectionsOnDescriptorExhaustion) {
+    auto endpoint = "/tmp/corelib_test_for_descriptor_exhaustion";
+
+    const size_t ClientCount = 4;
+
+    cl::Server server(endpoint);
+    ASSERT_TRUE(server.isListening());
+
+    size_t acceptedCount = 0;
+
+    server.channelAvailabilityCallback(
+        [&](std::shared_ptr<cl::Channel> channel) { acceptedCount++; });
+
+    std::thread serverThread([&] {
+        auto looper = cl::Looper::Current();
+        looper->addSource(server.clientConnectionsSource());
+
+        int clients[ClientCount];
+
+        for (size_t i = 0; i < ClientCount; i++) {
+            clients[i] = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+            ASSERT_TRUE(clients[i] != -1);
+        }
+
+        /*
+         *  Use up every descriptor the process is allowed
+         */
+        struct rlimit limit = {0};
+        ASSERT_TRUE(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+        int probe = dup(0);
+        ASSERT_TRUE(probe != -1);
+        close(probe);
+
+        struct rlimit lowLimit = limit;
+        lowLimit.rlim_cur = probe + 16;
+        ASSERT_TRUE(setrlimit(RLIMIT_NOFILE, &lowLimit) == 0);
+
+        std::vector<int> filler;
+
+        while (true) {
+            int handle = dup(0);
+
+            if (handle == -1) {
+                break;
+            }
+
+            filler.push_back(handle);
+        }
+
+        /*
+         *  Connecting needs no new descriptors on the client side. The
+         *  server cannot accept these and must shed them instead of
+         *  crashing or spinning.
+         */
+        struct sockaddr_un addr = {0};
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, endpoint);
+
+        for (size_t i = 0; i < ClientCount; i++) {
+            ASSERT_TRUE(connect(clients[i], (const struct sockaddr *)&addr,
+                                (socklen_t)SUN_LEN(&addr)) == 0);
+        }
+
+        looper->postDelayed([looper]() { looper->terminate(); },
+                            std::chrono::milliseconds(50));
+        looper->loop();
+
+        for (size_t i = 0; i < ClientCount; i++) {
+            char byte = 0;
+            ASSERT_TRUE(recv(clients[i], &byte, 1, MSG_DONTWAIT) == 0);
+            close(clients[i]);
+        }
+
+        for (auto handle : filler) {
+            close(handle);
+        }
+
+        ASSERT_TRUE(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+        ASSERT_TRUE(acceptedCount == 0);
+
+        /*
+         *  The server must recover once descriptors are available again
+         */
+        int client = ServerTest_ConnectClient(endpoint);
+        ASSERT_TRUE(client != -1);
+
+        looper->postDelayed([looper]() { looper->terminate(); },
+                            std::chrono::milliseconds(50));
+        looper->loop();
+
+        ASSERT_TRUE(acceptedCount == 1);
+
+        close(client);
+
+        looper->removeSource(server.clientConnectionsSource());
+    });
+
+    serverThread.join();
+}
+
+TEST(ServerTest, PauseAcceptingWithoutReserveDescriptor) {
+    auto endpoint = "/tmp/corelib_test_for_missing_reserve";
+
+    const size_t ClientCount = 4;
+
+    std::thread serverThread([&] {
+        auto looper = cl::Looper::Current();
+
+        int clients[ClientCount];
+
+        for (size_t i = 0; i < ClientCount; i++) {
+            clients[i] = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+            ASSERT_TRUE(clients[i] != -1);
+        }
+
+        struct rlimit limit = {0};
+        ASSERT_TRUE(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+        int probe = dup(0);
+        ASSERT_TRUE(probe != -1);
+        close(probe);
+
+        struct rlimit lowLimit = limit;
+        lowLimit.rlim_cur = probe + 16;
+        ASSERT_TRUE(setrlimit(RLIMIT_NOFILE, &lowLimit) == 0);
+
+        std::vector<int> filler;
+
+        while (true) {
+            int handle = dup(0);
+
+            if (handle == -1) {
+                break;
+            }
+
+            filler.push_back(handle);
+        }
+
+        /*
+         *  Leave only the descriptor for the listening socket, so that the
+         *  server has no reserve to shed connections with
+         */
+        close(filler.back());
+        filler.pop_back();
+
+        size_t acceptedCount = 0;
+
+        {
+            cl::Server server(endpoint);
+            ASSERT_TRUE(server.isListening());
+
+            server.channelAvailabilityCallback(
+                [&](std::shared_ptr<cl::Channel> channel) {
+                    acceptedCount++;
+                });
+
+            looper->addSource(server.clientConnectionsSource());
+
+            struct sockaddr_un addr = {0};
+            addr.sun_family = AF_UNIX;
+            strcpy(addr.sun_path, endpoint);
+
+            for (size_t i = 0; i < ClientCount; i++) {
+                ASSERT_TRUE(connect(clients[i],
+                                    (const struct sockaddr *)&addr,
+                                    (socklen_t)SUN_LEN(&addr)) == 0);
+            }
+
+            const auto before = looper->stats();
+
+            looper->postDelayed([looper]() { looper->terminate(); },
+                                std::chrono::milliseconds(50));
+            looper->loop();
+
+            ASSERT_TRUE(acceptedCount == 0);
+
+#if CL_ENABLE_INSTRUMENTATION
+            /*
+             *  The looper must not wake up for the pending connections in
+             *  a loop while it cannot accept them
+             */
+            const auto after = looper->stats();
+            ASSERT_LT(after.wakeups - before.wakeups, 50u);
+#endif
+
+            /*
+             *  The connections are still pending and are accepted once
+             *  descriptors are available again
+             */
+            for (auto handle : filler) {
+                close(handle);
+            }
+
+            ASSERT_TRUE(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+            looper->postDelayed([looper]() { looper->terminate(); },
+                                std::chrono::milliseconds(50));
+            looper->loop();
+
+            ASSERT_TRUE(acceptedCount == ClientCount);
+
+            looper->removeSource(server.clientConnectionsSource());
+        }
+
+        for (size_t i = 0; i < ClientCount; i++) {
+            close(clients[i]);
+        }
+    });
+
+    serverThread.join();
+}
@@ -0,0 +1,159 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "SharedLock.h"
+#include "SharedMemory.h"
+#include <gtest/gtest.h>
+
+#include <new>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+TEST(SharedLockTest, ReadersShareWritersExclude) {
+    cl::SharedLock lock;
+
+    std::atomic<size_t> readers(0);
+    std::atomic<bool> writersOverlapped(false);
+    std::atomic<bool> writing(false);
+
+    const size_t ThreadCount = 4;
+    const size_t Iterations = 20000;
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < ThreadCount; i++) {
+        threads.emplace_back([&, i]() {
+            for (size_t j = 0; j < Iterations; j++) {
+                if ((i + j) % 8 == 0) {
+                    cl::AutoExclusiveLock autoLock(lock);
+
+                    if (writing.exchange(true) || readers.load() != 0) {
+                        writersOverlapped = true;
+                    }
+
+                    writing = false;
+                    continue;
+                }
+
+                cl::AutoSharedLock autoLock(lock);
+
+                readers.fetch_add(1);
+
+                if (writing.load()) {
+                    writersOverlapped = true;
+                }
+
+                readers.fetch_sub(1);
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_FALSE(writersOverlapped);
+}
+
+TEST(SharedLockTest, WaitingWriterHoldsOffNewReaders) {
+    cl::SharedLock lock;
+
+    lock.lockShared();
+
+    std::atomic<bool> written(false);
+
+    std::thread writer([&]() {
+        cl::AutoExclusiveLock autoLock(lock);
+        written = true;
+    });
+
+    /*
+     *  Give the writer time to start waiting for the reader
+     */
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::thread reader([&]() {
+        cl::AutoSharedLock autoLock(lock);
+        ASSERT_TRUE(written);
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    ASSERT_FALSE(written);
+    lock.unlockShared();
+
+    writer.join();
+    reader.join();
+}
+
+TEST(SharedLockTest, SharedAcrossProcesses) {
+    struct Shared {
+        cl::SharedLock lock;
+        uint64_t values[2];
+
+        Shared() : lock(cl::Futex::ScopeShared), values{0, 0} {
+        }
+    };
+
+    cl::SharedMemory memory(sizeof(Shared));
+    ASSERT_TRUE(memory.isReady());
+
+    Shared *shared = new (memory.address()) Shared();
+
+    const size_t Iterations = 20000;
+
+    pid_t child = fork();
+
+    ASSERT_NE(child, -1);
+
+    if (child == 0) {
+        for (size_t i = 0; i < Iterations; i++) {
+            cl::AutoExclusiveLock autoLock(shared->lock);
+            shared->values[0]++;
+            shared->values[1]++;
+        }
+
+        _exit(0);
+    }
+
+    bool consistent = true;
+
+    for (size_t i = 0; i < Iterations; i++) {
+        cl::AutoSharedLock autoLock(shared->lock);
+        consistent = consistent && shared->values[0] == shared->values[1];
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    ASSERT_TRUE(consistent);
+    ASSERT_EQ(shared->values[0], Iterations);
+
+    shared->~Shared();
+}
@@ -0,0 +1,192 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "SharedMemoryArena.h"
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+TEST(SharedMemoryArenaTest, SizeClassesAndReuse) {
+    auto arena = cl::SharedMemoryArena::Create();
+    ASSERT_TRUE(arena != nullptr);
+    ASSERT_EQ(arena->regionCount(), 1u);
+
+    auto small = arena->allocate(1);
+    auto odd = arena->allocate(100);
+    auto large = arena->allocate(cl::SharedMemoryArena::MaxBlockSize());
+
+    ASSERT_NE(small, cl::SharedMemoryArena::InvalidBlock);
+    ASSERT_NE(odd, cl::SharedMemoryArena::InvalidBlock);
+    ASSERT_NE(large, cl::SharedMemoryArena::InvalidBlock);
+
+    ASSERT_EQ(arena->size(small), 64u);
+    ASSERT_EQ(arena->size(odd), 128u);
+    ASSERT_EQ(arena->size(large), cl::SharedMemoryArena::MaxBlockSize());
+
+    ASSERT_EQ(arena->allocate(cl::SharedMemoryArena::MaxBlockSize() + 1),
+              cl::SharedMemoryArena::InvalidBlock);
+
+    memset(arena->address(odd), 'x', arena->size(odd));
+    ASSERT_EQ(arena->address(small)[0], 0);
+
+    arena->free(odd);
+    ASSERT_EQ(arena->allocate(128), odd);
+
+    /*
+     *  A freed block only comes back for its own size class
+     */
+    arena->free(small);
+    ASSERT_NE(arena->allocate(128), small);
+    ASSERT_EQ(arena->allocate(64), small);
+}
+
+TEST(SharedMemoryArenaTest, GrowsByRegions) {
+    const size_t RegionSize = 2 * cl::SharedMemoryArena::MaxBlockSize();
+
+    auto arena = cl::SharedMemoryArena::Create(RegionSize, 2);
+    ASSERT_TRUE(arena != nullptr);
+
+    /*
+     *  The header takes the front of each region, so only one largest
+     *  block fits in each
+     */
+    const size_t size = cl::SharedMemoryArena::MaxBlockSize();
+
+    auto first = arena->allocate(size);
+    auto second = arena->allocate(size);
+
+    ASSERT_NE(first, cl::SharedMemoryArena::InvalidBlock);
+    ASSERT_NE(second, cl::SharedMemoryArena::InvalidBlock);
+    ASSERT_EQ(arena->regionCount(), 2u);
+
+    ASSERT_EQ(arena->allocate(size), cl::SharedMemoryArena::InvalidBlock);
+
+    arena->free(first);
+    ASSERT_EQ(arena->allocate(size), first);
+}
+
+TEST(SharedMemoryArenaTest, PeersShareBlocks) {
+    auto arena = cl::SharedMemoryArena::Create();
+    ASSERT_TRUE(arena != nullptr);
+
+    auto peer = cl::SharedMemoryArena::Attach();
+
+    auto block = arena->allocate(256);
+    ASSERT_NE(block, cl::SharedMemoryArena::InvalidBlock);
+
+    /*
+     *  Blocks in regions the peer has not mapped yet are not usable
+     */
+    ASSERT_EQ(peer->address(block), nullptr);
+
+    ASSERT_TRUE(peer->mapRegion(dup(arena->regionHandle(0))));
+    ASSERT_FALSE(peer->mapRegion(dup(arena->regionHandle(0))));
+
+    strcpy(reinterpret_cast<char *>(arena->address(block)), "hello");
+    ASSERT_STREQ(reinterpret_cast<char *>(peer->address(block)), "hello");
+    ASSERT_EQ(peer->size(block), 256u);
+
+    /*
+     *  Peers cannot allocate, but what they free goes back to the owner
+     */
+    ASSERT_EQ(peer->allocate(64), cl::SharedMemoryArena::InvalidBlock);
+
+    peer->free(block);
+    ASSERT_EQ(arena->allocate(256), block);
+}
+
+TEST(SharedMemoryArenaTest, InvalidBlocksAreRejected) {
+    auto arena = cl::SharedMemoryArena::Create();
+    ASSERT_TRUE(arena != nullptr);
+
+    auto block = arena->allocate(64);
+
+    ASSERT_EQ(arena->address(cl::SharedMemoryArena::InvalidBlock), nullptr);
+    ASSERT_EQ(arena->address(block + 1), nullptr);
+    ASSERT_EQ(arena->address(block | (1ULL << 56)), nullptr);
+    ASSERT_EQ(arena->address(~0ULL), nullptr);
+    ASSERT_EQ(arena->size(~0ULL), 0u);
+
+    /*
+     *  Freeing garbage must leave the free lists alone
+     */
+    arena->free(block + 1);
+    arena->free(~0ULL);
+
+    ASSERT_NE(arena->allocate(64), block);
+}
+
+TEST(SharedMemoryArenaTest, ConcurrentAllocateAndFree) {
+    auto arena = cl::SharedMemoryArena::Create();
+    ASSERT_TRUE(arena != nullptr);
+
+    const size_t ThreadCount = 4;
+    const size_t Iterations = 10000;
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < ThreadCount; i++) {
+        threads.emplace_back([&, i]() {
+            std::vector<cl::SharedMemoryArena::Block> blocks;
+
+            for (size_t j = 0; j < Iterations; j++) {
+                auto block = arena->allocate(64 << (j % 4));
+                ASSERT_NE(block, cl::SharedMemoryArena::InvalidBlock);
+
+                /*
+                 *  Nobody else may be handed the same block while it is
+                 *  held
+                 */
+                memset(arena->address(block), static_cast<int>(i),
+                       arena->size(block));
+                blocks.push_back(block);
+
+                if (blocks.size() == 8) {
+                    for (auto held : blocks) {
+                        auto bytes = arena->address(held);
+                        ASSERT_EQ(bytes[0], i);
+                        ASSERT_EQ(bytes[arena->size(held) - 1], i);
+                        arena->free(held);
+                    }
+
+                    blocks.clear();
+                }
+            }
+
+            for (auto held : blocks) {
+                arena->free(held);
+            }
+        });
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(arena->regionCount(), 1u);
+}
@@ -0,0 +1,155 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#include "Looper.h"
+#include "SharedMemoryRing.h"
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+static std::unique_ptr<cl::SharedMemoryRing>
+SharedMemoryRingTest_OpenProducer(const cl::SharedMemoryRing &consumer) {
+    return cl::SharedMemoryRing::Open(dup(consumer.memoryHandle()),
+                                      dup(consumer.doorbellHandle()));
+}
+
+/*
+ *  Services the consumer on a looper thread till the expected number of
+ *  records has been read
+ */
+static void SharedMemoryRingTest_Consume(cl::SharedMemoryRing &consumer,
+                                         uint64_t count,
+                                         std::function<void(void)> produce) {
+    cl::Looper *looper = nullptr;
+    std::atomic<bool> looperReady(false);
+
+    uint64_t expected = 0;
+
+    std::thread consumerThread([&]() {
+        looper = cl::Looper::Current();
+
+        consumer.recordHandler([&](const uint8_t *payload, size_t length) {
+            uint64_t value = 0;
+            ASSERT_EQ(length, sizeof(value));
+            memcpy(&value, payload, sizeof(value));
+            ASSERT_EQ(value, expected);
+
+            if (++expected == count) {
+                looper->terminate();
+            }
+        });
+
+        looper->addSource(consumer.source());
+        looperReady = true;
+        looper->loop();
+        looper->removeSource(consumer.source());
+    });
+
+    while (!looperReady) {
+        std::this_thread::yield();
+    }
+
+    produce();
+
+    consumerThread.join();
+
+    ASSERT_EQ(expected, count);
+}
+
+TEST(SharedMemoryRingTest, RecordsWakeTheConsumerLooper) {
+    auto consumer = cl::SharedMemoryRing::Create(4096);
+    ASSERT_TRUE(consumer != nullptr);
+    ASSERT_EQ(consumer->capacity(), 4096u);
+
+    consumer->readBudget(8);
+
+    auto producer = SharedMemoryRingTest_OpenProducer(*consumer);
+    ASSERT_TRUE(producer != nullptr);
+
+    const uint64_t Count = 50000;
+
+    SharedMemoryRingTest_Consume(*consumer, Count, [&]() {
+        for (uint64_t i = 0; i < Count; i++) {
+            while (!producer->write(reinterpret_cast<const uint8_t *>(&i),
+                                    sizeof(i))) {
+                std::this_thread::yield();
+            }
+        }
+    });
+}
+
+TEST(SharedMemoryRingTest, ProducerInAnotherProcess) {
+    auto consumer = cl::SharedMemoryRing::Create(4096);
+    ASSERT_TRUE(consumer != nullptr);
+
+    const uint64_t Count = 10000;
+
+    /*
+     *  Fork before the consumer looper thread is started. The producer
+     *  waits for space till the consumer gets going.
+     */
+    pid_t child = fork();
+
+    ASSERT_NE(child, -1);
+
+    if (child == 0) {
+        auto producer = SharedMemoryRingTest_OpenProducer(*consumer);
+
+        if (producer == nullptr) {
+            _exit(1);
+        }
+
+        for (uint64_t i = 0; i < Count; i++) {
+            while (!producer->write(reinterpret_cast<const uint8_t *>(&i),
+                                    sizeof(i))) {
+                usleep(100);
+            }
+        }
+
+        _exit(0);
+    }
+
+    SharedMemoryRingTest_Consume(*consumer, Count, []() {});
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST(SharedMemoryRingTest, OpenRejectsForeignRegions) {
+    cl::SharedMemory memory(4096);
+    ASSERT_TRUE(memory.isReady());
+
+    auto consumer = cl::SharedMemoryRing::Create(4096);
+
+    auto producer = cl::SharedMemoryRing::Open(
+        dup(memory.handle()), dup(consumer->doorbellHandle()));
+
+    ASSERT_TRUE(producer == nullptr);
+}
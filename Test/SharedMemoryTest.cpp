@@ -25,9 +25,98 @@
 #include "SharedMemory.h"
 #include <gtest/gtest.h>
 
+#include <string.h>
+#include <unistd.h>
+
 TEST(SharedMemoryTest, SimpleInitialization) {
     cl::SharedMemory memory(1024);
 
     ASSERT_TRUE(memory.isReady());
     ASSERT_TRUE(memory.size() == 1024);
 }
+
+TEST(SharedMemoryTest, HugePagesAndPrefault) {
+    const size_t Size = 4 << 20;
+
+    cl::SharedMemory memory(Size, cl::SharedMemory::OptionHugePages |
+                                      cl::SharedMemory::OptionPrefault);
+
+    ASSERT_TRUE(memory.isReady());
+    ASSERT_TRUE(memory.isWritable());
+    ASSERT_TRUE(memory.size() >= Size);
+
+    auto bytes = static_cast<uint8_t *>(memory.address());
+
+    ASSERT_EQ(bytes[0], 0);
+    ASSERT_EQ(bytes[Size - 1], 0);
+
+    bytes[Size - 1] = 1;
+}
+
+TEST(SharedMemoryTest, SealedRegionIsReadOnlyForReceivers) {
+    cl::SharedMemory memory(1024);
+    ASSERT_TRUE(memory.isReady());
+
+    memset(memory.address(), 'x', 1024);
+
+    const cl::SharedMemory::Seals seals = cl::SharedMemory::SealShrink |
+                                          cl::SharedMemory::SealGrow |
+                                          cl::SharedMemory::SealWrite;
+
+    ASSERT_TRUE(memory.seal(seals));
+
+    if (!cl::SharedMemory::SupportsSealing()) {
+        return;
+    }
+
+    ASSERT_EQ(memory.seals(), seals);
+    ASSERT_FALSE(memory.isWritable());
+
+    auto mapping = cl::SharedMemory::Map(dup(memory.handle()), seals);
+
+    ASSERT_TRUE(mapping->isReady());
+    ASSERT_FALSE(mapping->isWritable());
+    ASSERT_EQ(mapping->size(), 1024u);
+    ASSERT_EQ(static_cast<const char *>(mapping->address())[1023], 'x');
+
+    /*
+     *  Nobody holding the handle can truncate the region under a receiver
+     */
+    ASSERT_EQ(ftruncate(mapping->handle(), 512), -1);
+}
+
+TEST(SharedMemoryTest, MapRequiresSeals) {
+    if (!cl::SharedMemory::SupportsSealing()) {
+        return;
+    }
+
+    cl::SharedMemory memory(1024);
+    ASSERT_TRUE(memory.isReady());
+    ASSERT_TRUE(memory.seal(cl::SharedMemory::SealShrink));
+
+    auto mapping = cl::SharedMemory::Map(dup(memory.handle()),
+                                         cl::SharedMemory::SealShrink |
+                                             cl::SharedMemory::SealWrite);
+
+    ASSERT_FALSE(mapping->isReady());
+}
+
+TEST(SharedMemoryTest, WriteSealFailsWhilePeersCanWrite) {
+    if (!cl::SharedMemory::SupportsSealing()) {
+        return;
+    }
+
+    cl::SharedMemory memory(1024);
+    auto mapping = cl::SharedMemory::Map(dup(memory.handle()));
+
+    ASSERT_TRUE(mapping->isWritable());
+    ASSERT_FALSE(memory.seal(cl::SharedMemory::SealWrite));
+
+    /*
+     *  The region is still usable after the failed attempt
+     */
+    ASSERT_TRUE(memory.isReady());
+    ASSERT_TRUE(memory.isWritable());
+    static_cast<char *>(memory.address())[0] = 'x';
+    ASSERT_EQ(static_cast<const char *>(mapping->address())[0], 'x');
+}
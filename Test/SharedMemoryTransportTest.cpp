@@ -0,0 +1,178 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "SharedMemoryTransport.h"
+#include "SharedMemory.h"
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+#include <vector>
+
+static std::unique_ptr<cl::SharedMemoryTransport>
+SharedMemoryTransportTest_OpenPeer(const cl::SharedMemoryTransport &producer) {
+    return cl::SharedMemoryTransport::Open(dup(producer.handle()));
+}
+
+TEST(SharedMemoryTransportTest, WriteAndRead) {
+    auto producer = cl::SharedMemoryTransport::Create(4096);
+    ASSERT_TRUE(producer != nullptr);
+    ASSERT_TRUE(producer->capacity() == 4096);
+
+    auto consumer = SharedMemoryTransportTest_OpenPeer(*producer);
+    ASSERT_TRUE(consumer != nullptr);
+
+    const char hello[] = "hello";
+
+    bool notify = false;
+    ASSERT_TRUE(producer->write(reinterpret_cast<const uint8_t *>(hello),
+                                sizeof(hello), 2, notify) ==
+                cl::SharedMemoryTransport::Success);
+
+    /*
+     *  The consumer has not read anything yet, so it may be idle
+     */
+    ASSERT_TRUE(notify);
+
+    ASSERT_TRUE(producer->write(reinterpret_cast<const uint8_t *>(hello),
+                                sizeof(hello), 0, notify) ==
+                cl::SharedMemoryTransport::Success);
+
+    /*
+     *  The first record has not been consumed, so the consumer is not idle
+     */
+    ASSERT_FALSE(notify);
+
+    std::vector<uint32_t> attachmentCounts;
+
+    ASSERT_TRUE(consumer->read([&](const uint8_t *payload, size_t length,
+                                   uint32_t attachmentCount) {
+        EXPECT_EQ(length, sizeof(hello));
+        EXPECT_EQ(memcmp(payload, hello, sizeof(hello)), 0);
+        attachmentCounts.push_back(attachmentCount);
+        return true;
+    }));
+
+    ASSERT_EQ(attachmentCounts, std::vector<uint32_t>({2, 0}));
+}
+
+TEST(SharedMemoryTransportTest, WrapsAroundAndFills) {
+    auto producer = cl::SharedMemoryTransport::Create(4096);
+    auto consumer = SharedMemoryTransportTest_OpenPeer(*producer);
+
+    ASSERT_TRUE(consumer != nullptr);
+
+    std::vector<uint8_t> payload(1000);
+
+    size_t written = 0;
+    size_t read = 0;
+
+    for (size_t round = 0; round < 20; round++) {
+        /*
+         *  Fill the ring till it runs out of space
+         */
+        while (true) {
+            for (auto &byte : payload) {
+                byte = static_cast<uint8_t>(written);
+            }
+
+            bool notify = false;
+            auto status =
+                producer->write(payload.data(), payload.size(), 0, notify);
+
+            if (status == cl::SharedMemoryTransport::InsufficientSpace) {
+                break;
+            }
+
+            ASSERT_TRUE(status == cl::SharedMemoryTransport::Success);
+            written++;
+        }
+
+        ASSERT_TRUE(consumer->read([&](const uint8_t *data, size_t length,
+                                       uint32_t attachmentCount) {
+            EXPECT_EQ(length, payload.size());
+            EXPECT_EQ(data[0], static_cast<uint8_t>(read));
+            EXPECT_EQ(data[length - 1], static_cast<uint8_t>(read));
+            read++;
+            return true;
+        }));
+
+        ASSERT_EQ(read, written);
+    }
+}
+
+TEST(SharedMemoryTransportTest, StoppedReadResumes) {
+    auto producer = cl::SharedMemoryTransport::Create(4096);
+    auto consumer = SharedMemoryTransportTest_OpenPeer(*producer);
+
+    for (uint8_t i = 0; i < 4; i++) {
+        bool notify = false;
+        ASSERT_TRUE(producer->write(&i, sizeof(i), 0, notify) ==
+                    cl::SharedMemoryTransport::Success);
+    }
+
+    std::vector<uint8_t> values;
+
+    auto handler = [&](const uint8_t *data, size_t length,
+                       uint32_t attachmentCount) {
+        if (values.size() == 2) {
+            return false;
+        }
+
+        values.push_back(data[0]);
+        return true;
+    };
+
+    ASSERT_TRUE(consumer->read(handler));
+    ASSERT_EQ(values, std::vector<uint8_t>({0, 1}));
+
+    values.clear();
+
+    ASSERT_TRUE(consumer->read(handler));
+    ASSERT_EQ(values, std::vector<uint8_t>({2, 3}));
+}
+
+TEST(SharedMemoryTransportTest, RecordTooLarge) {
+    auto producer = cl::SharedMemoryTransport::Create(4096);
+
+    std::vector<uint8_t> payload(producer->maxRecordLength() + 1);
+
+    bool notify = false;
+    ASSERT_TRUE(producer->write(payload.data(), payload.size(), 0, notify) ==
+                cl::SharedMemoryTransport::RecordTooLarge);
+
+    payload.resize(producer->maxRecordLength());
+    ASSERT_TRUE(producer->write(payload.data(), payload.size(), 0, notify) ==
+                cl::SharedMemoryTransport::Success);
+}
+
+TEST(SharedMemoryTransportTest, RejectsInvalidRegion) {
+    cl::SharedMemory memory(8192);
+    ASSERT_TRUE(memory.isReady());
+
+    /*
+     *  A zero filled region is not a transport
+     */
+    ASSERT_TRUE(cl::SharedMemoryTransport::Open(dup(memory.handle())) ==
+                nullptr);
+}
@@ -23,11 +23,170 @@
 */
 
 #include "Socket.h"
+#include "Message.h"
+#include "SharedMemory.h"
+
 #include <gtest/gtest.h>
 
+#include <thread>
+#include <unistd.h>
+
 TEST(SocketTest, SimplePairInitialization) {
     auto socketPair = cl::Socket::CreatePair();
 
     ASSERT_TRUE(socketPair.first.get() != nullptr);
     ASSERT_TRUE(socketPair.second.get() != nullptr);
 }
+
+TEST(SocketTest, BatchedWriteAndRead) {
+    auto socketPair = cl::Socket::CreatePair();
+
+    /*
+     *  Write more records than fit in a single batch. Every few records
+     *  carry an attachment.
+     */
+    const size_t Count = cl::Socket::MaxBatchCount * 2 + 3;
+
+    cl::SharedMemory memory(64);
+
+    std::vector<std::unique_ptr<cl::Message>> messages;
+    std::vector<cl::Message *> messagePointers;
+
+    for (size_t i = 0; i < Count; i++) {
+        auto message = std::unique_ptr<cl::Message>(new cl::Message());
+
+        ASSERT_TRUE(message->encode(static_cast<uint32_t>(i)));
+
+        if (i % 5 == 0) {
+            message->addAttachment(cl::Attachment(memory.handle()));
+        }
+
+        messagePointers.push_back(message.get());
+        messages.push_back(std::move(message));
+    }
+
+    const uint8_t prefix = 7;
+
+    ASSERT_EQ(socketPair.first->WriteMessages(messagePointers, &prefix,
+                                              sizeof(prefix)),
+              cl::Socket::Status::Success);
+
+    auto result = socketPair.second->ReadMessages();
+
+    ASSERT_EQ(result.first, cl::Socket::Status::Success);
+    ASSERT_EQ(result.second.size(), Count);
+
+    for (size_t i = 0; i < Count; i++) {
+        auto &message = *result.second[i];
+
+        uint8_t readPrefix = 0;
+        uint32_t value = 0;
+
+        ASSERT_TRUE(message.decode(readPrefix));
+        ASSERT_TRUE(message.decode(value));
+
+        ASSERT_EQ(readPrefix, prefix);
+        ASSERT_EQ(value, i);
+
+        auto range = message.attachmentRange();
+
+        ASSERT_EQ(static_cast<size_t>(range.second - range.first),
+                  i % 5 == 0 ? 1u : 0u);
+
+        for (auto j = range.first; j != range.second; j++) {
+            ASSERT_NE((*j).handle(), memory.handle());
+            ::close((*j).handle());
+        }
+    }
+
+    /*
+     *  An orderly shutdown is only reported once there is nothing left
+     */
+    socketPair.first->close();
+
+    result = socketPair.second->ReadMessages();
+
+    ASSERT_EQ(result.first, cl::Socket::Status::PermanentFailure);
+    ASSERT_EQ(result.second.size(), 0u);
+}
+
+TEST(SocketTest, RecycledMessagesAreReused) {
+    auto socketPair = cl::Socket::CreatePair();
+
+    cl::Message message;
+    ASSERT_TRUE(message.encode(static_cast<uint32_t>(42)));
+
+    ASSERT_EQ(socketPair.first->WriteMessage(message),
+              cl::Socket::Status::Success);
+
+    cl::Socket::Messages messages;
+
+    ASSERT_EQ(socketPair.second->ReadMessages(messages, 1),
+              cl::Socket::Status::Success);
+    ASSERT_EQ(messages.size(), 1u);
+
+    const cl::Message *first = messages[0].get();
+
+    socketPair.second->RecycleMessages(messages);
+    ASSERT_EQ(messages.size(), 0u);
+
+    /*
+     *  The next record is read into the recycled message, which has been
+     *  emptied
+     */
+    ASSERT_TRUE(message.encode(static_cast<uint32_t>(43)));
+
+    ASSERT_EQ(socketPair.first->WriteMessage(message),
+              cl::Socket::Status::Success);
+
+    ASSERT_EQ(socketPair.second->ReadMessages(messages, 1),
+              cl::Socket::Status::Success);
+    ASSERT_EQ(messages.size(), 1u);
+    ASSERT_EQ(messages[0].get(), first);
+    ASSERT_EQ(messages[0]->size(), 2 * sizeof(uint32_t));
+    ASSERT_EQ(messages[0]->sizeRead(), 0u);
+
+    uint32_t value = 0;
+    ASSERT_TRUE(messages[0]->decode(value));
+    ASSERT_EQ(value, 42u);
+    ASSERT_TRUE(messages[0]->decode(value));
+    ASSERT_EQ(value, 43u);
+}
+
+TEST(SocketTest, BoundToThread) {
+    auto socketPair = cl::Socket::CreatePair();
+    auto &socket = socketPair.first;
+
+    ASSERT_FALSE(socket->isBoundToThread());
+
+    socket->bindToCurrentThread();
+
+    ASSERT_TRUE(socket->isBoundToThread());
+    ASSERT_TRUE(socket->isBoundToCurrentThread());
+
+    std::thread([&]() {
+        ASSERT_TRUE(socket->isBoundToThread());
+        ASSERT_FALSE(socket->isBoundToCurrentThread());
+    }).join();
+
+    /*
+     *  Reads and writes on the bound thread skip the lock
+     */
+    cl::Message message;
+    ASSERT_TRUE(message.encode(static_cast<uint32_t>(42)));
+
+    ASSERT_EQ(socket->WriteMessage(message), cl::Socket::Status::Success);
+
+    socketPair.second->bindToCurrentThread();
+
+    cl::Socket::Messages messages;
+
+    ASSERT_EQ(socketPair.second->ReadMessages(messages, 1),
+              cl::Socket::Status::Success);
+    ASSERT_EQ(messages.size(), 1u);
+
+    socketPair.second->RecycleMessages(messages);
+
+    socket->unbindFromThread();
+    ASSERT_FALSE(socket->isBoundToThread());
+}
@@ -0,0 +1,82 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "TaskQueue.h"
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(TaskQueueTest, SignalsOnlyWhenEmpty) {
+    cl::TaskQueue queue;
+
+    auto now = cl::TaskQueue::Clock::now();
+
+    ASSERT_TRUE(queue.push([] {}, now));
+    ASSERT_FALSE(queue.push([] {}, now));
+
+    ASSERT_TRUE(queue.drain([](cl::TaskQueue::Task &,
+                               cl::TaskQueue::Clock::time_point) {}) == 2);
+
+    ASSERT_TRUE(queue.push([] {}, now));
+}
+
+TEST(TaskQueueTest, DrainsInPushOrder) {
+    cl::TaskQueue queue;
+
+    const int ProducerCount = 4;
+    const int TasksPerProducer = 10000;
+
+    std::vector<std::thread> producers;
+
+    for (int p = 0; p < ProducerCount; p++) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < TasksPerProducer; i++) {
+                /*
+                 *  Encode the producer and sequence in the fire time
+                 */
+                queue.push([] {}, cl::TaskQueue::Clock::time_point(
+                                      std::chrono::nanoseconds(
+                                          p * TasksPerProducer + i)));
+            }
+        });
+    }
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    std::vector<int64_t> last(ProducerCount, -1);
+
+    size_t drained = queue.drain([&last](cl::TaskQueue::Task &,
+                                         cl::TaskQueue::Clock::time_point t) {
+        int64_t value = t.time_since_epoch().count();
+        int producer = (int)(value / TasksPerProducer);
+
+        ASSERT_TRUE(value > last[producer]);
+        last[producer] = value;
+    });
+
+    ASSERT_TRUE(drained == ProducerCount * TasksPerProducer);
+}
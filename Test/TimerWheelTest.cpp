@@ -0,0 +1,225 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "TimerWheel.h"
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using std::chrono::hours;
+
+TEST(TimerWheelTest, OneShot) {
+    cl::TimerWheel wheel;
+
+    int count = 0;
+    cl::TimerWheel::Timer timer([&count]() { count++; });
+
+    auto start = cl::TimerWheel::Clock::now();
+
+    wheel.schedule(timer, milliseconds(10));
+    ASSERT_TRUE(timer.isScheduled());
+
+    ASSERT_TRUE(wheel.advance(start + milliseconds(5)) == 0);
+    ASSERT_TRUE(wheel.advance(start + milliseconds(12)) == 1);
+    ASSERT_TRUE(wheel.advance(start + milliseconds(50)) == 0);
+
+    ASSERT_TRUE(count == 1);
+    ASSERT_FALSE(timer.isScheduled());
+    ASSERT_TRUE(wheel.size() == 0);
+}
+
+TEST(TimerWheelTest, CancelAndReschedule) {
+    cl::TimerWheel wheel;
+
+    int count = 0;
+    cl::TimerWheel::Timer timer([&count]() { count++; });
+
+    auto start = cl::TimerWheel::Clock::now();
+
+    wheel.schedule(timer, milliseconds(10));
+    wheel.cancel(timer);
+
+    ASSERT_TRUE(wheel.advance(start + milliseconds(20)) == 0);
+
+    wheel.schedule(timer, milliseconds(10));
+    wheel.schedule(timer, milliseconds(100));
+
+    ASSERT_TRUE(wheel.size() == 1);
+    ASSERT_TRUE(wheel.advance(start + milliseconds(60)) == 0);
+    ASSERT_TRUE(wheel.advance(start + milliseconds(150)) == 1);
+
+    ASSERT_TRUE(count == 1);
+}
+
+TEST(TimerWheelTest, Repeating) {
+    cl::TimerWheel wheel;
+
+    int count = 0;
+    cl::TimerWheel::Timer timer([&count]() { count++; });
+
+    auto start = cl::TimerWheel::Clock::now();
+
+    wheel.schedule(timer, milliseconds(10), milliseconds(10));
+
+    wheel.advance(start + milliseconds(105));
+
+    ASSERT_TRUE(count == 10);
+    ASSERT_TRUE(timer.isScheduled());
+
+    wheel.cancel(timer);
+
+    wheel.advance(start + milliseconds(500));
+
+    ASSERT_TRUE(count == 10);
+}
+
+TEST(TimerWheelTest, OuterLevelsCascade) {
+    cl::TimerWheel wheel;
+
+    std::vector<int> fired;
+
+    cl::TimerWheel::Timer a([&fired]() { fired.push_back(0); });
+    cl::TimerWheel::Timer b([&fired]() { fired.push_back(1); });
+    cl::TimerWheel::Timer c([&fired]() { fired.push_back(2); });
+    cl::TimerWheel::Timer d([&fired]() { fired.push_back(3); });
+
+    auto start = cl::TimerWheel::Clock::now();
+
+    wheel.schedule(d, hours(30)); /* beyond the range of the wheel */
+    wheel.schedule(c, seconds(20));
+    wheel.schedule(b, seconds(2));
+    wheel.schedule(a, milliseconds(300));
+
+    wheel.advance(start + milliseconds(299));
+    ASSERT_TRUE(fired.size() == 0);
+
+    wheel.advance(start + seconds(19));
+    ASSERT_TRUE(fired.size() == 2);
+
+    wheel.advance(start + seconds(21));
+    ASSERT_TRUE(fired.size() == 3);
+
+    wheel.advance(start + hours(29));
+    ASSERT_TRUE(fired.size() == 3);
+
+    wheel.advance(start + hours(31));
+    ASSERT_TRUE(fired.size() == 4);
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(fired[i] == i);
+    }
+}
+
+TEST(TimerWheelTest, CascadeWhenAdvancingOntoBoundary) {
+    cl::TimerWheel wheel;
+
+    int count = 0;
+    cl::TimerWheel::Timer timer([&count]() { count++; });
+
+    auto start = cl::TimerWheel::Clock::now();
+
+    wheel.schedule(timer, milliseconds(300));
+
+    /*
+     *  Leaves the wheel right on the first wrap of the inner level without
+     *  firing that tick
+     */
+    wheel.advance(start + std::chrono::microseconds(255500));
+    ASSERT_TRUE(count == 0);
+
+    wheel.advance(start + milliseconds(400));
+    ASSERT_TRUE(count == 1);
+
+    wheel.advance(start + milliseconds(2000));
+    wheel.advance(start + milliseconds(20000));
+    ASSERT_TRUE(count == 1);
+    ASSERT_TRUE(wheel.size() == 0);
+}
+
+TEST(TimerWheelTest, CascadeAfterFiringLastInnerSlot) {
+    cl::TimerWheel wheel;
+
+    std::vector<int> fired;
+
+    cl::TimerWheel::Timer a([&fired]() { fired.push_back(0); });
+    cl::TimerWheel::Timer b([&fired]() { fired.push_back(1); });
+
+    auto start = cl::TimerWheel::Clock::now();
+
+    /*
+     *  Firing the last inner slot moves the wheel onto the boundary. Ticks
+     *  are rounded up, so the first timer lands in that slot.
+     */
+    wheel.schedule(a, milliseconds(254));
+    wheel.schedule(b, milliseconds(300));
+
+    wheel.advance(start + milliseconds(400));
+
+    ASSERT_TRUE(fired.size() == 2);
+    ASSERT_TRUE(fired[0] == 0 && fired[1] == 1);
+}
+
+TEST(TimerWheelTest, Timeout) {
+    cl::TimerWheel wheel;
+
+    auto start = cl::TimerWheel::Clock::now();
+
+    ASSERT_TRUE(wheel.timeout(start) == std::chrono::nanoseconds::max());
+
+    cl::TimerWheel::Timer timer;
+    wheel.schedule(timer, milliseconds(10));
+
+    auto timeout = wheel.timeout(start);
+
+    ASSERT_TRUE(timeout >= milliseconds(10));
+    ASSERT_TRUE(timeout <= milliseconds(12));
+}
+
+TEST(TimerWheelTest, CallbackCollectsTimer) {
+    cl::TimerWheel wheel;
+
+    auto start = cl::TimerWheel::Clock::now();
+
+    auto timer = new cl::TimerWheel::Timer();
+    cl::TimerWheel::Timer other;
+
+    int count = 0;
+
+    timer->setCallback([&]() {
+        count++;
+        wheel.cancel(other);
+        delete timer;
+    });
+    other.setCallback([&count]() { count++; });
+
+    wheel.schedule(*timer, milliseconds(1));
+    wheel.schedule(other, milliseconds(1));
+
+    wheel.advance(start + milliseconds(10));
+
+    ASSERT_TRUE(count == 1);
+    ASSERT_TRUE(wheel.size() == 0);
+}
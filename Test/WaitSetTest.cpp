@@ -0,0 +1,89 @@
+/*
+  The MIT License (MIT)
+  
+  Copyright (c) 2015, Chinmay Garde
+  
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+  
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "WaitSet.h"
+#include "LooperSource.h"
+#include <gtest/gtest.h>
+
+TEST(WaitSetTest, StaleTokensAreDropped) {
+    cl::WaitSet waitSet;
+
+    auto first = cl::LooperSource::AsTrivial();
+    ASSERT_TRUE(waitSet.addSource(first));
+
+    first->writer()(first->writeHandle());
+
+    const auto &ready = waitSet.wait();
+    ASSERT_TRUE(ready.size() == 1);
+
+    const cl::WaitSet::Token staleToken = ready[0].token;
+    ASSERT_TRUE(waitSet.source(staleToken) == first.get());
+
+    /*
+     *  The second source reuses the slot vacated by the first. The token
+     *  still held for the first source must not resolve to it.
+     */
+    ASSERT_TRUE(waitSet.removeSource(first));
+
+    auto second = cl::LooperSource::AsTrivial();
+    ASSERT_TRUE(waitSet.addSource(second));
+
+    ASSERT_TRUE(second->waitSetToken() != staleToken);
+    ASSERT_TRUE(waitSet.source(staleToken) == nullptr);
+    ASSERT_TRUE(waitSet.source(second->waitSetToken()) == second.get());
+
+    ASSERT_TRUE(waitSet.removeSource(second));
+}
+
+TEST(WaitSetTest, SourceInOneWaitSetOnly) {
+    cl::WaitSet waitSet;
+    cl::WaitSet otherWaitSet;
+
+    auto source = cl::LooperSource::AsTrivial();
+
+    ASSERT_TRUE(waitSet.addSource(source));
+    ASSERT_FALSE(waitSet.addSource(source));
+    ASSERT_FALSE(otherWaitSet.addSource(source));
+    ASSERT_FALSE(otherWaitSet.removeSource(source));
+    ASSERT_FALSE(otherWaitSet.updateSource(source));
+
+    ASSERT_TRUE(waitSet.removeSource(source));
+    ASSERT_TRUE(source->waitSetToken() == cl::WaitSet::InvalidToken);
+
+    ASSERT_TRUE(otherWaitSet.addSource(source));
+    ASSERT_TRUE(otherWaitSet.removeSource(source));
+}
+
+TEST(WaitSetTest, SourcesAreReleasedOnDestruction) {
+    auto source = cl::LooperSource::AsTrivial();
+
+    {
+        cl::WaitSet waitSet;
+        ASSERT_TRUE(waitSet.addSource(source));
+        ASSERT_TRUE(source.use_count() == 2);
+    }
+
+    ASSERT_TRUE(source.use_count() == 1);
+    ASSERT_TRUE(source->waitSetToken() == cl::WaitSet::InvalidToken);
+}